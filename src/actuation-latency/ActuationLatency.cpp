@@ -0,0 +1,464 @@
+/*
+ * iCub Robot Unit Tests (Robot Testing Framework)
+ *
+ * Copyright (C) 2015-2019 Istituto Italiano di Tecnologia (IIT)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <math.h>
+#include <robottestingframework/TestAssert.h>
+#include <robottestingframework/dll/Plugin.h>
+#include <yarp/os/Time.h>
+#include <yarp/os/Property.h>
+#include <fstream>
+#include <algorithm>
+
+#include "ActuationLatency.h"
+
+//example     -v -t ActuationLatency.dll -p "--robot icub --part head --joints ""(0 1 2)"" --home ""(0 0 0)"" --interfaces ""(position_direct pwm)"" --posStep 1.0 --pwmStep ""(8 8 8)"" --trials 10"
+
+using namespace robottestingframework;
+using namespace yarp::os;
+using namespace yarp::dev;
+
+//the period used to poll the encoders while waiting for the response
+static const double poll_period = 0.0005;
+
+// prepare the plugin
+ROBOTTESTINGFRAMEWORK_PREPARE_PLUGIN(ActuationLatency)
+
+static double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty()) return 0;
+    double idx = p*(sorted.size()-1);
+    size_t lo = (size_t)floor(idx);
+    size_t hi = (size_t)ceil(idx);
+    return sorted[lo]+(idx-lo)*(sorted[hi]-sorted[lo]);
+}
+
+ActuationLatency::ActuationLatency() : yarp::robottestingframework::TestCase("ActuationLatency") {
+    jointsList=0;
+    dd=0;
+    ipos=0;
+    idir=0;
+    ipwm=0;
+    icmd=0;
+    iimd=0;
+    ienc=0;
+    n_part_joints=0;
+    test_position_direct=true;
+    test_pwm=true;
+    posStep=1.0;
+    trials=10;
+    noiseTime=0.5;
+    noiseFactor=3.0;
+    minThreshold=0.01;
+    timeout=1.0;
+    settleTime=0.5;
+    driftTime=0.2;
+    maxLatency=0;
+}
+
+ActuationLatency::~ActuationLatency() { }
+
+bool ActuationLatency::setup(yarp::os::Property& property) {
+
+    if(property.check("name"))
+        setName(property.find("name").asString());
+
+    // updating parameters
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("robot"),  "The robot name must be given as the test parameter!");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("part"),   "The part name must be given as the test parameter!");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("joints"), "The joints list must be given as the test parameter!");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("home"),   "The home position must be given as the test parameter!");
+
+    robotName = property.find("robot").asString();
+    partName = property.find("part").asString();
+
+    Bottle* jointsBottle = property.find("joints").asList();
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(jointsBottle!=0,"unable to parse joints parameter");
+
+    Bottle* homeBottle = property.find("home").asList();
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(homeBottle!=0,"unable to parse home parameter");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(homeBottle->size()==jointsBottle->size(),"home and joints must have the same size");
+
+    //optional parameters
+    if (property.check("interfaces"))
+    {
+        Bottle* ifacesBottle = property.find("interfaces").asList();
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(ifacesBottle!=0,"unable to parse interfaces parameter");
+        test_position_direct=false;
+        test_pwm=false;
+        for (size_t i=0; i<ifacesBottle->size(); i++)
+        {
+            std::string iface = ifacesBottle->get(i).asString();
+            if      (iface=="position_direct") test_position_direct=true;
+            else if (iface=="pwm")             test_pwm=true;
+            else ROBOTTESTINGFRAMEWORK_ASSERT_ERROR(Asserter::format("invalid interface %s: can be position_direct or pwm", iface.c_str()));
+        }
+    }
+    if (property.check("posStep"))      {posStep = property.find("posStep").asFloat64();}
+    if (property.check("trials"))       {trials = property.find("trials").asInt32();}
+    if (property.check("noiseTime"))    {noiseTime = property.find("noiseTime").asFloat64();}
+    if (property.check("noiseFactor"))  {noiseFactor = property.find("noiseFactor").asFloat64();}
+    if (property.check("minThreshold")) {minThreshold = property.find("minThreshold").asFloat64();}
+    if (property.check("timeout"))      {timeout = property.find("timeout").asFloat64();}
+    if (property.check("settleTime"))   {settleTime = property.find("settleTime").asFloat64();}
+    if (property.check("driftTime"))    {driftTime = property.find("driftTime").asFloat64();}
+    if (property.check("maxLatency"))   {maxLatency = property.find("maxLatency").asFloat64();}
+
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(posStep>0,"invalid posStep");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(trials>0,"invalid trials");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(noiseTime>0,"invalid noiseTime");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(timeout>0,"invalid timeout");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(settleTime>=0,"invalid settleTime");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(driftTime>0,"invalid driftTime");
+
+    if (test_pwm)
+    {
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("pwmStep"), "The pwmStep must be given as the test parameter when the pwm interface is tested!");
+        Bottle* pwmStepBottle = property.find("pwmStep").asList();
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(pwmStepBottle!=0 && pwmStepBottle->size()==jointsBottle->size(),"unable to parse pwmStep parameter");
+        pwmStep.resize(pwmStepBottle->size());
+        for (size_t i=0; i<pwmStepBottle->size(); i++) pwmStep[i]=pwmStepBottle->get(i).asFloat64();
+    }
+
+    Property options;
+    options.put("device", "remote_controlboard");
+    options.put("remote", "/"+robotName+"/"+partName);
+    options.put("local", "/ActuationLatencyTest/"+robotName+"/"+partName);
+
+    dd = new PolyDriver(options);
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->isValid(),"Unable to open device driver");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(ienc),"Unable to open encoders interface");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(ipos),"Unable to open position interface");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(icmd),"Unable to open control mode interface");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(iimd),"Unable to open interaction mode interface");
+    if (test_position_direct)
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(idir),"Unable to open position direct interface");
+    if (test_pwm)
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(ipwm),"Unable to open pwm control interface");
+
+    if (!ienc->getAxes(&n_part_joints))
+    {
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR("unable to get the number of joints of the part");
+    }
+
+    int n_cmd_joints = jointsBottle->size();
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(n_cmd_joints>0 && n_cmd_joints<=n_part_joints,"invalid number of joints, it must be >0 & <= number of part joints");
+    for (int i=0; i <n_cmd_joints; i++) jointsList.push_back(jointsBottle->get(i).asInt32());
+
+    home.resize(n_cmd_joints); for (int i=0; i< n_cmd_joints; i++) home[i]=homeBottle->get(i).asFloat64();
+    pos_tot.resize(n_part_joints);
+
+    return true;
+}
+
+void ActuationLatency::tearDown()
+{
+    if (dd)
+    {
+        setMode(VOCAB_CM_POSITION);
+        goHome();
+        delete dd;
+        dd =0;
+    }
+}
+
+void ActuationLatency::setMode(int desired_mode)
+{
+    for (unsigned int i=0; i<jointsList.size(); i++)
+    {
+        icmd->setControlMode((int)jointsList[i],desired_mode);
+        iimd->setInteractionMode((int)jointsList[i],VOCAB_IM_STIFF);
+        yarp::os::Time::delay(0.010);
+    }
+
+    int cmode;
+    yarp::dev::InteractionModeEnum imode;
+    int timeout = 0;
+
+    while (1)
+    {
+        int ok=0;
+        for (unsigned int i=0; i<jointsList.size(); i++)
+        {
+            icmd->getControlMode ((int)jointsList[i],&cmode);
+            iimd->getInteractionMode((int)jointsList[i],&imode);
+            if (cmode==desired_mode && imode==VOCAB_IM_STIFF) ok++;
+        }
+        if (ok==jointsList.size()) break;
+        if (timeout>100)
+        {
+            ROBOTTESTINGFRAMEWORK_ASSERT_ERROR("Unable to set control mode/interaction mode");
+        }
+        yarp::os::Time::delay(0.2);
+        timeout++;
+    }
+}
+
+void ActuationLatency::goHome()
+{
+    for (unsigned int i=0; i<jointsList.size(); i++)
+    {
+        ipos->setRefSpeed((int)jointsList[i],20.0);
+        ipos->positionMove((int)jointsList[i],home[i]);
+    }
+
+    int timeout = 0;
+    while (1)
+    {
+        int in_position=0;
+        for (unsigned int i=0; i<jointsList.size(); i++)
+        {
+            double tmp=0;
+            ienc->getEncoder((int)jointsList[i],&tmp);
+            if (fabs(tmp-home[i])<0.5) in_position++;
+        }
+        if (in_position==jointsList.size()) break;
+        if (timeout>100)
+        {
+            ROBOTTESTINGFRAMEWORK_ASSERT_ERROR("Timeout while reaching home position");
+        }
+        yarp::os::Time::delay(0.2);
+        timeout++;
+    }
+}
+
+void ActuationLatency::saveToFile(std::string filename, yarp::os::Bottle &b)
+{
+    std::fstream fs;
+    fs.open (filename.c_str(), std::fstream::out);
+
+    for (unsigned int i=0; i<b.size(); i++)
+    {
+        std::string s = b.get(i).toString();
+        std::replace(s.begin(), s.end(), '(', ' ');
+        std::replace(s.begin(), s.end(), ')', ' ');
+        fs << s << std::endl;
+    }
+
+    fs.close();
+}
+
+double ActuationLatency::measureNoise(int i)
+{
+    //the noise floor is the max deviation from the mean of the encoder readings, with the joint at rest
+    std::vector<double> samples;
+    double start_time = yarp::os::Time::now();
+    while (yarp::os::Time::now()-start_time < noiseTime)
+    {
+        ienc->getEncoders(pos_tot.data());
+        samples.push_back(pos_tot[(int)jointsList[i]]);
+        yarp::os::Time::delay(0.001);
+    }
+
+    double mean=0;
+    for (size_t k=0; k<samples.size(); k++) mean+=samples[k];
+    if (!samples.empty()) mean/=samples.size();
+
+    double noise=0;
+    for (size_t k=0; k<samples.size(); k++) noise=std::max(noise, fabs(samples[k]-mean));
+    return noise;
+}
+
+double ActuationLatency::measureDrift(int i, double& pos, double& pos_time)
+{
+    //least squares line of the encoder readings, pos is the value of the line at the end of the acquisition
+    std::vector<double> t, p;
+    double start_time = yarp::os::Time::now();
+    double now = start_time;
+    while (now-start_time < driftTime)
+    {
+        ienc->getEncoders(pos_tot.data());
+        now = yarp::os::Time::now();
+        t.push_back(now-start_time);
+        p.push_back(pos_tot[(int)jointsList[i]]);
+        yarp::os::Time::delay(0.001);
+    }
+
+    size_t n = t.size();
+    double t_mean=0, p_mean=0;
+    for (size_t k=0; k<n; k++) {t_mean+=t[k]; p_mean+=p[k];}
+    t_mean/=n;
+    p_mean/=n;
+    double num=0, den=0;
+    for (size_t k=0; k<n; k++)
+    {
+        num+=(t[k]-t_mean)*(p[k]-p_mean);
+        den+=(t[k]-t_mean)*(t[k]-t_mean);
+    }
+    double drift = (den>0) ? num/den : 0;
+    pos_time = start_time+t[n-1];
+    pos = p_mean+drift*(t[n-1]-t_mean);
+    return drift;
+}
+
+bool ActuationLatency::waitResponse(int i, double start_pos, double threshold, double cmd_time, double& latency, double direction, double drift, double drift_time)
+{
+    while (1)
+    {
+        ienc->getEncoders(pos_tot.data());
+        double now = yarp::os::Time::now();
+        //the drift measured before the step is removed, and only a movement in the commanded direction is a response
+        double delta = pos_tot[(int)jointsList[i]]-start_pos-drift*(now-drift_time);
+        if (direction!=0) delta*=direction;
+        else              delta=fabs(delta);
+        if (delta > threshold)
+        {
+            latency = now-cmd_time;
+            return true;
+        }
+        if (now-cmd_time > timeout)
+        {
+            latency = -1;
+            return false;
+        }
+        yarp::os::Time::delay(poll_period);
+    }
+}
+
+void ActuationLatency::testPositionDirect(int i)
+{
+    int j = (int)jointsList[i];
+    icmd->setControlMode(j,VOCAB_CM_POSITION_DIRECT);
+    yarp::os::Time::delay(settleTime);
+    idir->setPosition(j,home[i]);
+    yarp::os::Time::delay(settleTime);
+
+    double noise = measureNoise(i);
+    double threshold = std::max(noiseFactor*noise, minThreshold);
+    ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Joint %d (position_direct): noise floor %f, detection threshold %f", j, noise, threshold));
+
+    std::vector<double> latencies;
+    int timeouts=0;
+    for (int k=0; k<trials; k++)
+    {
+        double sign = (k%2==0) ? 1.0 : -1.0;
+        double start_pos=0;
+        ienc->getEncoder(j,&start_pos);
+
+        double cmd_time = yarp::os::Time::now();
+        idir->setPosition(j,home[i]+sign*posStep);
+        double latency;
+        if (waitResponse(i, start_pos, threshold, cmd_time, latency, sign)) latencies.push_back(latency);
+        else timeouts++;
+
+        idir->setPosition(j,home[i]);
+        yarp::os::Time::delay(settleTime);
+
+        Bottle& row = dataToSave.addList();
+        row.addInt32(0);
+        row.addInt32(j);
+        row.addInt32(k);
+        row.addFloat64(latency);
+    }
+
+    icmd->setControlMode(j,VOCAB_CM_POSITION);
+    reportLatency("position_direct", i, latencies, timeouts);
+}
+
+void ActuationLatency::testPwm(int i)
+{
+    int j = (int)jointsList[i];
+
+    std::vector<double> latencies;
+    int timeouts=0;
+    double threshold=minThreshold;
+    for (int k=0; k<trials; k++)
+    {
+        //the joint is brought back home in position control before each step, since it is not controlled with zero pwm
+        setMode(VOCAB_CM_POSITION);
+        goHome();
+        icmd->setControlMode(j,VOCAB_CM_PWM);
+        ipwm->setRefDutyCycle(j,0.0);
+        yarp::os::Time::delay(settleTime);
+
+        if (k==0)
+        {
+            double noise = measureNoise(i);
+            threshold = std::max(noiseFactor*noise, minThreshold);
+            ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Joint %d (pwm): noise floor %f, detection threshold %f", j, noise, threshold));
+        }
+
+        //with zero pwm the joint may still drift (e.g. because of gravity): the drift is measured just before the step
+        double sign = (k%2==0) ? 1.0 : -1.0;
+        double start_pos=0, start_time=0;
+        double drift = measureDrift(i, start_pos, start_time);
+
+        double cmd_time = yarp::os::Time::now();
+        ipwm->setRefDutyCycle(j,sign*pwmStep[i]);
+        double latency;
+        if (waitResponse(i, start_pos, threshold, cmd_time, latency, sign, drift, start_time)) latencies.push_back(latency);
+        else timeouts++;
+        ipwm->setRefDutyCycle(j,0.0);
+
+        Bottle& row = dataToSave.addList();
+        row.addInt32(1);
+        row.addInt32(j);
+        row.addInt32(k);
+        row.addFloat64(latency);
+    }
+
+    setMode(VOCAB_CM_POSITION);
+    goHome();
+    reportLatency("pwm", i, latencies, timeouts);
+}
+
+void ActuationLatency::reportLatency(const std::string& iface, int i, std::vector<double>& latencies, int timeouts)
+{
+    int j = (int)jointsList[i];
+    ROBOTTESTINGFRAMEWORK_TEST_CHECK(timeouts==0, Asserter::format("Joint %d (%s): %d/%d steps without a response in the commanded direction within %f s", j, iface.c_str(), timeouts, trials, timeout));
+    if (latencies.empty()) return;
+
+    std::sort(latencies.begin(), latencies.end());
+    double mean=0;
+    for (size_t k=0; k<latencies.size(); k++) mean+=latencies[k];
+    mean/=latencies.size();
+    double std_dev=0;
+    for (size_t k=0; k<latencies.size(); k++) std_dev+=(latencies[k]-mean)*(latencies[k]-mean);
+    std_dev=sqrt(std_dev/latencies.size());
+    double median = percentile(latencies, 0.5);
+    double p90    = percentile(latencies, 0.9);
+
+    ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Joint %d (%s) latency [ms]: mean %.2f std %.2f min %.2f median %.2f p90 %.2f max %.2f (%d samples)",
+                                                        j, iface.c_str(), mean*1000, std_dev*1000, latencies.front()*1000, median*1000, p90*1000,
+                                                        latencies.back()*1000, (int)latencies.size()));
+    if (maxLatency>0)
+    {
+        ROBOTTESTINGFRAMEWORK_TEST_CHECK(p90<=maxLatency, Asserter::format("Joint %d (%s): 90th percentile latency %.2f ms, limit %.2f ms",
+                                                                           j, iface.c_str(), p90*1000, maxLatency*1000));
+    }
+}
+
+void ActuationLatency::run()
+{
+    setMode(VOCAB_CM_POSITION);
+    goHome();
+    dataToSave.clear();
+
+    for (unsigned int i=0; i<jointsList.size(); i++)
+    {
+        if (test_position_direct) testPositionDirect(i);
+        if (test_pwm)             testPwm(i);
+        setMode(VOCAB_CM_POSITION);
+        goHome();
+    }
+
+    //output format: interface (0=position_direct, 1=pwm), joint, trial, latency (-1 if no response)
+    std::string filename = "actuationLatency_" + partName + ".txt";
+    saveToFile(filename, dataToSave);
+}
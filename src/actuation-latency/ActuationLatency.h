@@ -0,0 +1,128 @@
+/*
+ * iCub Robot Unit Tests (Robot Testing Framework)
+ *
+ * Copyright (C) 2015-2019 Istituto Italiano di Tecnologia (IIT)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _ACTUATIONLATENCY_H_
+#define _ACTUATIONLATENCY_H_
+
+#include <string>
+#include <vector>
+#include <yarp/robottestingframework/TestCase.h>
+#include <yarp/dev/ControlBoardInterfaces.h>
+#include <yarp/dev/PolyDriver.h>
+#include <yarp/sig/Vector.h>
+#include <yarp/os/Bottle.h>
+
+/**
+* \ingroup icub-tests
+* This test measures the latency between a command sent to a joint and the first change of the joint position visible through IEncoders.
+* For each joint and for each selected control interface, the test applies a sequence of small steps (alternating in sign) starting from the home position,
+* timestamps the command and polls the encoders until the position moves away from the starting value by more than the noise floor.
+* The noise floor is estimated for each joint before the steps, by reading the encoders with the joint at rest.
+* The latency distribution (mean, std, min, median, 90th percentile, max) is reported per joint and per interface, and all the samples are saved to a text file.
+* The measured latency includes the period of the encoder stream of the remote control board, which is what a client actually experiences.
+* Be aware that the position direct step is applied instantaneously: keep posStep small (e.g. 1 deg).
+* In pwm mode the output is zeroed as soon as the movement is detected, or when the timeout expires. Since with zero pwm the joint
+* may drift, the drift is measured for driftTime seconds before each pwm step and subtracted from the encoder readings.
+* For both interfaces only a movement in the commanded direction is taken as the response.
+*
+* example: testRunner -v -t ActuationLatency.dll -p "--robot icub --part head --joints ""(0 1 2)"" --home ""(0 0 0)"" --interfaces ""(position_direct pwm)"" --posStep 1.0 --pwmStep ""(8 8 8)"" --trials 10"
+*
+* Check the following functions:
+* \li IPositionDirect::setPosition()
+* \li IPWMControl::setRefDutyCycle()
+* \li IEncoders::getEncoders()
+*
+*  Accepts the following parameters:
+* | Parameter name     | Type   | Units | Default Value | Required | Description | Notes |
+* |:------------------:|:------:|:-----:|:-------------:|:--------:|:-----------:|:-----:|
+* | robot              | string | -     | -     | Yes | The name of the robot.     | e.g. icub |
+* | part               | string | -     | -     | Yes | The name of the robot part. | e.g. left_arm |
+* | joints             | vector of ints | - | - | Yes | List of joints to be tested | |
+* | home               | vector of doubles of size joints | deg | - | Yes | The home position for each joint | |
+* | interfaces         | vector of strings | - | (position_direct pwm) | No | The control interfaces to be tested | position_direct, pwm |
+* | posStep            | double | deg   | 1.0   | No  | The amplitude of the position direct step | |
+* | pwmStep            | vector of doubles of size joints | - | - | Only if pwm is tested | The amplitude of the pwm step for each joint | |
+* | trials             | int    | -     | 10    | No  | The number of steps applied to each joint for each interface | |
+* | noiseTime          | double | s     | 0.5   | No  | The duration of the acquisition used to estimate the encoder noise floor | |
+* | noiseFactor        | double | -     | 3.0   | No  | The response is detected when the position change exceeds noiseFactor times the noise floor | |
+* | minThreshold       | double | deg   | 0.01  | No  | The minimum position change used to detect the response | |
+* | timeout            | double | s     | 1.0   | No  | The maximum time waited for the response to a step | |
+* | settleTime         | double | s     | 0.5   | No  | The time waited after each step before the next one | |
+* | driftTime          | double | s     | 0.2   | No  | The duration of the acquisition used to estimate the drift before each pwm step | |
+* | maxLatency         | double | s     | 0     | No  | If > 0, the 90th percentile of the latency of each joint/interface must be below this value | |
+*
+*/
+class ActuationLatency : public yarp::robottestingframework::TestCase {
+public:
+    ActuationLatency();
+    virtual ~ActuationLatency();
+
+    virtual bool setup(yarp::os::Property& property);
+
+    virtual void tearDown();
+
+    virtual void run();
+
+    void goHome();
+    void setMode(int desired_mode);
+    void saveToFile(std::string filename, yarp::os::Bottle &b);
+
+    double measureNoise(int i);
+    double measureDrift(int i, double& pos, double& pos_time);
+    bool   waitResponse(int i, double start_pos, double threshold, double cmd_time, double& latency,
+                        double direction=0, double drift=0, double drift_time=0);
+    void   testPositionDirect(int i);
+    void   testPwm(int i);
+    void   reportLatency(const std::string& iface, int i, std::vector<double>& latencies, int timeouts);
+
+private:
+    std::string robotName;
+    std::string partName;
+    yarp::sig::Vector jointsList;
+    yarp::sig::Vector home;
+    yarp::sig::Vector pwmStep;
+
+    bool   test_position_direct;
+    bool   test_pwm;
+    double posStep;
+    int    trials;
+    double noiseTime;
+    double noiseFactor;
+    double minThreshold;
+    double timeout;
+    double settleTime;
+    double driftTime;
+    double maxLatency;
+
+    int    n_part_joints;
+
+    yarp::dev::PolyDriver        *dd;
+    yarp::dev::IPositionControl  *ipos;
+    yarp::dev::IPositionDirect   *idir;
+    yarp::dev::IPWMControl       *ipwm;
+    yarp::dev::IControlMode      *icmd;
+    yarp::dev::IInteractionMode  *iimd;
+    yarp::dev::IEncoders         *ienc;
+
+    yarp::sig::Vector pos_tot;
+    yarp::os::Bottle  dataToSave;
+};
+
+#endif //_ACTUATIONLATENCY_H_
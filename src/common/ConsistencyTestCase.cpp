@@ -0,0 +1,119 @@
+/*
+ * iCub Robot Unit Tests (Robot Testing Framework)
+ *
+ * Copyright (C) 2015-2019 Istituto Italiano di Tecnologia (IIT)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <cstdio>
+#include <vector>
+#include <robottestingframework/TestAssert.h>
+#include <yarp/os/Time.h>
+
+#include "ConsistencyTestCase.h"
+
+ConsistencyTestCase::ConsistencyTestCase(std::string name) : yarp::robottestingframework::TestCase(name) {
+    latency_samples=20;
+    for (int a=0; a<3; a++) { latency_sum[a]=0; latency_max[a]=0; latency_n[a]=0; }
+}
+
+ConsistencyTestCase::~ConsistencyTestCase() { }
+
+void ConsistencyTestCase::addLatency(api_t api, double start_time)
+{
+    double latency=yarp::os::Time::now()-start_time;
+    latency_sum[api]+=latency;
+    if (latency>latency_max[api]) latency_max[api]=latency;
+    latency_n[api]++;
+}
+
+bool ConsistencyTestCase::verifyValues(const double* values, int n_checked, const int* joints, double verify_val, bool equal, std::string title, std::string what)
+{
+    int ok=0;
+    for (int i=0; i<n_checked; i++)
+    {
+        int j=joints ? joints[i] : i;
+        double value=values[j];
+        if ((value==verify_val)==equal) ok++;
+        else
+        {
+            ROBOTTESTINGFRAMEWORK_TEST_REPORT(robottestingframework::Asserter::format("Test (%s): j%d current %s is (%f), it should be %s(%f)",
+                                              title.c_str(),j,what.c_str(),value,equal?"":"!=",verify_val));
+        }
+    }
+    char sbuf[500];
+    if (ok==n_checked)
+    {
+        sprintf(sbuf,"Test (%s) passed, current %s of %d joints is (%s%f)",title.c_str(),what.c_str(),n_checked,equal?"":"!=",verify_val);
+        ROBOTTESTINGFRAMEWORK_TEST_REPORT(sbuf);
+        return true;
+    }
+    sprintf(sbuf,"Test (%s) failed: only %d joints (of %d) are ok",title.c_str(),ok,n_checked);
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR(sbuf);
+    return false;
+}
+
+void ConsistencyTestCase::measureLatencies(yarp::dev::IControlMode* icmd, int n_part_joints, int n_cmd_joints, const int* joints,
+                                           std::string ref_single_name, std::string ref_all_name)
+{
+    //the same data are read with the single joint, multiple joints and all joints variants of the getters.
+    //The control modes have all the three variants, the references only the single joint and all joints ones.
+    if (latency_samples<=0) return;
+    double sum[5]={0,0,0,0,0};
+    double max[5]={0,0,0,0,0};
+    std::vector<int> cmode_some(n_cmd_joints);
+    std::vector<int> cmode_tot(n_part_joints);
+    std::vector<double> ref_some(n_cmd_joints);
+    std::vector<double> ref_tot(n_part_joints);
+    for (int k=0; k<latency_samples; k++)
+    {
+        double t[6];
+        t[0]=yarp::os::Time::now();
+        for (int i=0; i<n_cmd_joints; i++) icmd->getControlMode(joints[i],&cmode_some[i]);
+        t[1]=yarp::os::Time::now();
+        icmd->getControlModes(n_cmd_joints,joints,cmode_some.data());
+        t[2]=yarp::os::Time::now();
+        icmd->getControlModes(cmode_tot.data());
+        t[3]=yarp::os::Time::now();
+        for (int i=0; i<n_cmd_joints; i++) getRefSingle(joints[i],&ref_some[i]);
+        t[4]=yarp::os::Time::now();
+        getRefAll(ref_tot.data());
+        t[5]=yarp::os::Time::now();
+        for (int a=0; a<5; a++)
+        {
+            sum[a]+=t[a+1]-t[a];
+            if (t[a+1]-t[a]>max[a]) max[a]=t[a+1]-t[a];
+        }
+    }
+
+    const char* names[5]={"getControlMode x joints","getControlModes(joints)","getControlModes(all)",ref_single_name.c_str(),ref_all_name.c_str()};
+    ROBOTTESTINGFRAMEWORK_TEST_REPORT(robottestingframework::Asserter::format("Latency to read %d joints (%d samples):",n_cmd_joints,latency_samples));
+    for (int a=0; a<5; a++)
+    {
+        ROBOTTESTINGFRAMEWORK_TEST_REPORT(robottestingframework::Asserter::format("  %-30s mean %.3f ms max %.3f ms",names[a],sum[a]/latency_samples*1000,max[a]*1000));
+    }
+}
+
+void ConsistencyTestCase::reportLatencies()
+{
+    const char* names[3]={"single joint","multiple joints","all joints"};
+    for (int a=0; a<3; a++)
+    {
+        if (latency_n[a]==0) continue;
+        ROBOTTESTINGFRAMEWORK_TEST_REPORT(robottestingframework::Asserter::format("Set/get calls (%s): %d calls, mean %.3f ms max %.3f ms",
+                                          names[a],latency_n[a],latency_sum[a]/latency_n[a]*1000,latency_max[a]*1000));
+    }
+}
@@ -0,0 +1,64 @@
+/*
+ * iCub Robot Unit Tests (Robot Testing Framework)
+ *
+ * Copyright (C) 2015-2019 Istituto Italiano di Tecnologia (IIT)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _CONSISTENCYTESTCASE_H_
+#define _CONSISTENCYTESTCASE_H_
+
+#include <string>
+#include <yarp/robottestingframework/TestCase.h>
+#include <yarp/dev/ControlBoardInterfaces.h>
+
+/**
+* Base class of the consistency tests (OpenloopConsistency, TorqueControlConsistency): it checks the values read back from the
+* control board and measures the latency of the setter and getter calls. The derived test provides the single joint and all joints
+* getters of the reference of the interface under test.
+*/
+class ConsistencyTestCase : public yarp::robottestingframework::TestCase {
+public:
+    ConsistencyTestCase(std::string name);
+    virtual ~ConsistencyTestCase();
+
+protected:
+    enum api_t
+    {
+      api_single = 0,
+      api_multi = 1,
+      api_all = 2
+    };
+    void addLatency(api_t api, double start_time);
+
+    // values contains all the joints of the part; joints lists the n_checked joints to verify, or is 0 to verify the first n_checked
+    bool verifyValues(const double* values, int n_checked, const int* joints, double verify_val, bool equal, std::string title, std::string what);
+
+    void measureLatencies(yarp::dev::IControlMode* icmd, int n_part_joints, int n_cmd_joints, const int* joints,
+                          std::string ref_single_name, std::string ref_all_name);
+    void reportLatencies();
+
+    virtual bool getRefSingle(int j, double* ref) = 0;
+    virtual bool getRefAll(double* refs) = 0;
+
+    // latency of the setter and getter calls, indexed by api_t
+    double latency_sum[3];
+    double latency_max[3];
+    int    latency_n[3];
+    int    latency_samples;
+};
+
+#endif //_CONSISTENCYTESTCASE_H_
@@ -0,0 +1,61 @@
+/*
+ * iCub Robot Unit Tests (Robot Testing Framework)
+ *
+ * Copyright (C) 2015-2019 Istituto Italiano di Tecnologia (IIT)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "CycleDataStore.h"
+
+CycleDataStore::CycleDataStore() : m_joint(-1) { }
+
+CycleDataStore::~CycleDataStore()
+{
+    close();
+}
+
+bool CycleDataStore::open(const std::string& filename, int joint, bool append)
+{
+    close();
+    m_joint = joint;
+    std::ios_base::openmode mode = std::ofstream::out | (append ? std::ofstream::app : std::ofstream::trunc);
+    m_data.open(filename.c_str(), mode);
+    m_index.open((filename + ".idx").c_str(), mode);
+    //the offsets of the segments are taken with tellp(), which is not at the end of the file just after opening it in append mode
+    if (append) m_data.seekp(0, std::ios_base::end);
+    return m_data.is_open() && m_index.is_open();
+}
+
+void CycleDataStore::close()
+{
+    if (m_data.is_open()) m_data.close();
+    if (m_index.is_open()) m_index.close();
+}
+
+bool CycleDataStore::writeSegment(int cycle, double time_zero, const std::vector<double>& time,
+                                  const std::vector<double>& value, const std::vector<double>& reference)
+{
+    if (!m_data.is_open() || !m_index.is_open()) return false;
+
+    std::streamoff offset = m_data.tellp();
+    for (size_t k = 0; k < time.size(); k++)
+    {
+        m_data << cycle << " " << time[k] - time_zero << " " << value[k] << " " << reference[k] << "\n";
+    }
+    m_data.flush();
+    m_index << m_joint << " " << cycle << " " << offset << " " << time.size() << std::endl;
+    return m_data.good() && m_index.good();
+}
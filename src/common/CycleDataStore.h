@@ -0,0 +1,53 @@
+/*
+ * iCub Robot Unit Tests (Robot Testing Framework)
+ *
+ * Copyright (C) 2015-2019 Istituto Italiano di Tecnologia (IIT)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _CYCLEDATASTORE_H_
+#define _CYCLEDATASTORE_H_
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+* Stores the samples of each (joint, cycle) segment as soon as the cycle is completed, so that the memory used does not grow with
+* the number of cycles and joints. The data file contains one row "cycle time value reference" per sample, with the time expressed
+* with respect to the instant of the step. The index file <filename>.idx contains one row "joint cycle offset rows" per segment,
+* where offset is the position in bytes of the first row of the segment in the data file, so that a single segment can be read
+* without parsing the whole data file.
+* When append is true, open() keeps the segments already in the files, so that several joints can be stored in the same file.
+*/
+class CycleDataStore
+{
+public:
+    CycleDataStore();
+    ~CycleDataStore();
+
+    bool open(const std::string& filename, int joint, bool append = false);
+    void close();
+    bool writeSegment(int cycle, double time_zero, const std::vector<double>& time,
+                      const std::vector<double>& value, const std::vector<double>& reference);
+
+private:
+    int           m_joint;
+    std::ofstream m_data;
+    std::ofstream m_index;
+};
+
+#endif //_CYCLEDATASTORE_H_
@@ -0,0 +1,241 @@
+/*
+ * iCub Robot Unit Tests (Robot Testing Framework)
+ *
+ * Copyright (C) 2015-2019 Istituto Italiano di Tecnologia (IIT)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <math.h>
+#include <robottestingframework/TestAssert.h>
+#include <robottestingframework/dll/Plugin.h>
+#include <yarp/os/Time.h>
+#include <yarp/os/Property.h>
+#include <algorithm>
+
+#include "ControlBoardContention.h"
+
+//example     -v -t ControlBoardContention.dll -p "--robot icubSim --part head --clients ""(1 2 4 8)"" --rate 100 --duration 10"
+
+using namespace robottestingframework;
+using namespace yarp::os;
+using namespace yarp::dev;
+
+static const char* call_names[ContentionClient::calls_num] = {"getEncoders", "getControlModes", "setRefSpeed"};
+
+// prepare the plugin
+ROBOTTESTINGFRAMEWORK_PREPARE_PLUGIN(ControlBoardContention)
+
+static double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty()) return 0;
+    double idx = p*(sorted.size()-1);
+    size_t lo = (size_t)floor(idx);
+    size_t hi = (size_t)ceil(idx);
+    return sorted[lo]+(idx-lo)*(sorted[hi]-sorted[lo]);
+}
+
+ContentionClient::ContentionClient(double period) : yarp::os::PeriodicThread(period) {
+    dd=0;
+    ienc=0;
+    icmd=0;
+    ipos=0;
+    n_part_joints=0;
+    for (int c=0; c<calls_num; c++) failures[c]=0;
+}
+
+ContentionClient::~ContentionClient() { close(); }
+
+bool ContentionClient::open(const std::string& robot, const std::string& part, int id, const std::vector<bool>& enabled_calls)
+{
+    enabled = enabled_calls;
+
+    Property options;
+    options.put("device", "remote_controlboard");
+    options.put("remote", "/"+robot+"/"+part);
+    options.put("local", "/ControlBoardContentionTest/"+robot+"/"+part+"/client"+std::to_string(id));
+
+    dd = new PolyDriver(options);
+    if (!dd->isValid()) return false;
+    if (!dd->view(ienc) || !dd->view(icmd) || !dd->view(ipos)) return false;
+    if (!ienc->getAxes(&n_part_joints) || n_part_joints<=0) return false;
+
+    buffer.resize(n_part_joints);
+    modes.resize(n_part_joints);
+    ref_speeds.resize(n_part_joints);
+    if (!ipos->getRefSpeeds(ref_speeds.data())) return false;
+    return true;
+}
+
+void ContentionClient::close()
+{
+    if (dd) {delete dd; dd =0;}
+}
+
+void ContentionClient::run()
+{
+    for (int c=0; c<calls_num; c++)
+    {
+        if (!enabled[c]) continue;
+
+        bool ret = false;
+        double start = yarp::os::Time::now();
+        switch (c)
+        {
+            case get_encoders:      ret = ienc->getEncoders(buffer.data()); break;
+            case get_control_modes: ret = icmd->getControlModes(modes.data()); break;
+            case set_ref_speed:     ret = ipos->setRefSpeed(0, ref_speeds[0]); break;
+        }
+        double latency = yarp::os::Time::now()-start;
+
+        if (ret) latencies[c].push_back(latency);
+        else     failures[c]++;
+    }
+}
+
+ControlBoardContention::ControlBoardContention() : yarp::robottestingframework::TestCase("ControlBoardContention") {
+    rate=100;
+    duration=10;
+    maxLatency=0;
+    maxFailureRate=0;
+    enabled_calls.resize(ContentionClient::calls_num, true);
+}
+
+ControlBoardContention::~ControlBoardContention() { }
+
+bool ControlBoardContention::setup(yarp::os::Property& property) {
+
+    if(property.check("name"))
+        setName(property.find("name").asString());
+
+    // updating parameters
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("robot"), "The robot name must be given as the test parameter!");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("part"),  "The part name must be given as the test parameter!");
+
+    robotName = property.find("robot").asString();
+    partName = property.find("part").asString();
+
+    //optional parameters
+    clients.clear();
+    if (property.check("clients"))
+    {
+        Bottle* clientsBottle = property.find("clients").asList();
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(clientsBottle!=0 && clientsBottle->size()>0,"unable to parse clients parameter");
+        for (size_t i=0; i<clientsBottle->size(); i++) clients.push_back(clientsBottle->get(i).asInt32());
+    }
+    else
+    {
+        clients.push_back(1);
+        clients.push_back(2);
+        clients.push_back(4);
+        clients.push_back(8);
+    }
+    for (size_t i=0; i<clients.size(); i++)
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(clients[i]>0,"invalid clients, they must be >0");
+
+    if (property.check("calls"))
+    {
+        Bottle* callsBottle = property.find("calls").asList();
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(callsBottle!=0 && callsBottle->size()>0,"unable to parse calls parameter");
+        std::fill(enabled_calls.begin(), enabled_calls.end(), false);
+        for (size_t i=0; i<callsBottle->size(); i++)
+        {
+            std::string call = callsBottle->get(i).asString();
+            bool found = false;
+            for (int c=0; c<ContentionClient::calls_num; c++)
+            {
+                if (call==call_names[c]) {enabled_calls[c]=true; found=true;}
+            }
+            ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(found, Asserter::format("invalid call %s: can be getEncoders, getControlModes or setRefSpeed", call.c_str()));
+        }
+    }
+
+    if (property.check("rate"))           {rate = property.find("rate").asFloat64();}
+    if (property.check("duration"))       {duration = property.find("duration").asFloat64();}
+    if (property.check("maxLatency"))     {maxLatency = property.find("maxLatency").asFloat64();}
+    if (property.check("maxFailureRate")) {maxFailureRate = property.find("maxFailureRate").asFloat64();}
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(rate>0,"invalid rate");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(duration>0,"invalid duration");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(maxFailureRate>=0 && maxFailureRate<=1,"invalid maxFailureRate");
+
+    return true;
+}
+
+void ControlBoardContention::tearDown()
+{
+}
+
+void ControlBoardContention::runClients(int n_clients)
+{
+    std::vector<ContentionClient*> client_list;
+    for (int k=0; k<n_clients; k++)
+    {
+        ContentionClient* client = new ContentionClient(1.0/rate);
+        client_list.push_back(client);
+        if (!client->open(robotName, partName, k, enabled_calls))
+        {
+            for (size_t i=0; i<client_list.size(); i++) delete client_list[i];
+            ROBOTTESTINGFRAMEWORK_ASSERT_ERROR(Asserter::format("Unable to open client %d on /%s/%s", k, robotName.c_str(), partName.c_str()));
+        }
+        for (int c=0; c<ContentionClient::calls_num; c++) client->latencies[c].reserve((size_t)(rate*duration)+1);
+    }
+
+    //all the clients are started together and run for the same time
+    for (int k=0; k<n_clients; k++) client_list[k]->start();
+    yarp::os::Time::delay(duration);
+    for (int k=0; k<n_clients; k++) client_list[k]->stop();
+
+    for (int c=0; c<ContentionClient::calls_num; c++)
+    {
+        if (!enabled_calls[c]) continue;
+
+        std::vector<double> all;
+        int failures=0;
+        for (int k=0; k<n_clients; k++)
+        {
+            all.insert(all.end(), client_list[k]->latencies[c].begin(), client_list[k]->latencies[c].end());
+            failures += client_list[k]->failures[c];
+        }
+        std::sort(all.begin(), all.end());
+        int total = (int)all.size()+failures;
+        double failure_rate = (total>0) ? (double)failures/total : 0;
+        double achieved_rate = all.size()/(duration*n_clients);
+
+        ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("%d client(s), %s: median %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms, failures %d/%d (%.2f%%), %.1f calls/s per client",
+                                                            n_clients, call_names[c],
+                                                            percentile(all,0.5)*1000, percentile(all,0.9)*1000, percentile(all,0.99)*1000,
+                                                            all.empty() ? 0 : all.back()*1000,
+                                                            failures, total, failure_rate*100, achieved_rate));
+
+        ROBOTTESTINGFRAMEWORK_TEST_CHECK(failure_rate<=maxFailureRate, Asserter::format("%d client(s), %s: failure rate %.2f%%, limit %.2f%%",
+                                                                                        n_clients, call_names[c], failure_rate*100, maxFailureRate*100));
+        if (maxLatency>0)
+        {
+            ROBOTTESTINGFRAMEWORK_TEST_CHECK(percentile(all,0.99)<=maxLatency, Asserter::format("%d client(s), %s: 99th percentile latency %.3f ms, limit %.3f ms",
+                                                                                                n_clients, call_names[c], percentile(all,0.99)*1000, maxLatency*1000));
+        }
+    }
+
+    for (int k=0; k<n_clients; k++) delete client_list[k];
+}
+
+void ControlBoardContention::run()
+{
+    for (size_t i=0; i<clients.size(); i++)
+    {
+        ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Running %d concurrent client(s) on /%s/%s for %.1f s", clients[i], robotName.c_str(), partName.c_str(), duration));
+        runClients(clients[i]);
+    }
+}
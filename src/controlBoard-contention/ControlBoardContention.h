@@ -0,0 +1,120 @@
+/*
+ * iCub Robot Unit Tests (Robot Testing Framework)
+ *
+ * Copyright (C) 2015-2019 Istituto Italiano di Tecnologia (IIT)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _CONTROLBOARDCONTENTION_H_
+#define _CONTROLBOARDCONTENTION_H_
+
+#include <string>
+#include <vector>
+#include <yarp/robottestingframework/TestCase.h>
+#include <yarp/dev/ControlBoardInterfaces.h>
+#include <yarp/dev/PolyDriver.h>
+#include <yarp/os/PeriodicThread.h>
+
+class ContentionClient : public yarp::os::PeriodicThread
+{
+public:
+    enum call_t
+    {
+        get_encoders      = 0,
+        get_control_modes = 1,
+        set_ref_speed     = 2,
+        calls_num         = 3
+    };
+
+    ContentionClient(double period);
+    virtual ~ContentionClient();
+
+    bool open(const std::string& robot, const std::string& part, int id, const std::vector<bool>& enabled_calls);
+    void close();
+
+    virtual void run();
+
+    //latencies (in seconds) of the successful calls and number of failed calls
+    std::vector<double> latencies[calls_num];
+    int failures[calls_num];
+
+private:
+    yarp::dev::PolyDriver        *dd;
+    yarp::dev::IEncoders         *ienc;
+    yarp::dev::IControlMode      *icmd;
+    yarp::dev::IPositionControl  *ipos;
+
+    int n_part_joints;
+    std::vector<bool> enabled;
+    std::vector<double> buffer;
+    std::vector<int> modes;
+    std::vector<double> ref_speeds;
+};
+
+/**
+* \ingroup icub-tests
+* This test measures how the latency of the control board calls degrades when several clients access the same robot part at once.
+* For each value of the clients parameter, the test spawns that number of local client threads, each one with its own remote_controlboard.
+* Each client performs the selected calls at the given rate for the given duration and records the latency of every call.
+* The latency percentiles (median, 90th, 99th, max) and the failure rate of each call are then reported for each number of clients.
+* setRefSpeed is called with the reference speeds read when the client is opened, so the state of the robot is not changed.
+* The test can be run against the simulator or the fake motion control device, it does not move the joints.
+*
+* example: testRunner -v -t ControlBoardContention.dll -p "--robot icubSim --part head --clients ""(1 2 4 8)"" --rate 100 --duration 10 --calls ""(getEncoders getControlModes setRefSpeed)"""
+*
+* Check the following functions:
+* \li IEncoders::getEncoders()
+* \li IControlMode::getControlModes()
+* \li IPositionControl::setRefSpeed()
+*
+*  Accepts the following parameters:
+* | Parameter name     | Type   | Units | Default Value | Required | Description | Notes |
+* |:------------------:|:------:|:-----:|:-------------:|:--------:|:-----------:|:-----:|
+* | robot              | string | -     | -     | Yes | The name of the robot.     | e.g. icub |
+* | part               | string | -     | -     | Yes | The name of the robot part. | e.g. left_arm |
+* | clients            | vector of ints | - | (1 2 4 8) | No | The numbers of concurrent clients to be tested | |
+* | rate               | double | Hz    | 100   | No  | The rate at which each client performs its calls | |
+* | duration           | double | s     | 10    | No  | The duration of the acquisition for each number of clients | |
+* | calls              | vector of strings | - | (getEncoders getControlModes setRefSpeed) | No | The calls performed by each client | |
+* | maxLatency         | double | s     | 0     | No  | If > 0, the 99th percentile of the latency of each call must be below this value | |
+* | maxFailureRate     | double | -     | 0     | No  | The maximum allowed ratio of failed calls | |
+*
+*/
+class ControlBoardContention : public yarp::robottestingframework::TestCase {
+public:
+    ControlBoardContention();
+    virtual ~ControlBoardContention();
+
+    virtual bool setup(yarp::os::Property& property);
+
+    virtual void tearDown();
+
+    virtual void run();
+
+    void runClients(int n_clients);
+
+private:
+    std::string robotName;
+    std::string partName;
+    std::vector<int> clients;
+    std::vector<bool> enabled_calls;
+    double rate;
+    double duration;
+    double maxLatency;
+    double maxFailureRate;
+};
+
+#endif //_CONTROLBOARDCONTENTION_H_
@@ -24,6 +24,7 @@
 #include <yarp/os/Time.h>
 #include <yarp/os/Property.h>
 #include <yarp/os/Vocab.h>
+#include <fstream>
 
 #include "ControlModes.h"
 
@@ -50,6 +51,11 @@ ControlModes::ControlModes() : yarp::robottestingframework::TestCase("ControlMod
     cmd_tot=0;
     prevcurr_some=0;
     prevcurr_tot=0;
+    ipwm=0;
+    icur=0;
+    latency_matrix=false;
+    latency_repetitions=5;
+    latency_timeout=1.0;
 }
 
 ControlModes::~ControlModes() { }
@@ -74,6 +80,14 @@ bool ControlModes::setup(yarp::os::Property& property) {
 
     ROBOTTESTINGFRAMEWORK_TEST_REPORT(robottestingframework::Asserter::format("Tolerance of %.2f is used to check home position", tolerance));
 
+    if(property.check("latencyMatrix"))
+        latency_matrix = property.find("latencyMatrix").asBool();
+    if(property.check("latencyRepetitions"))
+        latency_repetitions = property.find("latencyRepetitions").asInt32();
+    if(property.check("latencyTimeout"))
+        latency_timeout = property.find("latencyTimeout").asFloat64();
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(latency_repetitions>0 && latency_timeout>0, "latencyRepetitions and latencyTimeout must be > 0");
+
     Bottle* jointsBottle = property.find("joints").asList();
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(jointsBottle!=0,"unable to parse joints parameter");
     n_cmd_joints = jointsBottle->size();
@@ -96,6 +110,23 @@ bool ControlModes::setup(yarp::os::Property& property) {
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(itrq),"Unable to open torque control interface");
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(ivar),"Unable to open remote variables interface");
 
+    //pwm and current modes are measured only if the part exposes their interfaces
+    latency_modes.clear();
+    if (latency_matrix)
+    {
+        latency_modes.push_back(VOCAB_CM_POSITION);
+        latency_modes.push_back(VOCAB_CM_POSITION_DIRECT);
+        latency_modes.push_back(VOCAB_CM_VELOCITY);
+        latency_modes.push_back(VOCAB_CM_MIXED);
+        latency_modes.push_back(VOCAB_CM_TORQUE);
+        if (dd->view(ipwm)) latency_modes.push_back(VOCAB_CM_PWM);
+        else ROBOTTESTINGFRAMEWORK_TEST_REPORT("pwm interface not available, pwm mode is not included in the latency matrix");
+        if (dd->view(icur)) latency_modes.push_back(VOCAB_CM_CURRENT);
+        else ROBOTTESTINGFRAMEWORK_TEST_REPORT("current interface not available, current mode is not included in the latency matrix");
+        latency_modes.push_back(VOCAB_CM_IDLE);
+        latency_modes.push_back(VOCAB_CM_FORCE_IDLE);
+    }
+
     if (!ienc->getAxes(&n_part_joints))
     {
         ROBOTTESTINGFRAMEWORK_ASSERT_ERROR("unable to get the number of joints of the part");
@@ -390,6 +421,148 @@ void ControlModes::checkControlModeWithImCompliant(int desired_control_mode, std
     }
 
 }
+bool ControlModes::waitModeActive(int joint, int desired_control_mode, double* latency)
+{
+    //force idle is reported as idle
+    int expected = (desired_control_mode==VOCAB_CM_FORCE_IDLE) ? VOCAB_CM_IDLE : desired_control_mode;
+    double t0 = yarp::os::Time::now();
+    icmd->setControlMode(joint, desired_control_mode);
+    while (1)
+    {
+        int cmode=0;
+        icmd->getControlMode(joint, &cmode);
+        double now = yarp::os::Time::now();
+        if (cmode==expected)
+        {
+            *latency = now-t0;
+            return true;
+        }
+        if (now-t0>latency_timeout) return false;
+    }
+}
+
+bool ControlModes::readReference(int joint, int control_mode, double* value)
+{
+    switch (control_mode)
+    {
+        case VOCAB_CM_POSITION:
+        case VOCAB_CM_MIXED:           return ipos->getTargetPosition(joint, value);
+        case VOCAB_CM_POSITION_DIRECT: return idir->getRefPosition(joint, value);
+        case VOCAB_CM_VELOCITY:        return ivel->getRefVelocity(joint, value);
+        case VOCAB_CM_TORQUE:          return itrq->getRefTorque(joint, value);
+        case VOCAB_CM_PWM:             return ipwm->getRefDutyCycle(joint, value);
+        case VOCAB_CM_CURRENT:         return icur->getRefCurrent(joint, value);
+        default:                       return false;
+    }
+}
+
+bool ControlModes::sendHoldCommand(int joint, int control_mode, double* value)
+{
+    //the command keeps the joint in its current state, so that the measurement does not move the robot
+    switch (control_mode)
+    {
+        case VOCAB_CM_POSITION:
+        case VOCAB_CM_MIXED:           ienc->getEncoder(joint, value); return ipos->positionMove(joint, *value);
+        case VOCAB_CM_POSITION_DIRECT: ienc->getEncoder(joint, value); return idir->setPosition(joint, *value);
+        case VOCAB_CM_VELOCITY:        *value=0.0; return ivel->velocityMove(joint, *value);
+        case VOCAB_CM_TORQUE:          itrq->getTorque(joint, value); return itrq->setRefTorque(joint, *value);
+        case VOCAB_CM_PWM:             ipwm->getDutyCycle(joint, value); return ipwm->setRefDutyCycle(joint, *value);
+        case VOCAB_CM_CURRENT:         icur->getCurrent(joint, value); return icur->setRefCurrent(joint, *value);
+        default:                       return false;
+    }
+}
+
+bool ControlModes::measureCommandLatency(int joint, int control_mode, double* latency)
+{
+    double cmd=0;
+    double t0 = yarp::os::Time::now();
+    if (!sendHoldCommand(joint, control_mode, &cmd)) return false;
+    while (1)
+    {
+        double ref=0;
+        bool ok = readReference(joint, control_mode, &ref);
+        double now = yarp::os::Time::now();
+        if (ok && fabs(ref-cmd)<0.01+0.001*fabs(cmd))
+        {
+            *latency = now-t0;
+            return true;
+        }
+        if (now-t0>latency_timeout) return false;
+    }
+}
+
+void ControlModes::measureTransitionLatencies()
+{
+    int n_modes = latency_modes.size();
+    std::string filename = "controlModesLatency_" + partName + ".txt";
+    std::ofstream fs(filename.c_str());
+    std::string modes_str;
+    for (int m=0; m<n_modes; m++) modes_str += Vocab32::decode((NetInt32)latency_modes[m]) + " ";
+    fs << "#latencies in ms, rows: from mode, columns: to mode, -1: unsupported. Modes: " << modes_str << std::endl;
+
+    for (int i=0; i<n_cmd_joints; i++)
+    {
+        int joint = jointsList[i];
+        yarp::sig::Matrix mode_latency(n_modes, n_modes);
+        yarp::sig::Matrix cmd_latency(n_modes, n_modes);
+        for (int from=0; from<n_modes; from++)
+        {
+            for (int to=0; to<n_modes; to++)
+            {
+                mode_latency(from,to) = -1;
+                cmd_latency(from,to) = -1;
+                //force idle is not a state, the joint is in idle after it
+                if (from==to || latency_modes[from]==VOCAB_CM_FORCE_IDLE) continue;
+                if (!jointTorqueCtrlEnabled[joint] && (latency_modes[from]==VOCAB_CM_TORQUE || latency_modes[to]==VOCAB_CM_TORQUE)) continue;
+
+                double mode_sum=0, cmd_sum=0;
+                int mode_n=0, cmd_n=0;
+                for (int r=0; r<latency_repetitions; r++)
+                {
+                    double lat=0;
+                    setModeSingle(joint, VOCAB_CM_POSITION, VOCAB_IM_STIFF);
+                    if (!waitModeActive(joint, latency_modes[from], &lat)) break;
+                    yarp::os::Time::delay(0.050);
+                    if (!waitModeActive(joint, latency_modes[to], &lat)) break;
+                    mode_sum+=lat; mode_n++;
+                    if (measureCommandLatency(joint, latency_modes[to], &lat)) { cmd_sum+=lat; cmd_n++; }
+                }
+                if (mode_n>0) mode_latency(from,to) = 1000.0*mode_sum/mode_n;
+                if (cmd_n>0)  cmd_latency(from,to) = 1000.0*cmd_sum/cmd_n;
+            }
+        }
+        setModeSingle(joint, VOCAB_CM_POSITION, VOCAB_IM_STIFF);
+        verifyModeSingle(joint, VOCAB_CM_POSITION, VOCAB_IM_STIFF, "latency matrix");
+
+        ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Joint %d, transition latency [ms] (rows: from, columns: to) %s", joint, modes_str.c_str()));
+        fs << "#joint " << joint << " transition" << std::endl;
+        for (int from=0; from<n_modes; from++)
+        {
+            std::string row;
+            for (int to=0; to<n_modes; to++)
+            {
+                row += Asserter::format("%8.3f ", mode_latency(from,to));
+                fs << mode_latency(from,to) << " ";
+            }
+            fs << std::endl;
+            ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("%s: %s", Vocab32::decode((NetInt32)latency_modes[from]).c_str(), row.c_str()));
+        }
+        ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Joint %d, first command latency [ms] (rows: from, columns: to)", joint));
+        fs << "#joint " << joint << " command" << std::endl;
+        for (int from=0; from<n_modes; from++)
+        {
+            std::string row;
+            for (int to=0; to<n_modes; to++)
+            {
+                row += Asserter::format("%8.3f ", cmd_latency(from,to));
+                fs << cmd_latency(from,to) << " ";
+            }
+            fs << std::endl;
+            ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("%s: %s", Vocab32::decode((NetInt32)latency_modes[from]).c_str(), row.c_str()));
+        }
+    }
+}
+
 void ControlModes::run()
 {
     char buff[500];
@@ -559,4 +732,12 @@ void ControlModes::run()
     verifyMode(VOCAB_CM_POSITION,VOCAB_IM_STIFF,"test31");
     verifyAmplifier(0,"test31b");
     goHome();
+
+    if (latency_matrix)
+    {
+        measureTransitionLatencies();
+        setMode(VOCAB_CM_POSITION,VOCAB_IM_STIFF);
+        verifyMode(VOCAB_CM_POSITION,VOCAB_IM_STIFF,"test32");
+        goHome();
+    }
 }
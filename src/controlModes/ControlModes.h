@@ -22,9 +22,11 @@
 #define _CONTROLMODES_H_
 
 #include <string>
+#include <vector>
 #include <yarp/robottestingframework/TestCase.h>
 #include <yarp/dev/ControlBoardInterfaces.h>
 #include <yarp/dev/PolyDriver.h>
+#include <yarp/sig/Matrix.h>
 
 /**
 * \ingroup icub-tests
@@ -35,6 +37,14 @@
 * The test intentionally generates an hardware fault to test the transition between VOCAB_CM_HW_FAULT to VOCAB_CM_IDLE. The fault is generated by zeroing the max current limit.
 * Check of the amplifier internal status (iAmplifier->getAmpStatus) has to be implemented yet.
 *
+* With latencyMatrix=true, at the end of the test the transition latency between every pair of control modes (position, position direct,
+* velocity, mixed, torque, pwm, current, idle, force idle) is measured on each joint. For each (from, to) pair the joint is put in the
+* 'from' mode, then the time between setControlMode('to') and getControlMode() reporting the new mode is measured polling without delays.
+* Then a command holding the current state (e.g. positionMove to the current position, setRefDutyCycle with the current pwm) is sent
+* in the new mode, and the time until the reference readback returns the commanded value is measured too.
+* Each pair is repeated latencyRepetitions times and the joint is put back in position mode after each pair. The mean latencies are
+* reported and saved as matrices (rows: from, columns: to) in controlModesLatency_<part>.txt; unsupported transitions are reported as -1.
+*
 * Example: testRunner -v -t ControlModes.dll -p "--robot icub --part head --joints ""(0 1 2 3 4 5)"" --zero 0"
 *
 * Check the following functions:
@@ -48,6 +58,9 @@
 * | part               | string | -     | -             | Yes      | The name of trhe robot part. | e.g. left_arm |
 * | joints             | vector of ints | -             | Yes      | List of joints to be tested. | |
 * | zero               | double | deg   | -             | Yes      | The home position for the tested joints. | |
+* | latencyMatrix      | bool   | -     | false         | No       | Measure the transition latency matrix at the end of the test. | |
+* | latencyRepetitions | int    | -     | 5             | No       | The number of measurements of each transition. | |
+* | latencyTimeout     | double | s     | 1.0           | No       | A transition or a command not completed within this time is considered unsupported. | |
 */
 
 class ControlModes : public yarp::robottestingframework::TestCase {
@@ -75,6 +88,12 @@ public:
     void checkJointWithTorqueMode();
     void checkControlModeWithImCompliant(int desired_control_mode, std::string title);
 
+    bool waitModeActive(int joint, int desired_control_mode, double* latency);
+    bool readReference(int joint, int control_mode, double* value);
+    bool sendHoldCommand(int joint, int control_mode, double* value);
+    bool measureCommandLatency(int joint, int control_mode, double* latency);
+    void measureTransitionLatencies();
+
 private:
     std::string robotName;
     std::string partName;
@@ -102,6 +121,13 @@ private:
     yarp::dev::IVelocityControl  *ivel;
     yarp::dev::ITorqueControl    *itrq;
     yarp::dev::IRemoteVariables  *ivar;
+    yarp::dev::IPWMControl       *ipwm;
+    yarp::dev::ICurrentControl   *icur;
+
+    bool   latency_matrix;
+    int    latency_repetitions;
+    double latency_timeout;
+    std::vector<int> latency_modes;
 
     double  cmd_single;
     double* cmd_tot;
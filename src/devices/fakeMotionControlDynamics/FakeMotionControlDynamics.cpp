@@ -0,0 +1,1523 @@
+/*
+ * iCub Robot Unit Tests (Robot Testing Framework)
+ *
+ * Copyright (C) 2015-2019 Istituto Italiano di Tecnologia (IIT)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <yarp/os/LogStream.h>
+#include <yarp/os/Time.h>
+#include <yarp/os/Value.h>
+
+#include "FakeMotionControlDynamics.h"
+
+using namespace yarp::os;
+using namespace yarp::dev;
+
+namespace {
+    const double MOTION_DONE_TOLERANCE = 0.1;
+    const int    PID_TYPES_NUM = 4;
+
+    double sign(double x) { return (x > 0.0) ? 1.0 : ((x < 0.0) ? -1.0 : 0.0); }
+}
+
+FakeMotionControlDynamics::FakeMotionControlDynamics() : PeriodicThread(0.001),
+                                                         generator(std::random_device{}()),
+                                                         noise(0.0, 1.0),
+                                                         njoints(0),
+                                                         last_time(0.0),
+                                                         modeSwitchDelay(0.0),
+                                                         ambientTemperature(30.0),
+                                                         thermalGain(0.5),
+                                                         thermalTau(60.0)
+{
+}
+
+FakeMotionControlDynamics::~FakeMotionControlDynamics()
+{
+    close();
+}
+
+bool FakeMotionControlDynamics::readParam(Searchable& config, const std::string& key, double default_value, std::vector<double>& out)
+{
+    out.assign(njoints, default_value);
+    if(!config.check(key))
+        return true;
+    Value& v = config.find(key);
+    if(v.isList()) {
+        Bottle* b = v.asList();
+        if(b->size() != (size_t)njoints) {
+            yError() << "FakeMotionControlDynamics: parameter" << key << "has" << b->size() << "values instead of" << njoints;
+            return false;
+        }
+        for(int i=0; i<njoints; i++)
+            out[i] = b->get(i).asFloat64();
+    }
+    else {
+        out.assign(njoints, v.asFloat64());
+    }
+    return true;
+}
+
+bool FakeMotionControlDynamics::open(Searchable& config)
+{
+    if(!config.check("joints")) {
+        yError() << "FakeMotionControlDynamics: missing 'joints' parameter";
+        return false;
+    }
+    njoints = config.find("joints").asInt32();
+    if(njoints <= 0) {
+        yError() << "FakeMotionControlDynamics: invalid number of joints" << njoints;
+        return false;
+    }
+
+    double period = config.check("simulationPeriod", Value(0.001)).asFloat64();
+    modeSwitchDelay = config.check("modeSwitchDelay", Value(0.0)).asFloat64();
+    ambientTemperature = config.check("ambientTemperature", Value(30.0)).asFloat64();
+    thermalGain = config.check("thermalGain", Value(0.5)).asFloat64();
+    thermalTau = config.check("thermalTau", Value(60.0)).asFloat64();
+
+    std::vector<double> home;
+    bool ok = readParam(config, "tau", 0.02, tau) &&
+              readParam(config, "velTau", 0.05, velTau) &&
+              readParam(config, "pwmGain", 1.0, pwmGain) &&
+              readParam(config, "currentGain", 20.0, currentGain) &&
+              readParam(config, "torqueGain", 10.0, torqueGain) &&
+              readParam(config, "stiction", 0.0, stiction) &&
+              readParam(config, "min", -90.0, minLimit) &&
+              readParam(config, "max", 90.0, maxLimit) &&
+              readParam(config, "velMax", 100.0, velMax) &&
+              readParam(config, "gearbox", 100.0, gearbox) &&
+              readParam(config, "encoderNoise", 0.0, encoderNoise) &&
+              readParam(config, "home", 0.0, home);
+    if(!ok)
+        return false;
+
+    coupling.resize(njoints, njoints);
+    coupling.eye();
+    if(config.check("coupling")) {
+        Bottle* b = config.find("coupling").asList();
+        if(b == nullptr || b->size() != (size_t)(njoints*njoints)) {
+            yError() << "FakeMotionControlDynamics: 'coupling' must be a list of" << njoints*njoints << "values";
+            return false;
+        }
+        for(int r=0; r<njoints; r++)
+            for(int c=0; c<njoints; c++)
+                coupling(r,c) = b->get(r*njoints+c).asFloat64();
+    }
+
+    pos = home;
+    vel.assign(njoints, 0.0);
+    acc.assign(njoints, 0.0);
+    measuredPos = home;
+    motorPos.assign(njoints, 0.0);
+    motorVel.assign(njoints, 0.0);
+    motorAcc.assign(njoints, 0.0);
+    temperature.assign(njoints, ambientTemperature);
+    temperatureLimit.assign(njoints, ambientTemperature + 50.0);
+    maxCurrent.assign(njoints, 5.0);
+    stamp.assign(njoints, Time::now());
+
+    controlMode.assign(njoints, VOCAB_CM_POSITION);
+    pendingMode.assign(njoints, VOCAB_CM_POSITION);
+    pendingModeTime.assign(njoints, 0.0);
+    interactionMode.assign(njoints, VOCAB_IM_STIFF);
+    trajPos = home;
+    trajVel.assign(njoints, 0.0);
+    targetPos = home;
+    refSpeed.assign(njoints, 10.0);
+    refAcc.assign(njoints, 1000.0);
+    directPos = home;
+    refVel.assign(njoints, 0.0);
+    refPwm.assign(njoints, 0.0);
+    refCurrent.assign(njoints, 0.0);
+    refTorque.assign(njoints, 0.0);
+    ampEnabled.assign(njoints, true);
+    output.assign(njoints, 0.0);
+    pids.assign(PID_TYPES_NUM, std::vector<Pid>(njoints));
+
+    for(int i=0; i<njoints; i++) {
+        for(size_t t=0; t<pids.size(); t++) {
+            pids[t][i].setKp(1.0);
+            pids[t][i].setMaxOut(100.0);
+            pids[t][i].setMaxInt(100.0);
+        }
+    }
+    updateMotors();
+
+    last_time = Time::now();
+    setPeriod(period);
+    if(!start()) {
+        yError() << "FakeMotionControlDynamics: unable to start the simulation thread";
+        return false;
+    }
+
+    yInfo() << "FakeMotionControlDynamics: simulating" << njoints << "joints at" << 1.0/period << "Hz";
+    return true;
+}
+
+bool FakeMotionControlDynamics::close()
+{
+    // stop() alone is IPositionControl::stop(), which only stops the joints
+    if(isRunning())
+        PeriodicThread::stop();
+    return true;
+}
+
+void FakeMotionControlDynamics::applyControlMode(int j, int mode)
+{
+    if(mode == VOCAB_CM_FORCE_IDLE)
+        mode = VOCAB_CM_IDLE;
+
+    switch(mode) {
+        case VOCAB_CM_POSITION:
+        case VOCAB_CM_MIXED:
+            trajPos[j] = pos[j];
+            trajVel[j] = 0.0;
+            targetPos[j] = pos[j];
+            break;
+        case VOCAB_CM_POSITION_DIRECT:
+            directPos[j] = pos[j];
+            break;
+        case VOCAB_CM_VELOCITY:
+            trajPos[j] = pos[j];
+            trajVel[j] = 0.0;
+            refVel[j] = 0.0;
+            break;
+        case VOCAB_CM_PWM:
+            refPwm[j] = 0.0;
+            break;
+        case VOCAB_CM_CURRENT:
+            refCurrent[j] = 0.0;
+            break;
+        case VOCAB_CM_TORQUE:
+            refTorque[j] = 0.0;
+            break;
+        default:
+            break;
+    }
+    controlMode[j] = mode;
+}
+
+bool FakeMotionControlDynamics::isPositionDriven(int j) const
+{
+    return controlMode[j] == VOCAB_CM_POSITION || controlMode[j] == VOCAB_CM_MIXED ||
+           controlMode[j] == VOCAB_CM_VELOCITY || controlMode[j] == VOCAB_CM_POSITION_DIRECT;
+}
+
+int FakeMotionControlDynamics::pidIndex(const PidControlTypeEnum& pidtype) const
+{
+    switch(pidtype) {
+        case VOCAB_PIDTYPE_POSITION: return 0;
+        case VOCAB_PIDTYPE_VELOCITY: return 1;
+        case VOCAB_PIDTYPE_TORQUE:   return 2;
+        case VOCAB_PIDTYPE_CURRENT:  return 3;
+        default:                     return -1;
+    }
+}
+
+void FakeMotionControlDynamics::updateJoint(int j, double dt)
+{
+    double prev_pos = pos[j];
+    double prev_vel = vel[j];
+
+    switch(controlMode[j]) {
+        case VOCAB_CM_POSITION:
+        case VOCAB_CM_MIXED:
+        case VOCAB_CM_VELOCITY: {
+            // trapezoidal velocity profile, then first-order tracking of the generated trajectory
+            double a = std::max(refAcc[j], 1e-6);
+            double v_des;
+            if(controlMode[j] == VOCAB_CM_VELOCITY) {
+                v_des = refVel[j];
+            }
+            else {
+                double err = targetPos[j] - trajPos[j];
+                v_des = sign(err) * std::min(refSpeed[j], std::sqrt(2.0 * a * std::fabs(err)));
+            }
+            v_des = std::max(-velMax[j], std::min(velMax[j], v_des));
+            trajVel[j] += std::max(-a*dt, std::min(a*dt, v_des - trajVel[j]));
+            double step = trajVel[j] * dt;
+            if(controlMode[j] != VOCAB_CM_VELOCITY && std::fabs(step) >= std::fabs(targetPos[j] - trajPos[j])) {
+                trajPos[j] = targetPos[j];
+                trajVel[j] = 0.0;
+            }
+            else {
+                trajPos[j] += step;
+            }
+            trajPos[j] = std::max(minLimit[j], std::min(maxLimit[j], trajPos[j]));
+            pos[j] += (trajPos[j] - pos[j]) * std::min(1.0, dt/tau[j]);
+            break;
+        }
+        case VOCAB_CM_POSITION_DIRECT:
+            pos[j] += (directPos[j] - pos[j]) * std::min(1.0, dt/tau[j]);
+            break;
+        case VOCAB_CM_PWM:
+        case VOCAB_CM_CURRENT:
+        case VOCAB_CM_TORQUE: {
+            if(controlMode[j] == VOCAB_CM_PWM)
+                output[j] = refPwm[j];
+            else if(controlMode[j] == VOCAB_CM_CURRENT)
+                output[j] = refCurrent[j] * currentGain[j] / pwmGain[j];
+            else
+                output[j] = refTorque[j] * torqueGain[j] / pwmGain[j];
+
+            double effective = sign(output[j]) * std::max(std::fabs(output[j]) - stiction[j], 0.0);
+            double v_target = ampEnabled[j] ? pwmGain[j] * effective : 0.0;
+            v_target = std::max(-velMax[j], std::min(velMax[j], v_target));
+            vel[j] += (v_target - vel[j]) * std::min(1.0, dt/velTau[j]);
+            pos[j] += vel[j] * dt;
+            break;
+        }
+        default: // idle, force idle, hw fault
+            output[j] = 0.0;
+            vel[j] -= vel[j] * std::min(1.0, dt/velTau[j]);
+            pos[j] += vel[j] * dt;
+            break;
+    }
+
+    // the joint stops against the hardware limits
+    if(pos[j] < minLimit[j] || pos[j] > maxLimit[j]) {
+        pos[j] = std::max(minLimit[j], std::min(maxLimit[j], pos[j]));
+        vel[j] = 0.0;
+    }
+
+    if(isPositionDriven(j)) {
+        vel[j] = (pos[j] - prev_pos) / dt;
+        // the pwm needed to sustain the current velocity, stiction included
+        output[j] = vel[j] / pwmGain[j] + sign(vel[j]) * stiction[j];
+    }
+    acc[j] = (vel[j] - prev_vel) / dt;
+
+    // first-order thermal model driven by the motor current
+    double current = output[j] * pwmGain[j] / currentGain[j];
+    temperature[j] += (ambientTemperature + thermalGain * current * current - temperature[j]) * std::min(1.0, dt/thermalTau);
+
+    measuredPos[j] = pos[j] + encoderNoise[j] * noise(generator);
+}
+
+void FakeMotionControlDynamics::updateMotors()
+{
+    for(int m=0; m<njoints; m++) {
+        double p = 0.0, v = 0.0, a = 0.0;
+        for(int j=0; j<njoints; j++) {
+            p += coupling(m,j) * measuredPos[j];
+            v += coupling(m,j) * vel[j];
+            a += coupling(m,j) * acc[j];
+        }
+        motorPos[m] = gearbox[m] * p;
+        motorVel[m] = gearbox[m] * v;
+        motorAcc[m] = gearbox[m] * a;
+    }
+}
+
+void FakeMotionControlDynamics::run()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    double now = Time::now();
+    double dt = now - last_time;
+    last_time = now;
+    if(dt <= 0.0)
+        return;
+    // do not integrate over long scheduling hiccups
+    dt = std::min(dt, 10.0 * getPeriod());
+
+    for(int j=0; j<njoints; j++) {
+        if(pendingMode[j] != controlMode[j] && now >= pendingModeTime[j])
+            applyControlMode(j, pendingMode[j]);
+        updateJoint(j, dt);
+        stamp[j] = now;
+    }
+    updateMotors();
+}
+
+/* ---------------------------------------------------------------- IEncodersTimed */
+
+bool FakeMotionControlDynamics::getAxes(int *ax)
+{
+    *ax = njoints;
+    return true;
+}
+
+bool FakeMotionControlDynamics::resetEncoder(int j)
+{
+    return setEncoder(j, 0.0);
+}
+
+bool FakeMotionControlDynamics::resetEncoders()
+{
+    std::vector<double> zeros(njoints, 0.0);
+    return setEncoders(zeros.data());
+}
+
+bool FakeMotionControlDynamics::setEncoder(int j, double val)
+{
+    if(!validJoint(j)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    double offset = val - pos[j];
+    pos[j] += offset;
+    measuredPos[j] += offset;
+    trajPos[j] += offset;
+    targetPos[j] += offset;
+    directPos[j] += offset;
+    return true;
+}
+
+bool FakeMotionControlDynamics::setEncoders(const double *vals)
+{
+    for(int j=0; j<njoints; j++)
+        if(!setEncoder(j, vals[j])) return false;
+    return true;
+}
+
+bool FakeMotionControlDynamics::getEncoder(int j, double *v)
+{
+    if(!validJoint(j)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *v = measuredPos[j];
+    return true;
+}
+
+bool FakeMotionControlDynamics::getEncoders(double *encs)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::copy(measuredPos.begin(), measuredPos.end(), encs);
+    return true;
+}
+
+bool FakeMotionControlDynamics::getEncoderSpeed(int j, double *sp)
+{
+    if(!validJoint(j)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *sp = vel[j];
+    return true;
+}
+
+bool FakeMotionControlDynamics::getEncoderSpeeds(double *spds)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::copy(vel.begin(), vel.end(), spds);
+    return true;
+}
+
+bool FakeMotionControlDynamics::getEncoderAcceleration(int j, double *spds)
+{
+    if(!validJoint(j)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *spds = acc[j];
+    return true;
+}
+
+bool FakeMotionControlDynamics::getEncoderAccelerations(double *accs)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::copy(acc.begin(), acc.end(), accs);
+    return true;
+}
+
+bool FakeMotionControlDynamics::getEncodersTimed(double *encs, double *time)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::copy(measuredPos.begin(), measuredPos.end(), encs);
+    std::copy(stamp.begin(), stamp.end(), time);
+    return true;
+}
+
+bool FakeMotionControlDynamics::getEncoderTimed(int j, double *encs, double *time)
+{
+    if(!validJoint(j)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *encs = measuredPos[j];
+    *time = stamp[j];
+    return true;
+}
+
+/* ---------------------------------------------------------------- IMotorEncoders */
+
+bool FakeMotionControlDynamics::getNumberOfMotorEncoders(int *num)
+{
+    *num = njoints;
+    return true;
+}
+
+bool FakeMotionControlDynamics::resetMotorEncoder(int m)
+{
+    return false;
+}
+
+bool FakeMotionControlDynamics::resetMotorEncoders()
+{
+    return false;
+}
+
+bool FakeMotionControlDynamics::setMotorEncoderCountsPerRevolution(int m, const double cpr)
+{
+    return false;
+}
+
+bool FakeMotionControlDynamics::getMotorEncoderCountsPerRevolution(int m, double *cpr)
+{
+    if(!validJoint(m)) return false;
+    *cpr = 360.0;
+    return true;
+}
+
+bool FakeMotionControlDynamics::setMotorEncoder(int m, const double val)
+{
+    return false;
+}
+
+bool FakeMotionControlDynamics::setMotorEncoders(const double *vals)
+{
+    return false;
+}
+
+bool FakeMotionControlDynamics::getMotorEncoder(int m, double *v)
+{
+    if(!validJoint(m)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *v = motorPos[m];
+    return true;
+}
+
+bool FakeMotionControlDynamics::getMotorEncoders(double *encs)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::copy(motorPos.begin(), motorPos.end(), encs);
+    return true;
+}
+
+bool FakeMotionControlDynamics::getMotorEncodersTimed(double *encs, double *time)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::copy(motorPos.begin(), motorPos.end(), encs);
+    std::copy(stamp.begin(), stamp.end(), time);
+    return true;
+}
+
+bool FakeMotionControlDynamics::getMotorEncoderTimed(int m, double *encs, double *time)
+{
+    if(!validJoint(m)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *encs = motorPos[m];
+    *time = stamp[m];
+    return true;
+}
+
+bool FakeMotionControlDynamics::getMotorEncoderSpeed(int m, double *sp)
+{
+    if(!validJoint(m)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *sp = motorVel[m];
+    return true;
+}
+
+bool FakeMotionControlDynamics::getMotorEncoderSpeeds(double *spds)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::copy(motorVel.begin(), motorVel.end(), spds);
+    return true;
+}
+
+bool FakeMotionControlDynamics::getMotorEncoderAcceleration(int m, double *acc_out)
+{
+    if(!validJoint(m)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *acc_out = motorAcc[m];
+    return true;
+}
+
+bool FakeMotionControlDynamics::getMotorEncoderAccelerations(double *accs)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::copy(motorAcc.begin(), motorAcc.end(), accs);
+    return true;
+}
+
+/* ---------------------------------------------------------------- IPositionControl */
+
+bool FakeMotionControlDynamics::positionMove(int j, double ref)
+{
+    if(!validJoint(j)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    if(controlMode[j] != VOCAB_CM_POSITION && controlMode[j] != VOCAB_CM_MIXED)
+        return false;
+    targetPos[j] = std::max(minLimit[j], std::min(maxLimit[j], ref));
+    return true;
+}
+
+bool FakeMotionControlDynamics::positionMove(const double *refs)
+{
+    bool ret = true;
+    for(int j=0; j<njoints; j++)
+        ret &= positionMove(j, refs[j]);
+    return ret;
+}
+
+bool FakeMotionControlDynamics::positionMove(const int n_joint, const int *joints, const double *refs)
+{
+    bool ret = true;
+    for(int i=0; i<n_joint; i++)
+        ret &= positionMove(joints[i], refs[i]);
+    return ret;
+}
+
+bool FakeMotionControlDynamics::relativeMove(int j, double delta)
+{
+    double target;
+    if(!getTargetPosition(j, &target)) return false;
+    return positionMove(j, target + delta);
+}
+
+bool FakeMotionControlDynamics::relativeMove(const double *deltas)
+{
+    bool ret = true;
+    for(int j=0; j<njoints; j++)
+        ret &= relativeMove(j, deltas[j]);
+    return ret;
+}
+
+bool FakeMotionControlDynamics::relativeMove(const int n_joint, const int *joints, const double *deltas)
+{
+    bool ret = true;
+    for(int i=0; i<n_joint; i++)
+        ret &= relativeMove(joints[i], deltas[i]);
+    return ret;
+}
+
+bool FakeMotionControlDynamics::checkMotionDone(int j, bool *flag)
+{
+    if(!validJoint(j)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *flag = (trajPos[j] == targetPos[j]) && std::fabs(pos[j] - targetPos[j]) < MOTION_DONE_TOLERANCE;
+    return true;
+}
+
+bool FakeMotionControlDynamics::checkMotionDone(bool *flag)
+{
+    *flag = true;
+    for(int j=0; j<njoints; j++) {
+        bool done = false;
+        if(!checkMotionDone(j, &done)) return false;
+        *flag &= done;
+    }
+    return true;
+}
+
+bool FakeMotionControlDynamics::checkMotionDone(const int n_joint, const int *joints, bool *flag)
+{
+    *flag = true;
+    for(int i=0; i<n_joint; i++) {
+        bool done = false;
+        if(!checkMotionDone(joints[i], &done)) return false;
+        *flag &= done;
+    }
+    return true;
+}
+
+bool FakeMotionControlDynamics::setRefSpeed(int j, double sp)
+{
+    if(!validJoint(j)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    refSpeed[j] = std::fabs(sp);
+    return true;
+}
+
+bool FakeMotionControlDynamics::setRefSpeeds(const double *spds)
+{
+    for(int j=0; j<njoints; j++)
+        if(!setRefSpeed(j, spds[j])) return false;
+    return true;
+}
+
+bool FakeMotionControlDynamics::setRefSpeeds(const int n_joint, const int *joints, const double *spds)
+{
+    for(int i=0; i<n_joint; i++)
+        if(!setRefSpeed(joints[i], spds[i])) return false;
+    return true;
+}
+
+bool FakeMotionControlDynamics::setRefAcceleration(int j, double acc_ref)
+{
+    if(!validJoint(j)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    refAcc[j] = std::fabs(acc_ref);
+    return true;
+}
+
+bool FakeMotionControlDynamics::setRefAccelerations(const double *accs)
+{
+    for(int j=0; j<njoints; j++)
+        if(!setRefAcceleration(j, accs[j])) return false;
+    return true;
+}
+
+bool FakeMotionControlDynamics::setRefAccelerations(const int n_joint, const int *joints, const double *accs)
+{
+    for(int i=0; i<n_joint; i++)
+        if(!setRefAcceleration(joints[i], accs[i])) return false;
+    return true;
+}
+
+bool FakeMotionControlDynamics::getRefSpeed(int j, double *ref)
+{
+    if(!validJoint(j)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *ref = refSpeed[j];
+    return true;
+}
+
+bool FakeMotionControlDynamics::getRefSpeeds(double *spds)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::copy(refSpeed.begin(), refSpeed.end(), spds);
+    return true;
+}
+
+bool FakeMotionControlDynamics::getRefSpeeds(const int n_joint, const int *joints, double *spds)
+{
+    for(int i=0; i<n_joint; i++)
+        if(!getRefSpeed(joints[i], &spds[i])) return false;
+    return true;
+}
+
+bool FakeMotionControlDynamics::getRefAcceleration(int j, double *acc_ref)
+{
+    if(!validJoint(j)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *acc_ref = refAcc[j];
+    return true;
+}
+
+bool FakeMotionControlDynamics::getRefAccelerations(double *accs)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::copy(refAcc.begin(), refAcc.end(), accs);
+    return true;
+}
+
+bool FakeMotionControlDynamics::getRefAccelerations(const int n_joint, const int *joints, double *accs)
+{
+    for(int i=0; i<n_joint; i++)
+        if(!getRefAcceleration(joints[i], &accs[i])) return false;
+    return true;
+}
+
+bool FakeMotionControlDynamics::stop(int j)
+{
+    if(!validJoint(j)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    targetPos[j] = trajPos[j];
+    trajVel[j] = 0.0;
+    refVel[j] = 0.0;
+    return true;
+}
+
+bool FakeMotionControlDynamics::stop()
+{
+    for(int j=0; j<njoints; j++)
+        if(!stop(j)) return false;
+    return true;
+}
+
+bool FakeMotionControlDynamics::stop(const int n_joint, const int *joints)
+{
+    for(int i=0; i<n_joint; i++)
+        if(!stop(joints[i])) return false;
+    return true;
+}
+
+bool FakeMotionControlDynamics::getTargetPosition(const int joint, double *ref)
+{
+    if(!validJoint(joint)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *ref = targetPos[joint];
+    return true;
+}
+
+bool FakeMotionControlDynamics::getTargetPositions(double *refs)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::copy(targetPos.begin(), targetPos.end(), refs);
+    return true;
+}
+
+bool FakeMotionControlDynamics::getTargetPositions(const int n_joint, const int *joints, double *refs)
+{
+    for(int i=0; i<n_joint; i++)
+        if(!getTargetPosition(joints[i], &refs[i])) return false;
+    return true;
+}
+
+/* ---------------------------------------------------------------- IPositionDirect */
+
+bool FakeMotionControlDynamics::setPosition(int j, double ref)
+{
+    if(!validJoint(j)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    if(controlMode[j] != VOCAB_CM_POSITION_DIRECT)
+        return false;
+    directPos[j] = std::max(minLimit[j], std::min(maxLimit[j], ref));
+    return true;
+}
+
+bool FakeMotionControlDynamics::setPositions(const int n_joint, const int *joints, const double *refs)
+{
+    bool ret = true;
+    for(int i=0; i<n_joint; i++)
+        ret &= setPosition(joints[i], refs[i]);
+    return ret;
+}
+
+bool FakeMotionControlDynamics::setPositions(const double *refs)
+{
+    bool ret = true;
+    for(int j=0; j<njoints; j++)
+        ret &= setPosition(j, refs[j]);
+    return ret;
+}
+
+bool FakeMotionControlDynamics::getRefPosition(const int joint, double *ref)
+{
+    if(!validJoint(joint)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *ref = directPos[joint];
+    return true;
+}
+
+bool FakeMotionControlDynamics::getRefPositions(double *refs)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::copy(directPos.begin(), directPos.end(), refs);
+    return true;
+}
+
+bool FakeMotionControlDynamics::getRefPositions(const int n_joint, const int *joints, double *refs)
+{
+    for(int i=0; i<n_joint; i++)
+        if(!getRefPosition(joints[i], &refs[i])) return false;
+    return true;
+}
+
+/* ---------------------------------------------------------------- IVelocityControl */
+
+bool FakeMotionControlDynamics::velocityMove(int j, double sp)
+{
+    if(!validJoint(j)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    if(controlMode[j] != VOCAB_CM_VELOCITY && controlMode[j] != VOCAB_CM_MIXED)
+        return false;
+    refVel[j] = sp;
+    return true;
+}
+
+bool FakeMotionControlDynamics::velocityMove(const double *sp)
+{
+    bool ret = true;
+    for(int j=0; j<njoints; j++)
+        ret &= velocityMove(j, sp[j]);
+    return ret;
+}
+
+bool FakeMotionControlDynamics::velocityMove(const int n_joint, const int *joints, const double *spds)
+{
+    bool ret = true;
+    for(int i=0; i<n_joint; i++)
+        ret &= velocityMove(joints[i], spds[i]);
+    return ret;
+}
+
+bool FakeMotionControlDynamics::getRefVelocity(const int joint, double *v)
+{
+    if(!validJoint(joint)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *v = refVel[joint];
+    return true;
+}
+
+bool FakeMotionControlDynamics::getRefVelocities(double *vels)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::copy(refVel.begin(), refVel.end(), vels);
+    return true;
+}
+
+bool FakeMotionControlDynamics::getRefVelocities(const int n_joint, const int *joints, double *vels)
+{
+    for(int i=0; i<n_joint; i++)
+        if(!getRefVelocity(joints[i], &vels[i])) return false;
+    return true;
+}
+
+/* ---------------------------------------------------------------- IControlMode */
+
+bool FakeMotionControlDynamics::getControlMode(int j, int *mode)
+{
+    if(!validJoint(j)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *mode = controlMode[j];
+    return true;
+}
+
+bool FakeMotionControlDynamics::getControlModes(int *modes)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::copy(controlMode.begin(), controlMode.end(), modes);
+    return true;
+}
+
+bool FakeMotionControlDynamics::getControlModes(const int n_joint, const int *joints, int *modes)
+{
+    for(int i=0; i<n_joint; i++)
+        if(!getControlMode(joints[i], &modes[i])) return false;
+    return true;
+}
+
+bool FakeMotionControlDynamics::setControlMode(const int j, const int mode)
+{
+    if(!validJoint(j)) return false;
+    switch(mode) {
+        case VOCAB_CM_IDLE:
+        case VOCAB_CM_FORCE_IDLE:
+        case VOCAB_CM_POSITION:
+        case VOCAB_CM_POSITION_DIRECT:
+        case VOCAB_CM_VELOCITY:
+        case VOCAB_CM_MIXED:
+        case VOCAB_CM_PWM:
+        case VOCAB_CM_CURRENT:
+        case VOCAB_CM_TORQUE:
+            break;
+        default:
+            return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if(controlMode[j] == VOCAB_CM_HW_FAULT && mode != VOCAB_CM_FORCE_IDLE)
+        return false;
+    pendingMode[j] = (mode == VOCAB_CM_FORCE_IDLE) ? VOCAB_CM_IDLE : mode;
+    pendingModeTime[j] = Time::now() + modeSwitchDelay;
+    if(modeSwitchDelay <= 0.0)
+        applyControlMode(j, pendingMode[j]);
+    return true;
+}
+
+bool FakeMotionControlDynamics::setControlModes(const int n_joint, const int *joints, int *modes)
+{
+    for(int i=0; i<n_joint; i++)
+        if(!setControlMode(joints[i], modes[i])) return false;
+    return true;
+}
+
+bool FakeMotionControlDynamics::setControlModes(int *modes)
+{
+    for(int j=0; j<njoints; j++)
+        if(!setControlMode(j, modes[j])) return false;
+    return true;
+}
+
+/* ---------------------------------------------------------------- IInteractionMode */
+
+bool FakeMotionControlDynamics::getInteractionMode(int axis, InteractionModeEnum* mode)
+{
+    if(!validJoint(axis)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *mode = interactionMode[axis];
+    return true;
+}
+
+bool FakeMotionControlDynamics::getInteractionModes(int n_joints, int *joints, InteractionModeEnum* modes)
+{
+    for(int i=0; i<n_joints; i++)
+        if(!getInteractionMode(joints[i], &modes[i])) return false;
+    return true;
+}
+
+bool FakeMotionControlDynamics::getInteractionModes(InteractionModeEnum* modes)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::copy(interactionMode.begin(), interactionMode.end(), modes);
+    return true;
+}
+
+bool FakeMotionControlDynamics::setInteractionMode(int axis, InteractionModeEnum mode)
+{
+    if(!validJoint(axis)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    interactionMode[axis] = mode;
+    return true;
+}
+
+bool FakeMotionControlDynamics::setInteractionModes(int n_joints, int *joints, InteractionModeEnum* modes)
+{
+    for(int i=0; i<n_joints; i++)
+        if(!setInteractionMode(joints[i], modes[i])) return false;
+    return true;
+}
+
+bool FakeMotionControlDynamics::setInteractionModes(InteractionModeEnum* modes)
+{
+    for(int j=0; j<njoints; j++)
+        if(!setInteractionMode(j, modes[j])) return false;
+    return true;
+}
+
+/* ---------------------------------------------------------------- IPWMControl */
+
+bool FakeMotionControlDynamics::getNumberOfMotors(int *number)
+{
+    *number = njoints;
+    return true;
+}
+
+bool FakeMotionControlDynamics::setRefDutyCycle(int m, double ref)
+{
+    if(!validJoint(m)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    if(controlMode[m] != VOCAB_CM_PWM)
+        return false;
+    refPwm[m] = ref;
+    return true;
+}
+
+bool FakeMotionControlDynamics::setRefDutyCycles(const double *refs)
+{
+    bool ret = true;
+    for(int m=0; m<njoints; m++)
+        ret &= setRefDutyCycle(m, refs[m]);
+    return ret;
+}
+
+bool FakeMotionControlDynamics::getRefDutyCycle(int m, double *ref)
+{
+    if(!validJoint(m)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *ref = refPwm[m];
+    return true;
+}
+
+bool FakeMotionControlDynamics::getRefDutyCycles(double *refs)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::copy(refPwm.begin(), refPwm.end(), refs);
+    return true;
+}
+
+bool FakeMotionControlDynamics::getDutyCycle(int m, double *val)
+{
+    if(!validJoint(m)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *val = output[m];
+    return true;
+}
+
+bool FakeMotionControlDynamics::getDutyCycles(double *vals)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::copy(output.begin(), output.end(), vals);
+    return true;
+}
+
+/* ---------------------------------------------------------------- ICurrentControl */
+
+bool FakeMotionControlDynamics::getCurrent(int m, double *curr)
+{
+    if(!validJoint(m)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *curr = output[m] * pwmGain[m] / currentGain[m];
+    return true;
+}
+
+bool FakeMotionControlDynamics::getCurrents(double *currs)
+{
+    for(int m=0; m<njoints; m++)
+        if(!getCurrent(m, &currs[m])) return false;
+    return true;
+}
+
+bool FakeMotionControlDynamics::getCurrentRange(int m, double *min, double *max)
+{
+    if(!validJoint(m)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *min = -maxCurrent[m];
+    *max = maxCurrent[m];
+    return true;
+}
+
+bool FakeMotionControlDynamics::getCurrentRanges(double *min, double *max)
+{
+    for(int m=0; m<njoints; m++)
+        if(!getCurrentRange(m, &min[m], &max[m])) return false;
+    return true;
+}
+
+bool FakeMotionControlDynamics::setRefCurrents(const double *currs)
+{
+    bool ret = true;
+    for(int m=0; m<njoints; m++)
+        ret &= setRefCurrent(m, currs[m]);
+    return ret;
+}
+
+bool FakeMotionControlDynamics::setRefCurrent(int m, double curr)
+{
+    if(!validJoint(m)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    if(controlMode[m] != VOCAB_CM_CURRENT)
+        return false;
+    refCurrent[m] = std::max(-maxCurrent[m], std::min(maxCurrent[m], curr));
+    return true;
+}
+
+bool FakeMotionControlDynamics::setRefCurrents(const int n_motor, const int *motors, const double *currs)
+{
+    bool ret = true;
+    for(int i=0; i<n_motor; i++)
+        ret &= setRefCurrent(motors[i], currs[i]);
+    return ret;
+}
+
+bool FakeMotionControlDynamics::getRefCurrents(double *currs)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::copy(refCurrent.begin(), refCurrent.end(), currs);
+    return true;
+}
+
+bool FakeMotionControlDynamics::getRefCurrent(int m, double *curr)
+{
+    if(!validJoint(m)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *curr = refCurrent[m];
+    return true;
+}
+
+/* ---------------------------------------------------------------- ITorqueControl */
+
+bool FakeMotionControlDynamics::getRefTorques(double *t)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::copy(refTorque.begin(), refTorque.end(), t);
+    return true;
+}
+
+bool FakeMotionControlDynamics::getRefTorque(int j, double *t)
+{
+    if(!validJoint(j)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *t = refTorque[j];
+    return true;
+}
+
+bool FakeMotionControlDynamics::setRefTorques(const double *t)
+{
+    bool ret = true;
+    for(int j=0; j<njoints; j++)
+        ret &= setRefTorque(j, t[j]);
+    return ret;
+}
+
+bool FakeMotionControlDynamics::setRefTorque(int j, double t)
+{
+    if(!validJoint(j)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    if(controlMode[j] != VOCAB_CM_TORQUE)
+        return false;
+    refTorque[j] = t;
+    return true;
+}
+
+bool FakeMotionControlDynamics::setRefTorques(const int n_joint, const int *joints, const double *t)
+{
+    bool ret = true;
+    for(int i=0; i<n_joint; i++)
+        ret &= setRefTorque(joints[i], t[i]);
+    return ret;
+}
+
+bool FakeMotionControlDynamics::getTorque(int j, double *t)
+{
+    if(!validJoint(j)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    // the joint torque is the one equivalent to the current output of the motor
+    *t = output[j] * pwmGain[j] / torqueGain[j];
+    return true;
+}
+
+bool FakeMotionControlDynamics::getTorques(double *t)
+{
+    for(int j=0; j<njoints; j++)
+        if(!getTorque(j, &t[j])) return false;
+    return true;
+}
+
+bool FakeMotionControlDynamics::getTorqueRange(int j, double *min, double *max)
+{
+    if(!validJoint(j)) return false;
+    *min = -100.0;
+    *max = 100.0;
+    return true;
+}
+
+bool FakeMotionControlDynamics::getTorqueRanges(double *min, double *max)
+{
+    for(int j=0; j<njoints; j++)
+        if(!getTorqueRange(j, &min[j], &max[j])) return false;
+    return true;
+}
+
+/* ---------------------------------------------------------------- IPidControl */
+
+bool FakeMotionControlDynamics::setPid(const PidControlTypeEnum& pidtype, int j, const Pid &pid)
+{
+    int t = pidIndex(pidtype);
+    if(!validJoint(j) || t < 0) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    pids[t][j] = pid;
+    return true;
+}
+
+bool FakeMotionControlDynamics::setPids(const PidControlTypeEnum& pidtype, const Pid *p)
+{
+    for(int j=0; j<njoints; j++)
+        if(!setPid(pidtype, j, p[j])) return false;
+    return true;
+}
+
+bool FakeMotionControlDynamics::setPidReference(const PidControlTypeEnum& pidtype, int j, double ref)
+{
+    return false;
+}
+
+bool FakeMotionControlDynamics::setPidReferences(const PidControlTypeEnum& pidtype, const double *refs)
+{
+    return false;
+}
+
+bool FakeMotionControlDynamics::setPidErrorLimit(const PidControlTypeEnum& pidtype, int j, double limit)
+{
+    return false;
+}
+
+bool FakeMotionControlDynamics::setPidErrorLimits(const PidControlTypeEnum& pidtype, const double *limits)
+{
+    return false;
+}
+
+bool FakeMotionControlDynamics::getPidError(const PidControlTypeEnum& pidtype, int j, double *err)
+{
+    int t = pidIndex(pidtype);
+    if(!validJoint(j) || t < 0) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    switch(pidtype) {
+        case VOCAB_PIDTYPE_POSITION:
+            *err = ((controlMode[j] == VOCAB_CM_POSITION_DIRECT) ? directPos[j] : trajPos[j]) - pos[j];
+            break;
+        case VOCAB_PIDTYPE_VELOCITY:
+            *err = refVel[j] - vel[j];
+            break;
+        case VOCAB_PIDTYPE_TORQUE:
+            *err = refTorque[j] - output[j] * pwmGain[j] / torqueGain[j];
+            break;
+        default:
+            *err = refCurrent[j] - output[j] * pwmGain[j] / currentGain[j];
+            break;
+    }
+    return true;
+}
+
+bool FakeMotionControlDynamics::getPidErrors(const PidControlTypeEnum& pidtype, double *errs)
+{
+    for(int j=0; j<njoints; j++)
+        if(!getPidError(pidtype, j, &errs[j])) return false;
+    return true;
+}
+
+bool FakeMotionControlDynamics::getPidOutput(const PidControlTypeEnum& pidtype, int j, double *out)
+{
+    if(!validJoint(j) || pidIndex(pidtype) < 0) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *out = output[j];
+    return true;
+}
+
+bool FakeMotionControlDynamics::getPidOutputs(const PidControlTypeEnum& pidtype, double *outs)
+{
+    for(int j=0; j<njoints; j++)
+        if(!getPidOutput(pidtype, j, &outs[j])) return false;
+    return true;
+}
+
+bool FakeMotionControlDynamics::getPid(const PidControlTypeEnum& pidtype, int j, Pid *pid)
+{
+    int t = pidIndex(pidtype);
+    if(!validJoint(j) || t < 0) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *pid = pids[t][j];
+    return true;
+}
+
+bool FakeMotionControlDynamics::getPids(const PidControlTypeEnum& pidtype, Pid *p)
+{
+    for(int j=0; j<njoints; j++)
+        if(!getPid(pidtype, j, &p[j])) return false;
+    return true;
+}
+
+bool FakeMotionControlDynamics::getPidReference(const PidControlTypeEnum& pidtype, int j, double *ref)
+{
+    if(!validJoint(j) || pidIndex(pidtype) < 0) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    switch(pidtype) {
+        case VOCAB_PIDTYPE_POSITION:
+            *ref = (controlMode[j] == VOCAB_CM_POSITION_DIRECT) ? directPos[j] : trajPos[j];
+            break;
+        case VOCAB_PIDTYPE_VELOCITY:
+            *ref = refVel[j];
+            break;
+        case VOCAB_PIDTYPE_TORQUE:
+            *ref = refTorque[j];
+            break;
+        default:
+            *ref = refCurrent[j];
+            break;
+    }
+    return true;
+}
+
+bool FakeMotionControlDynamics::getPidReferences(const PidControlTypeEnum& pidtype, double *refs)
+{
+    for(int j=0; j<njoints; j++)
+        if(!getPidReference(pidtype, j, &refs[j])) return false;
+    return true;
+}
+
+bool FakeMotionControlDynamics::getPidErrorLimit(const PidControlTypeEnum& pidtype, int j, double *limit)
+{
+    return false;
+}
+
+bool FakeMotionControlDynamics::getPidErrorLimits(const PidControlTypeEnum& pidtype, double *limits)
+{
+    return false;
+}
+
+bool FakeMotionControlDynamics::resetPid(const PidControlTypeEnum& pidtype, int j)
+{
+    return validJoint(j) && pidIndex(pidtype) >= 0;
+}
+
+bool FakeMotionControlDynamics::disablePid(const PidControlTypeEnum& pidtype, int j)
+{
+    return validJoint(j) && pidIndex(pidtype) >= 0;
+}
+
+bool FakeMotionControlDynamics::enablePid(const PidControlTypeEnum& pidtype, int j)
+{
+    return validJoint(j) && pidIndex(pidtype) >= 0;
+}
+
+bool FakeMotionControlDynamics::setPidOffset(const PidControlTypeEnum& pidtype, int j, double v)
+{
+    return false;
+}
+
+bool FakeMotionControlDynamics::isPidEnabled(const PidControlTypeEnum& pidtype, int j, bool* enabled)
+{
+    if(!validJoint(j) || pidIndex(pidtype) < 0) return false;
+    *enabled = true;
+    return true;
+}
+
+/* ---------------------------------------------------------------- IAmplifierControl */
+
+bool FakeMotionControlDynamics::enableAmp(int j)
+{
+    if(!validJoint(j)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    ampEnabled[j] = true;
+    return true;
+}
+
+bool FakeMotionControlDynamics::disableAmp(int j)
+{
+    if(!validJoint(j)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    ampEnabled[j] = false;
+    return true;
+}
+
+bool FakeMotionControlDynamics::getAmpStatus(int *st)
+{
+    for(int j=0; j<njoints; j++)
+        if(!getAmpStatus(j, &st[j])) return false;
+    return true;
+}
+
+bool FakeMotionControlDynamics::getAmpStatus(int j, int *v)
+{
+    if(!validJoint(j)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *v = ampEnabled[j] ? 1 : 0;
+    return true;
+}
+
+bool FakeMotionControlDynamics::getMaxCurrent(int j, double *v)
+{
+    if(!validJoint(j)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *v = maxCurrent[j];
+    return true;
+}
+
+bool FakeMotionControlDynamics::setMaxCurrent(int j, double v)
+{
+    if(!validJoint(j)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    maxCurrent[j] = std::fabs(v);
+    return true;
+}
+
+/* ---------------------------------------------------------------- IControlLimits */
+
+bool FakeMotionControlDynamics::setLimits(int axis, double min, double max)
+{
+    if(!validJoint(axis) || min > max) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    minLimit[axis] = min;
+    maxLimit[axis] = max;
+    return true;
+}
+
+bool FakeMotionControlDynamics::getLimits(int axis, double *min, double *max)
+{
+    if(!validJoint(axis)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *min = minLimit[axis];
+    *max = maxLimit[axis];
+    return true;
+}
+
+bool FakeMotionControlDynamics::setVelLimits(int axis, double min, double max)
+{
+    if(!validJoint(axis)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    velMax[axis] = std::max(std::fabs(min), std::fabs(max));
+    return true;
+}
+
+bool FakeMotionControlDynamics::getVelLimits(int axis, double *min, double *max)
+{
+    if(!validJoint(axis)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *min = 0.0;
+    *max = velMax[axis];
+    return true;
+}
+
+/* ---------------------------------------------------------------- IAxisInfo */
+
+bool FakeMotionControlDynamics::getAxisName(int axis, std::string& name)
+{
+    if(!validJoint(axis)) return false;
+    name = "joint" + std::to_string(axis);
+    return true;
+}
+
+bool FakeMotionControlDynamics::getJointType(int axis, JointTypeEnum& type)
+{
+    if(!validJoint(axis)) return false;
+    type = VOCAB_JOINTTYPE_REVOLUTE;
+    return true;
+}
+
+/* ---------------------------------------------------------------- IMotor */
+
+bool FakeMotionControlDynamics::getTemperature(int m, double *val)
+{
+    if(!validJoint(m)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *val = temperature[m];
+    return true;
+}
+
+bool FakeMotionControlDynamics::getTemperatures(double *vals)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::copy(temperature.begin(), temperature.end(), vals);
+    return true;
+}
+
+bool FakeMotionControlDynamics::getTemperatureLimit(int m, double *temp)
+{
+    if(!validJoint(m)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *temp = temperatureLimit[m];
+    return true;
+}
+
+bool FakeMotionControlDynamics::setTemperatureLimit(int m, const double temp)
+{
+    if(!validJoint(m)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    temperatureLimit[m] = temp;
+    return true;
+}
+
+bool FakeMotionControlDynamics::getGearboxRatio(int m, double *val)
+{
+    if(!validJoint(m)) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    *val = gearbox[m];
+    return true;
+}
+
+bool FakeMotionControlDynamics::setGearboxRatio(int m, const double val)
+{
+    if(!validJoint(m) || val == 0.0) return false;
+    std::lock_guard<std::mutex> lock(mtx);
+    gearbox[m] = val;
+    return true;
+}
+
+/* ---------------------------------------------------------------- IRemoteVariables */
+
+bool FakeMotionControlDynamics::getRemoteVariable(std::string key, Bottle& val)
+{
+    val.clear();
+    if(key != "kinematic_mj")
+        return false;
+    // same layout as the real boards: one list with the coupling matrix in row major order
+    std::lock_guard<std::mutex> lock(mtx);
+    Bottle& matrix = val.addList();
+    for(int r=0; r<njoints; r++)
+        for(int c=0; c<njoints; c++)
+            matrix.addFloat64(coupling(r,c));
+    return true;
+}
+
+bool FakeMotionControlDynamics::setRemoteVariable(std::string key, const Bottle& val)
+{
+    return false;
+}
+
+bool FakeMotionControlDynamics::getRemoteVariablesList(Bottle* listOfKeys)
+{
+    listOfKeys->clear();
+    listOfKeys->addString("kinematic_mj");
+    return true;
+}
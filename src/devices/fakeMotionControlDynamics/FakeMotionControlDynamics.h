@@ -0,0 +1,347 @@
+/*
+ * iCub Robot Unit Tests (Robot Testing Framework)
+ *
+ * Copyright (C) 2015-2019 Istituto Italiano di Tecnologia (IIT)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _FAKEMOTIONCONTROLDYNAMICS_H_
+#define _FAKEMOTIONCONTROLDYNAMICS_H_
+
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+#include <yarp/os/Bottle.h>
+#include <yarp/os/PeriodicThread.h>
+#include <yarp/os/Searchable.h>
+#include <yarp/dev/DeviceDriver.h>
+#include <yarp/dev/ControlBoardInterfaces.h>
+#include <yarp/dev/IRemoteVariables.h>
+#include <yarp/sig/Matrix.h>
+
+/**
+* A lightweight stand-in for a motion control board, meant to run the motor tests without a robot or a simulator.
+* Each joint is simulated with first-order dynamics at a fixed rate (1 kHz by default):
+* \li in position, position direct and velocity mode the joint position tracks the (trajectory-generated) reference with time constant tau;
+* \li in pwm, current and torque mode the joint velocity tracks gain*(|output|-stiction) with time constant velTau;
+* \li in idle and force idle mode the joint velocity decays with time constant velTau.
+*
+* The joint positions are saturated to the joint limits, the motor encoders are computed with the coupling matrix and the gearbox ratio,
+* and gaussian noise can be added to the encoder readings. The coupling matrix is exposed as the kinematic_mj remote variable.
+* The device has to be wrapped by a controlBoard_nws_yarp to be used by the tests, e.g.
+*
+* yarpdev --device controlBoard_nws_yarp --subdevice fakeMotionControlDynamics --name /fakeRobot/head --joints 6
+*
+*  Accepts the following parameters:
+* | Parameter name     | Type   | Units | Default Value | Required | Description | Notes |
+* |:------------------:|:------:|:-----:|:-------------:|:--------:|:-----------:|:-----:|
+* | joints             | int    | -     | -     | Yes | The number of joints | |
+* | simulationPeriod   | double | s     | 0.001 | No  | The period of the simulation thread | Not "period", that is read by the wrapper too |
+* | tau                | double or vector of doubles | s | 0.02 | No | The time constant of the position tracking | |
+* | velTau             | double or vector of doubles | s | 0.05 | No | The time constant of the velocity response in pwm, current, torque and idle modes | |
+* | pwmGain            | double or vector of doubles | deg/s | 1.0 | No | The steady-state velocity per unit of pwm | |
+* | currentGain        | double or vector of doubles | deg/s | 20.0 | No | The steady-state velocity per unit of current | |
+* | torqueGain         | double or vector of doubles | deg/s | 10.0 | No | The steady-state velocity per unit of torque | |
+* | stiction           | double or vector of doubles | - | 0.0 | No | The pwm (or current/torque, scaled by the gains) below which the joint does not move | |
+* | min                | double or vector of doubles | deg | -90 | No | The lower joint limit | |
+* | max                | double or vector of doubles | deg | 90 | No | The upper joint limit | |
+* | velMax             | double or vector of doubles | deg/s | 100 | No | The velocity limit | |
+* | gearbox            | double or vector of doubles | - | 100 | No | The gearbox ratio | |
+* | coupling           | vector of doubles of size joints*joints | - | identity | No | The joint to motor coupling matrix, row major | |
+* | encoderNoise       | double or vector of doubles | deg | 0.0 | No | The standard deviation of the noise added to the joint encoders | |
+* | home               | double or vector of doubles | deg | 0.0 | No | The initial joint position | |
+* | modeSwitchDelay    | double | s     | 0.0   | No  | The delay after which a requested control mode becomes active | |
+* | ambientTemperature | double | degC  | 30.0  | No  | The motor temperature at rest | |
+* | thermalGain        | double | degC  | 0.5   | No  | The steady-state temperature rise per squared unit of current | |
+* | thermalTau         | double | s     | 60.0  | No  | The thermal time constant of the motors | |
+*/
+class FakeMotionControlDynamics : public yarp::dev::DeviceDriver,
+                                  public yarp::os::PeriodicThread,
+                                  public yarp::dev::IEncodersTimed,
+                                  public yarp::dev::IMotorEncoders,
+                                  public yarp::dev::IPositionControl,
+                                  public yarp::dev::IPositionDirect,
+                                  public yarp::dev::IVelocityControl,
+                                  public yarp::dev::IControlMode,
+                                  public yarp::dev::IInteractionMode,
+                                  public yarp::dev::IPWMControl,
+                                  public yarp::dev::ICurrentControl,
+                                  public yarp::dev::ITorqueControl,
+                                  public yarp::dev::IPidControl,
+                                  public yarp::dev::IAmplifierControl,
+                                  public yarp::dev::IControlLimits,
+                                  public yarp::dev::IAxisInfo,
+                                  public yarp::dev::IMotor,
+                                  public yarp::dev::IRemoteVariables
+{
+public:
+    FakeMotionControlDynamics();
+    virtual ~FakeMotionControlDynamics();
+
+    // DeviceDriver
+    bool open(yarp::os::Searchable& config) override;
+    bool close() override;
+
+    // PeriodicThread
+    void run() override;
+
+    // IEncodersTimed
+    bool getAxes(int *ax) override;
+    bool resetEncoder(int j) override;
+    bool resetEncoders() override;
+    bool setEncoder(int j, double val) override;
+    bool setEncoders(const double *vals) override;
+    bool getEncoder(int j, double *v) override;
+    bool getEncoders(double *encs) override;
+    bool getEncoderSpeed(int j, double *sp) override;
+    bool getEncoderSpeeds(double *spds) override;
+    bool getEncoderAcceleration(int j, double *spds) override;
+    bool getEncoderAccelerations(double *accs) override;
+    bool getEncodersTimed(double *encs, double *time) override;
+    bool getEncoderTimed(int j, double *encs, double *time) override;
+
+    // IMotorEncoders
+    bool getNumberOfMotorEncoders(int *num) override;
+    bool resetMotorEncoder(int m) override;
+    bool resetMotorEncoders() override;
+    bool setMotorEncoderCountsPerRevolution(int m, const double cpr) override;
+    bool getMotorEncoderCountsPerRevolution(int m, double *cpr) override;
+    bool setMotorEncoder(int m, const double val) override;
+    bool setMotorEncoders(const double *vals) override;
+    bool getMotorEncoder(int m, double *v) override;
+    bool getMotorEncoders(double *encs) override;
+    bool getMotorEncodersTimed(double *encs, double *time) override;
+    bool getMotorEncoderTimed(int m, double *encs, double *time) override;
+    bool getMotorEncoderSpeed(int m, double *sp) override;
+    bool getMotorEncoderSpeeds(double *spds) override;
+    bool getMotorEncoderAcceleration(int m, double *acc) override;
+    bool getMotorEncoderAccelerations(double *accs) override;
+
+    // IPositionControl
+    bool positionMove(int j, double ref) override;
+    bool positionMove(const double *refs) override;
+    bool positionMove(const int n_joint, const int *joints, const double *refs) override;
+    bool relativeMove(int j, double delta) override;
+    bool relativeMove(const double *deltas) override;
+    bool relativeMove(const int n_joint, const int *joints, const double *deltas) override;
+    bool checkMotionDone(int j, bool *flag) override;
+    bool checkMotionDone(bool *flag) override;
+    bool checkMotionDone(const int n_joint, const int *joints, bool *flag) override;
+    bool setRefSpeed(int j, double sp) override;
+    bool setRefSpeeds(const double *spds) override;
+    bool setRefSpeeds(const int n_joint, const int *joints, const double *spds) override;
+    bool setRefAcceleration(int j, double acc) override;
+    bool setRefAccelerations(const double *accs) override;
+    bool setRefAccelerations(const int n_joint, const int *joints, const double *accs) override;
+    bool getRefSpeed(int j, double *ref) override;
+    bool getRefSpeeds(double *spds) override;
+    bool getRefSpeeds(const int n_joint, const int *joints, double *spds) override;
+    bool getRefAcceleration(int j, double *acc) override;
+    bool getRefAccelerations(double *accs) override;
+    bool getRefAccelerations(const int n_joint, const int *joints, double *accs) override;
+    bool stop(int j) override;
+    bool stop() override;
+    bool stop(const int n_joint, const int *joints) override;
+    bool getTargetPosition(const int joint, double *ref) override;
+    bool getTargetPositions(double *refs) override;
+    bool getTargetPositions(const int n_joint, const int *joints, double *refs) override;
+
+    // IPositionDirect
+    bool setPosition(int j, double ref) override;
+    bool setPositions(const int n_joint, const int *joints, const double *refs) override;
+    bool setPositions(const double *refs) override;
+    bool getRefPosition(const int joint, double *ref) override;
+    bool getRefPositions(double *refs) override;
+    bool getRefPositions(const int n_joint, const int *joints, double *refs) override;
+
+    // IVelocityControl
+    bool velocityMove(int j, double sp) override;
+    bool velocityMove(const double *sp) override;
+    bool velocityMove(const int n_joint, const int *joints, const double *spds) override;
+    bool getRefVelocity(const int joint, double *vel) override;
+    bool getRefVelocities(double *vels) override;
+    bool getRefVelocities(const int n_joint, const int *joints, double *vels) override;
+
+    // IControlMode
+    bool getControlMode(int j, int *mode) override;
+    bool getControlModes(int *modes) override;
+    bool getControlModes(const int n_joint, const int *joints, int *modes) override;
+    bool setControlMode(const int j, const int mode) override;
+    bool setControlModes(const int n_joint, const int *joints, int *modes) override;
+    bool setControlModes(int *modes) override;
+
+    // IInteractionMode
+    bool getInteractionMode(int axis, yarp::dev::InteractionModeEnum* mode) override;
+    bool getInteractionModes(int n_joints, int *joints, yarp::dev::InteractionModeEnum* modes) override;
+    bool getInteractionModes(yarp::dev::InteractionModeEnum* modes) override;
+    bool setInteractionMode(int axis, yarp::dev::InteractionModeEnum mode) override;
+    bool setInteractionModes(int n_joints, int *joints, yarp::dev::InteractionModeEnum* modes) override;
+    bool setInteractionModes(yarp::dev::InteractionModeEnum* modes) override;
+
+    // IPWMControl, ICurrentControl and IMotor
+    bool getNumberOfMotors(int *number) override;
+    bool setRefDutyCycle(int m, double ref) override;
+    bool setRefDutyCycles(const double *refs) override;
+    bool getRefDutyCycle(int m, double *ref) override;
+    bool getRefDutyCycles(double *refs) override;
+    bool getDutyCycle(int m, double *val) override;
+    bool getDutyCycles(double *vals) override;
+
+    // ICurrentControl and IAmplifierControl
+    bool getCurrent(int m, double *curr) override;
+    bool getCurrents(double *currs) override;
+    bool getCurrentRange(int m, double *min, double *max) override;
+    bool getCurrentRanges(double *min, double *max) override;
+    bool setRefCurrents(const double *currs) override;
+    bool setRefCurrent(int m, double curr) override;
+    bool setRefCurrents(const int n_motor, const int *motors, const double *currs) override;
+    bool getRefCurrents(double *currs) override;
+    bool getRefCurrent(int m, double *curr) override;
+
+    // ITorqueControl
+    bool getRefTorques(double *t) override;
+    bool getRefTorque(int j, double *t) override;
+    bool setRefTorques(const double *t) override;
+    bool setRefTorque(int j, double t) override;
+    bool setRefTorques(const int n_joint, const int *joints, const double *t) override;
+    bool getTorque(int j, double *t) override;
+    bool getTorques(double *t) override;
+    bool getTorqueRange(int j, double *min, double *max) override;
+    bool getTorqueRanges(double *min, double *max) override;
+
+    // IPidControl
+    bool setPid(const yarp::dev::PidControlTypeEnum& pidtype, int j, const yarp::dev::Pid &pid) override;
+    bool setPids(const yarp::dev::PidControlTypeEnum& pidtype, const yarp::dev::Pid *pids) override;
+    bool setPidReference(const yarp::dev::PidControlTypeEnum& pidtype, int j, double ref) override;
+    bool setPidReferences(const yarp::dev::PidControlTypeEnum& pidtype, const double *refs) override;
+    bool setPidErrorLimit(const yarp::dev::PidControlTypeEnum& pidtype, int j, double limit) override;
+    bool setPidErrorLimits(const yarp::dev::PidControlTypeEnum& pidtype, const double *limits) override;
+    bool getPidError(const yarp::dev::PidControlTypeEnum& pidtype, int j, double *err) override;
+    bool getPidErrors(const yarp::dev::PidControlTypeEnum& pidtype, double *errs) override;
+    bool getPidOutput(const yarp::dev::PidControlTypeEnum& pidtype, int j, double *out) override;
+    bool getPidOutputs(const yarp::dev::PidControlTypeEnum& pidtype, double *outs) override;
+    bool getPid(const yarp::dev::PidControlTypeEnum& pidtype, int j, yarp::dev::Pid *pid) override;
+    bool getPids(const yarp::dev::PidControlTypeEnum& pidtype, yarp::dev::Pid *pids) override;
+    bool getPidReference(const yarp::dev::PidControlTypeEnum& pidtype, int j, double *ref) override;
+    bool getPidReferences(const yarp::dev::PidControlTypeEnum& pidtype, double *refs) override;
+    bool getPidErrorLimit(const yarp::dev::PidControlTypeEnum& pidtype, int j, double *limit) override;
+    bool getPidErrorLimits(const yarp::dev::PidControlTypeEnum& pidtype, double *limits) override;
+    bool resetPid(const yarp::dev::PidControlTypeEnum& pidtype, int j) override;
+    bool disablePid(const yarp::dev::PidControlTypeEnum& pidtype, int j) override;
+    bool enablePid(const yarp::dev::PidControlTypeEnum& pidtype, int j) override;
+    bool setPidOffset(const yarp::dev::PidControlTypeEnum& pidtype, int j, double v) override;
+    bool isPidEnabled(const yarp::dev::PidControlTypeEnum& pidtype, int j, bool* enabled) override;
+
+    // IAmplifierControl
+    bool enableAmp(int j) override;
+    bool disableAmp(int j) override;
+    bool getAmpStatus(int *st) override;
+    bool getAmpStatus(int j, int *v) override;
+    bool getMaxCurrent(int j, double *v) override;
+    bool setMaxCurrent(int j, double v) override;
+
+    // IControlLimits
+    bool setLimits(int axis, double min, double max) override;
+    bool getLimits(int axis, double *min, double *max) override;
+    bool setVelLimits(int axis, double min, double max) override;
+    bool getVelLimits(int axis, double *min, double *max) override;
+
+    // IAxisInfo
+    bool getAxisName(int axis, std::string& name) override;
+    bool getJointType(int axis, yarp::dev::JointTypeEnum& type) override;
+
+    // IMotor
+    bool getTemperature(int m, double *val) override;
+    bool getTemperatures(double *vals) override;
+    bool getTemperatureLimit(int m, double *temp) override;
+    bool setTemperatureLimit(int m, const double temp) override;
+    bool getGearboxRatio(int m, double *val) override;
+    bool setGearboxRatio(int m, const double val) override;
+
+    // IRemoteVariables
+    bool getRemoteVariable(std::string key, yarp::os::Bottle& val) override;
+    bool setRemoteVariable(std::string key, const yarp::os::Bottle& val) override;
+    bool getRemoteVariablesList(yarp::os::Bottle* listOfKeys) override;
+
+private:
+    bool readParam(yarp::os::Searchable& config, const std::string& key, double default_value, std::vector<double>& out);
+    bool validJoint(int j) const { return j>=0 && j<njoints; }
+    void applyControlMode(int j, int mode);
+    void updateJoint(int j, double dt);
+    void updateMotors();
+    int  pidIndex(const yarp::dev::PidControlTypeEnum& pidtype) const;
+    bool isPositionDriven(int j) const;
+
+    std::mutex mtx;
+    std::mt19937 generator;
+    std::normal_distribution<double> noise;
+
+    int    njoints;
+    double last_time;
+    double modeSwitchDelay;
+    double ambientTemperature;
+    double thermalGain;
+    double thermalTau;
+
+    // parameters
+    std::vector<double> tau;
+    std::vector<double> velTau;
+    std::vector<double> pwmGain;
+    std::vector<double> currentGain;
+    std::vector<double> torqueGain;
+    std::vector<double> stiction;
+    std::vector<double> minLimit;
+    std::vector<double> maxLimit;
+    std::vector<double> velMax;
+    std::vector<double> gearbox;
+    std::vector<double> encoderNoise;
+    std::vector<double> temperatureLimit;
+    std::vector<double> maxCurrent;
+    yarp::sig::Matrix   coupling;
+
+    // state
+    std::vector<double> pos;
+    std::vector<double> vel;
+    std::vector<double> acc;
+    std::vector<double> output;
+    std::vector<double> measuredPos;
+    std::vector<double> motorPos;
+    std::vector<double> motorVel;
+    std::vector<double> motorAcc;
+    std::vector<double> temperature;
+    std::vector<double> stamp;
+
+    // references
+    std::vector<int>    controlMode;
+    std::vector<int>    pendingMode;
+    std::vector<double> pendingModeTime;
+    std::vector<yarp::dev::InteractionModeEnum> interactionMode;
+    std::vector<double> trajPos;
+    std::vector<double> trajVel;
+    std::vector<double> targetPos;
+    std::vector<double> refSpeed;
+    std::vector<double> refAcc;
+    std::vector<double> directPos;
+    std::vector<double> refVel;
+    std::vector<double> refPwm;
+    std::vector<double> refCurrent;
+    std::vector<double> refTorque;
+    std::vector<bool>   ampEnabled;
+    std::vector<std::vector<yarp::dev::Pid> > pids;
+};
+
+#endif //_FAKEMOTIONCONTROLDYNAMICS_H_
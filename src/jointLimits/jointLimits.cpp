@@ -50,6 +50,9 @@ JointLimits::JointLimits() : yarp::robottestingframework::TestCase("JointLimits"
     enc_jnt=0;
     original_pids=0;
     pids_saved=false;
+    poll_period=0.01;
+    settle_velocity=0.5;
+    settle_time=0.2;
 }
 
 JointLimits::~JointLimits() { }
@@ -127,6 +130,36 @@ bool JointLimits::setup(yarp::os::Property& property) {
     outputLimit.resize(n_cmd_joints);for (int i=0; i< n_cmd_joints; i++) outputLimit[i]=outputLimitBottle->get(i).asFloat64();
     outOfBoundPos.resize(n_cmd_joints); for (int i = 0; i < n_cmd_joints; i++) { outOfBoundPos[i] = outOfBoundPosition->get(i).asFloat64(); ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(outOfBoundPos[i] > 0 , "outOfBoundPosition must be > 0"); }
     toleranceList.resize(n_cmd_joints);
+
+    joint_groups.clear();
+    if (property.check("jointGroups"))
+    {
+        Bottle* groupsBottle = property.find("jointGroups").asList();
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(groupsBottle!=0,"unable to parse jointGroups parameter");
+        std::vector<bool> grouped(n_cmd_joints, false);
+        for (size_t g=0; g<groupsBottle->size(); g++)
+        {
+            Bottle* groupBottle = groupsBottle->get(g).asList();
+            ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(groupBottle!=0,"unable to parse jointGroups parameter");
+            std::vector<int> group;
+            for (size_t k=0; k<groupBottle->size(); k++)
+            {
+                int jnt = groupBottle->get(k).asInt32();
+                int idx = -1;
+                for (int i=0; i<n_cmd_joints; i++) if ((int)jointsList[i]==jnt) idx=i;
+                ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(idx>=0 && !grouped[idx], Asserter::format("joint %d of jointGroups is not in joints or is in more groups", jnt));
+                grouped[idx]=true;
+                group.push_back(idx);
+            }
+            if (!group.empty()) joint_groups.push_back(group);
+        }
+        for (int i=0; i<n_cmd_joints; i++) if (!grouped[i]) joint_groups.push_back(std::vector<int>(1,i));
+    }
+    if (property.check("pollPeriod"))     poll_period = property.find("pollPeriod").asFloat64();
+    if (property.check("settleVelocity")) settle_velocity = property.find("settleVelocity").asFloat64();
+    if (property.check("settleTime"))     settle_time = property.find("settleTime").asFloat64();
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(poll_period>0 && settle_velocity>0 && settle_time>0, "pollPeriod, settleVelocity and settleTime must be > 0");
+
     for (int i = 0; i < n_cmd_joints; i++)
     {
         if(toleranceListBottle)
@@ -336,6 +369,176 @@ bool JointLimits::goToSingleExceed(int i, double position_to_reach, double limit
         return(false);
 }
 
+//A joint is stopped when it did not move more than settle_velocity*settle_time in the last settle_time seconds.
+//The first start_grace seconds are not checked, to give time to the joint to start the movement.
+struct settle_t
+{
+    double anchor_pos;
+    double anchor_time;
+};
+
+static bool isSettled(settle_t& s, double pos, double now, double band, double settle_time)
+{
+    if (fabs(pos-s.anchor_pos) > band)
+    {
+        s.anchor_pos = pos;
+        s.anchor_time = now;
+    }
+    return (now-s.anchor_time >= settle_time);
+}
+
+static const double start_grace = 0.5;
+
+void JointLimits::goToGroup(const std::vector<int>& group, const std::vector<double>& targets, std::vector<bool>& reached, std::vector<double>& reached_pos)
+{
+    int n = group.size();
+    std::vector<int> joints(n);
+    std::vector<double> speeds(n);
+    std::vector<settle_t> settle(n);
+    std::vector<bool> done(n, false);
+    for (int k=0; k<n; k++) { joints[k]=(int)jointsList[group[k]]; speeds[k]=speed[group[k]]; }
+    reached.assign(n, false);
+    reached_pos.assign(n, 0.0);
+
+    ienc->getEncoders(enc_jnt.data());
+    double start = yarp::os::Time::now();
+    for (int k=0; k<n; k++) { settle[k].anchor_pos=enc_jnt[joints[k]]; settle[k].anchor_time=start; }
+    ipos->setRefSpeeds(n, joints.data(), speeds.data());
+    ipos->positionMove(n, joints.data(), targets.data());
+
+    int pending = n;
+    while (pending>0)
+    {
+        yarp::os::Time::delay(poll_period);
+        double now = yarp::os::Time::now();
+        ienc->getEncoders(enc_jnt.data());
+        for (int k=0; k<n; k++)
+        {
+            if (done[k]) continue;
+            double pos = enc_jnt[joints[k]];
+            reached_pos[k] = pos;
+            bool stopped = isSettled(settle[k], pos, now, settle_velocity*settle_time, settle_time);
+            if (fabs(pos-targets[k])<toleranceList[group[k]])
+            {
+                reached[k]=true;
+                done[k]=true;
+                pending--;
+            }
+            else if ((stopped && now-start>start_grace) || now-start>20.0)
+            {
+                done[k]=true;
+                pending--;
+            }
+        }
+    }
+}
+
+void JointLimits::goToGroupExceed(const std::vector<int>& group, const std::vector<double>& targets, const std::vector<double>& limits,
+                                  const std::vector<double>& reachedLimits, std::vector<bool>& exceeded, std::vector<double>& reached_pos)
+{
+    int n = group.size();
+    std::vector<int> joints(n);
+    std::vector<double> speeds(n);
+    std::vector<double> limitToCheck(n);
+    std::vector<settle_t> settle(n);
+    std::vector<bool> done(n, false);
+    for (int k=0; k<n; k++)
+    {
+        joints[k]=(int)jointsList[group[k]];
+        speeds[k]=speed[group[k]];
+        //if the joint did NOT reach the limit, check that it doesn't exceed the reached position, as in goToSingleExceed
+        limitToCheck[k] = (fabs(reachedLimits[k]-limits[k])>toleranceList[group[k]]) ? reachedLimits[k] : limits[k];
+    }
+    exceeded.assign(n, false);
+    reached_pos.assign(n, 0.0);
+
+    ienc->getEncoders(enc_jnt.data());
+    double start = yarp::os::Time::now();
+    for (int k=0; k<n; k++) { settle[k].anchor_pos=enc_jnt[joints[k]]; settle[k].anchor_time=start; }
+    ipos->setRefSpeeds(n, joints.data(), speeds.data());
+    ipos->positionMove(n, joints.data(), targets.data());
+
+    int pending = n;
+    while (pending>0)
+    {
+        yarp::os::Time::delay(poll_period);
+        double now = yarp::os::Time::now();
+        ienc->getEncoders(enc_jnt.data());
+        for (int k=0; k<n; k++)
+        {
+            if (done[k]) continue;
+            double pos = enc_jnt[joints[k]];
+            reached_pos[k] = pos;
+            bool stopped = isSettled(settle[k], pos, now, settle_velocity*settle_time, settle_time);
+            if (fabs(pos-limitToCheck[k])>toleranceList[group[k]] || fabs(pos-targets[k])<toleranceList[group[k]])
+            {
+                exceeded[k]=true;
+                done[k]=true;
+                pending--;
+            }
+            else if ((stopped && now-start>start_grace) || now-start>10.0)
+            {
+                done[k]=true;
+                pending--;
+            }
+        }
+    }
+}
+
+void JointLimits::testGroup(const std::vector<int>& group)
+{
+    char buff[500];
+    int n = group.size();
+    std::vector<double> targets(n);
+    std::vector<double> limits(n);
+    std::vector<double> reached_lim(n);
+    std::vector<double> reached_pos;
+    std::vector<bool> res;
+
+    std::string joints_str;
+    for (int k=0; k<n; k++) joints_str += Asserter::format("%d ", (int)jointsList[group[k]]);
+
+    //1) Check max limit
+    sprintf(buff,"Testing if max limit is reachable, joints %s",joints_str.c_str());ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+    for (int k=0; k<n; k++) targets[k]=max_lims[group[k]];
+    goToGroup(group, targets, res, reached_lim);
+    for (int k=0; k<n; k++)
+        ROBOTTESTINGFRAMEWORK_TEST_CHECK (res[k], Asserter::format("joint %d moved to max limit: %f reached: %f",  (int)jointsList[group[k]], max_lims[group[k]], reached_lim[k]));
+
+    //2) check that max_limit + outOfBoundPos is NOT reachable
+    sprintf(buff, "Testing that max limit cannot be exceeded, joints %s", joints_str.c_str()); ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+    for (int k=0; k<n; k++) { targets[k]=max_lims[group[k]]+outOfBoundPos[group[k]]; limits[k]=max_lims[group[k]]; }
+    goToGroupExceed(group, targets, limits, reached_lim, res, reached_pos);
+    for (int k=0; k<n; k++)
+        ROBOTTESTINGFRAMEWORK_TEST_CHECK (!res[k], Asserter::format("check if joint %d desn't exced max limit. target was: %f reached: %f, limit %f ",  (int)jointsList[group[k]], targets[k], reached_pos[k], limits[k]));
+
+    //3) Check min limit
+    sprintf(buff,"Testing if min limit is reachable, joints %s",joints_str.c_str());ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+    for (int k=0; k<n; k++) targets[k]=min_lims[group[k]];
+    goToGroup(group, targets, res, reached_lim);
+    for (int k=0; k<n; k++)
+        ROBOTTESTINGFRAMEWORK_TEST_CHECK (res[k], Asserter::format("joint %d moved to min limit: %f reached: %f",  (int)jointsList[group[k]], min_lims[group[k]], reached_lim[k]));
+
+    //4) check that min_limit - outOfBoundPos is NOT reachable
+    sprintf(buff, "Testing that min limit cannot be exceeded, joints %s", joints_str.c_str()); ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+    for (int k=0; k<n; k++) { targets[k]=min_lims[group[k]]-outOfBoundPos[group[k]]; limits[k]=min_lims[group[k]]; }
+    goToGroupExceed(group, targets, limits, reached_lim, res, reached_pos);
+    for (int k=0; k<n; k++)
+        ROBOTTESTINGFRAMEWORK_TEST_CHECK (!res[k], Asserter::format("check if joint %d desn't exced min limit. target was: %f reached: %f, limit %f ",  (int)jointsList[group[k]], targets[k], reached_pos[k], limits[k]));
+
+    //5) Check home position
+    sprintf(buff,"Testing joints %s, homing",joints_str.c_str());ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+    for (int k=0; k<n; k++) targets[k]=home[group[k]];
+    goToGroup(group, targets, res, reached_pos);
+    for (int k=0; k<n; k++)
+    {
+        if(!res[k])
+        {
+            sprintf(buff, "Timeout while reaching desired position(%.2f) of joint %d. Reached pos=%.2f", home[group[k]], (int)jointsList[group[k]], reached_pos[k]);ROBOTTESTINGFRAMEWORK_ASSERT_ERROR(buff);
+        }
+    }
+    sprintf(buff, "Homing joints %s complete", joints_str.c_str()); ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+}
 
 void JointLimits::run()
 {
@@ -352,7 +555,13 @@ void JointLimits::run()
         if (max_lims[i] == 0 && min_lims[i] == 0) ROBOTTESTINGFRAMEWORK_ASSERT_ERROR("Invalid limit: max==min==0");
     }
 
-    for (unsigned int i=0; i<jointsList.size(); i++)
+    for (size_t g=0; g<joint_groups.size(); g++)
+    {
+        testGroup(joint_groups[g]);
+    }
+
+    //without jointGroups the joints are tested one after the other
+    for (unsigned int i=0; i<jointsList.size() && joint_groups.empty(); i++)
     {
         bool res;
         double reached_pos=0;
@@ -22,6 +22,7 @@
 #define _JOINTLIMITS_H_
 
 #include <string>
+#include <vector>
 #include <yarp/robottestingframework/TestCase.h>
 #include <yarp/dev/ControlBoardInterfaces.h>
 #include <yarp/dev/PolyDriver.h>
@@ -42,6 +43,13 @@
 * After testing the limits, this test also tries to move the joint out of the limits on puropose (adding to the joint limits the value of outOfBoundPosition).
 * The test is successfull if the position move command is correctly stopped at the limit.
 *
+* The joints listed in the same group of jointGroups (which must be mechanically independent, so that they can be moved together
+* without collisions) are tested at the same time: each step of the test is commanded with a single multi-joint positionMove and
+* the encoders of the part are read every pollPeriod seconds. A joint completes a step when it reaches the target or when it stops,
+* i.e. its velocity stays below settleVelocity for settleTime seconds, so that a joint which cannot exceed a limit is not polled
+* until a timeout. The results are still reported for each joint and each limit. The joints not listed in any group are tested alone
+* with the same procedure; without jointGroups the joints are tested one after the other as described above.
+*
 * Example: testRunner -v -t JointLimits.dll -p "--robot icub --part head --joints ""(0 1 2)"" --home ""(0 0 0)"" --speed ""(20 20 20)"" --outputLimitPercent ""(30 30 30)"" --outOfBoundPosition ""(2 2 2)"" --tolerance 0.2"
 *
 * Check the following functions:
@@ -68,6 +76,10 @@
 * | tolerance          | vector of doubles of size joints | deg   | - | Yes | The position tolerance used to check if the limit has been properly reached. | Typical value = 0.2 deg. |
 * | outputLimitPercent | vector of doubles of size joints | %     | - | Yes | The maximum motor output (expressed as percentage). | Safe values can be, for example, 30%.|
 * | outOfBoundPosition | vector of doubles of size joints | %     | - | Yes | This value is added the joint limit to test that a position command is not able to move out of the joint limits | Typical value 2 deg.|
+* | jointGroups        | list of vectors of ints | -  | - | No | The groups of joints tested at the same time | e.g. ((0 2) (1 3)) |
+* | pollPeriod         | double | s     | 0.01  | No | The period of the encoders reading | used with jointGroups |
+* | settleVelocity     | double | deg/s | 0.5   | No | A joint is considered stopped when its velocity stays below this value for settleTime | used with jointGroups |
+* | settleTime         | double | s     | 0.2   | No | The time the velocity must stay below settleVelocity | used with jointGroups |
 *
 */
 
@@ -86,6 +98,11 @@ public:
     bool goToSingle(int i, double pos, double *reached_pos);
     bool goToSingleExceed(int i, double position_to_reach, double limit, double reachedLimit, double *reached_pos);
 
+    void goToGroup(const std::vector<int>& group, const std::vector<double>& targets, std::vector<bool>& reached, std::vector<double>& reached_pos);
+    void goToGroupExceed(const std::vector<int>& group, const std::vector<double>& targets, const std::vector<double>& limits,
+                         const std::vector<double>& reachedLimits, std::vector<bool>& exceeded, std::vector<double>& reached_pos);
+    void testGroup(const std::vector<int>& group);
+
     void setMode(int desired_mode);
     void saveToFile(std::string filename, yarp::os::Bottle &b);
 
@@ -96,6 +113,12 @@ private:
 
     double tolerance;
 
+    //groups of indices in jointsList which are tested together (jointGroups parameter)
+    std::vector<std::vector<int> > joint_groups;
+    double poll_period;
+    double settle_velocity;
+    double settle_time;
+
     int    n_part_joints;
 
     yarp::dev::PolyDriver        *dd;
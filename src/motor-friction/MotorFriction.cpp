@@ -0,0 +1,419 @@
+/*
+ * iCub Robot Unit Tests (Robot Testing Framework)
+ *
+ * Copyright (C) 2015-2019 Istituto Italiano di Tecnologia (IIT)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <math.h>
+#include <robottestingframework/TestAssert.h>
+#include <robottestingframework/dll/Plugin.h>
+#include <yarp/os/Time.h>
+#include <yarp/os/Property.h>
+#include <yarp/os/LogStream.h>
+#include <fstream>
+#include <algorithm>
+#include "MotorFriction.h"
+
+using namespace robottestingframework;
+using namespace yarp::os;
+using namespace yarp::dev;
+
+// prepare the plugin
+ROBOTTESTINGFRAMEWORK_PREPARE_PLUGIN(MotorFriction)
+
+MotorFriction::MotorFriction() : yarp::robottestingframework::TestCase("MotorFriction") {
+    dd=0;
+    ipos=0;
+    icmd=0;
+    iimd=0;
+    ienc=0;
+    ipwm=0;
+    ilim=0;
+    levels=5;
+    segment_time=2.0;
+    limit_margin=5.0;
+    use_stribeck=false;
+    max_rms_residual=-1;
+    n_part_joints=0;
+}
+
+MotorFriction::~MotorFriction() { }
+
+bool MotorFriction::setup(yarp::os::Property& property) {
+    if(property.check("name"))
+        setName(property.find("name").asString());
+
+    // updating parameters
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("robot"),  "The robot name must be given as the test parameter!");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("part"),   "The part name must be given as the test parameter!");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("joints"), "The joints list must be given as the test parameter!");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("home"),   "The home position must be given as the test parameter!");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("outputMin"), "The outputMin must be given as the test parameter!");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("outputMax"), "The outputMax must be given as the test parameter!");
+
+    robotName = property.find("robot").asString();
+    partName = property.find("part").asString();
+
+    if (property.check("levels"))           levels = property.find("levels").asInt32();
+    if (property.check("segmentTime"))      segment_time = property.find("segmentTime").asFloat64();
+    if (property.check("limitMargin"))      limit_margin = property.find("limitMargin").asFloat64();
+    if (property.check("stribeck"))         use_stribeck = property.find("stribeck").asBool();
+    if (property.check("max_rms_residual")) max_rms_residual = property.find("max_rms_residual").asFloat64();
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(levels>=2, "levels must be at least 2");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(!use_stribeck || levels>=3, "the Stribeck term needs at least 3 levels");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(segment_time>0, "segmentTime must be greater than zero");
+
+    Bottle* jointsBottle = property.find("joints").asList();
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(jointsBottle!=0,"unable to parse joints parameter");
+    Bottle* homeBottle = property.find("home").asList();
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(homeBottle!=0,"unable to parse home parameter");
+    Bottle* output_min_Bottle = property.find("outputMin").asList();
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(output_min_Bottle!=0,"unable to parse outputMin parameter");
+    Bottle* output_max_Bottle = property.find("outputMax").asList();
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(output_max_Bottle!=0,"unable to parse outputMax parameter");
+
+    Property options;
+    options.put("device", "remote_controlboard");
+    options.put("remote", "/"+robotName+"/"+partName);
+    options.put("local", "/MotorFrictionTest/"+robotName+"/"+partName);
+
+    dd = new PolyDriver(options);
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->isValid(),"Unable to open device driver");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(ipwm),"Unable to open pwm control interface");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(ienc),"Unable to open encoders interface");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(ipos),"Unable to open position interface");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(icmd),"Unable to open control mode interface");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(iimd),"Unable to open interaction mode interface");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(ilim),"Unable to open limits interface");
+
+    if (!ienc->getAxes(&n_part_joints))
+    {
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR("unable to get the number of joints of the part");
+    }
+
+    int n_cmd_joints = jointsBottle->size();
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(n_cmd_joints>0 && n_cmd_joints<=n_part_joints,"invalid number of joints, it must be >0 & <= number of part joints");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE((int)homeBottle->size()==n_cmd_joints &&
+                                                (int)output_min_Bottle->size()==n_cmd_joints &&
+                                                (int)output_max_Bottle->size()==n_cmd_joints, "home, outputMin and outputMax must have one value for each joint");
+    for (int i=0; i <n_cmd_joints; i++) jointsList.push_back(jointsBottle->get(i).asInt32());
+
+    home.resize (n_cmd_joints);    for (int i=0; i< n_cmd_joints; i++) home[i]=homeBottle->get(i).asFloat64();
+    opl_min.resize (n_cmd_joints); for (int i=0; i< n_cmd_joints; i++) opl_min[i]=fabs(output_min_Bottle->get(i).asFloat64());
+    opl_max.resize (n_cmd_joints); for (int i=0; i< n_cmd_joints; i++) opl_max[i]=fabs(output_max_Bottle->get(i).asFloat64());
+    for (int i=0; i< n_cmd_joints; i++) ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(opl_min[i]<opl_max[i], "outputMin must be smaller than outputMax");
+
+    max_lims.resize(n_cmd_joints);
+    min_lims.resize(n_cmd_joints);
+    for (int i=0; i <n_cmd_joints; i++) ilim->getLimits((int)jointsList[i],&min_lims[i],&max_lims[i]);
+
+    size_t n_samples = (size_t)(segment_time/0.010)+10;
+    seg_time.reserve(n_samples);
+    seg_enc.reserve(n_samples);
+
+    return true;
+}
+
+void MotorFriction::tearDown()
+{
+    char buff[500];
+    sprintf(buff,"Closing test module");ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+    if (dd)
+    {
+        for (unsigned int i=0; i<jointsList.size(); i++)
+        {
+            ipwm->setRefDutyCycle((int)jointsList[i], 0.0);
+            setModeSingle(i, VOCAB_CM_POSITION, VOCAB_IM_STIFF);
+            ipos->positionMove((int)jointsList[i],home[i]);
+        }
+        delete dd;
+        dd =0;
+    }
+}
+
+void MotorFriction::setModeSingle(int i, int desired_control_mode, yarp::dev::InteractionModeEnum desired_interaction_mode)
+{
+    icmd->setControlMode((int)jointsList[i],desired_control_mode);
+    iimd->setInteractionMode((int)jointsList[i],desired_interaction_mode);
+    yarp::os::Time::delay(0.010);
+}
+
+void MotorFriction::goHome(int i)
+{
+    char buff[500];
+    setModeSingle(i, VOCAB_CM_POSITION, VOCAB_IM_STIFF);
+    ipos->setRefSpeed((int)jointsList[i],20.0);
+    ipos->positionMove((int)jointsList[i],home[i]);
+
+    double time_started = yarp::os::Time::now();
+    while (1)
+    {
+        double pos;
+        ienc->getEncoder((int)jointsList[i],&pos);
+        if (fabs(pos-home[i])<1.0) break;
+        if (yarp::os::Time::now()-time_started>20)
+        {
+            sprintf(buff,"Timeout while reaching zero position, joint %d, curr_enc %f, home %f", (int)jointsList[i],pos,home[i]);
+            ROBOTTESTINGFRAMEWORK_ASSERT_ERROR(buff);
+        }
+        yarp::os::Time::delay(0.010);
+    }
+    //the segment starts from rest
+    yarp::os::Time::delay(0.2);
+}
+
+bool MotorFriction::runSegment(int i, double opl, double& velocity)
+{
+    char buff[500];
+    int jnt = (int)jointsList[i];
+    seg_time.clear();
+    seg_enc.clear();
+
+    goHome(i);
+    setModeSingle(i, VOCAB_CM_PWM, VOCAB_IM_STIFF);
+
+    bool limit_reached = false;
+    double start_time = yarp::os::Time::now();
+    double next_time = start_time;
+    while (1)
+    {
+        double t = yarp::os::Time::now()-start_time;
+        if (t >= segment_time) break;
+
+        double enc;
+        ipwm->setRefDutyCycle(jnt, opl);
+        ienc->getEncoder(jnt, &enc);
+        seg_time.push_back(t);
+        seg_enc.push_back(enc);
+
+        if (fabs(enc-max_lims[i]) < limit_margin ||
+            fabs(enc-min_lims[i]) < limit_margin )
+        {
+            limit_reached = true;
+            break;
+        }
+
+        next_time += 0.010;
+        double wait = next_time-yarp::os::Time::now();
+        if (wait > 0) yarp::os::Time::delay(wait);
+    }
+    ipwm->setRefDutyCycle(jnt, 0.0);
+
+    //the velocity is the slope of the encoder over the second half of the segment
+    double t_end = seg_time.empty() ? 0 : seg_time.back();
+    double st=0, se=0, stt=0, ste=0;
+    int n=0;
+    for (size_t k=0; k<seg_time.size(); k++)
+    {
+        if (seg_time[k] < 0.5*segment_time) continue;
+        st += seg_time[k];
+        se += seg_enc[k];
+        stt += seg_time[k]*seg_time[k];
+        ste += seg_time[k]*seg_enc[k];
+        n++;
+    }
+    double den = n*stt-st*st;
+    if (n < 10 || fabs(den) < 1e-12)
+    {
+        sprintf(buff,"Joint %d, output %f: segment stopped at %.2f s (hw limit %s), unable to estimate the steady state velocity",
+                jnt, opl, t_end, limit_reached?"reached":"not reached");
+        ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+        return false;
+    }
+    velocity = (n*ste-st*se)/den;
+    if (limit_reached)
+    {
+        sprintf(buff,"Joint %d, output %f: hw limit reached at %.2f s, the velocity is estimated on a shorter window", jnt, opl, t_end);
+        ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+    }
+    return true;
+}
+
+bool MotorFriction::solveLeastSquares(const std::vector<std::vector<double> >& rows, const std::vector<double>& y,
+                                      std::vector<double>& x, double& rms)
+{
+    //normal equations solved with gaussian elimination and partial pivoting
+    size_t m = x.size();
+    if (rows.size() < m) return false;
+    std::vector<std::vector<double> > A(m, std::vector<double>(m+1, 0.0));
+    for (size_t k=0; k<rows.size(); k++)
+    {
+        for (size_t r=0; r<m; r++)
+        {
+            for (size_t c=0; c<m; c++) A[r][c] += rows[k][r]*rows[k][c];
+            A[r][m] += rows[k][r]*y[k];
+        }
+    }
+    for (size_t c=0; c<m; c++)
+    {
+        size_t p = c;
+        for (size_t r=c+1; r<m; r++) if (fabs(A[r][c]) > fabs(A[p][c])) p = r;
+        if (fabs(A[p][c]) < 1e-12) return false;
+        std::swap(A[c], A[p]);
+        for (size_t r=0; r<m; r++)
+        {
+            if (r == c) continue;
+            double f = A[r][c]/A[c][c];
+            for (size_t k=c; k<=m; k++) A[r][k] -= f*A[c][k];
+        }
+    }
+    for (size_t c=0; c<m; c++) x[c] = A[c][m]/A[c][c];
+
+    double sq = 0;
+    for (size_t k=0; k<rows.size(); k++)
+    {
+        double e = y[k];
+        for (size_t c=0; c<m; c++) e -= rows[k][c]*x[c];
+        sq += e*e;
+    }
+    rms = sqrt(sq/rows.size());
+    return true;
+}
+
+bool MotorFriction::fitModel(const std::vector<double>& vel, const std::vector<double>& pwm, bool stribeck, friction_model& model)
+{
+    //the unknowns are (coulomb_pos, coulomb_neg, viscous) and, with the Stribeck term, stribeck for a given stribeck_vel
+    std::vector<std::vector<double> > rows;
+    std::vector<double> y;
+    double v_min = 1e9, v_max = 0;
+    model.n_pos = model.n_neg = 0;
+    for (size_t k=0; k<vel.size(); k++)
+    {
+        if (vel[k] == 0) continue;
+        double s = (vel[k] > 0) ? 1.0 : -1.0;
+        rows.push_back({s > 0 ? 1.0 : 0.0, s < 0 ? -1.0 : 0.0, vel[k]});
+        y.push_back(pwm[k]);
+        if (s > 0) model.n_pos++; else model.n_neg++;
+        v_min = std::min(v_min, fabs(vel[k]));
+        v_max = std::max(v_max, fabs(vel[k]));
+    }
+    //the viscous term is shared, each Coulomb term needs at least one sample
+    if (model.n_pos < 1 || model.n_neg < 1 || rows.size() < 3) return false;
+
+    std::vector<double> x(3);
+    double rms;
+    if (!solveLeastSquares(rows, y, x, rms)) return false;
+    model.coulomb_pos = x[0];
+    model.coulomb_neg = x[1];
+    model.viscous = x[2];
+    model.stribeck = 0;
+    model.stribeck_vel = 0;
+    model.rms_residual = rms;
+
+    if (stribeck && rows.size() >= 4)
+    {
+        //the model is linear once the Stribeck velocity is fixed: the velocity is searched on a logarithmic grid
+        //spanning the measured velocities, keeping the fit with the smallest residual
+        const int grid = 30;
+        std::vector<std::vector<double> > rows_s(rows.size(), std::vector<double>(4));
+        std::vector<double> x_s(4);
+        for (int g=0; g<grid; g++)
+        {
+            double vs = v_min*0.5*pow(4.0*v_max/v_min, (double)g/(grid-1));
+            size_t j = 0;
+            for (size_t k=0; k<vel.size(); k++)
+            {
+                if (vel[k] == 0) continue;
+                double s = (vel[k] > 0) ? 1.0 : -1.0;
+                rows_s[j] = rows[j];
+                rows_s[j].push_back(s*exp(-(vel[k]/vs)*(vel[k]/vs)));
+                j++;
+            }
+            double rms_s;
+            if (solveLeastSquares(rows_s, y, x_s, rms_s) && rms_s < model.rms_residual)
+            {
+                model.coulomb_pos = x_s[0];
+                model.coulomb_neg = x_s[1];
+                model.viscous = x_s[2];
+                model.stribeck = x_s[3];
+                model.stribeck_vel = vs;
+                model.rms_residual = rms_s;
+            }
+        }
+    }
+    model.valid = true;
+    return true;
+}
+
+void MotorFriction::run()
+{
+    char buff[500];
+    std::vector<friction_model> models;
+
+    std::string segments_filename = "motorFriction_" + partName + "_segments.txt";
+    std::ofstream segments_file(segments_filename.c_str());
+    segments_file << "#joint output velocity" << std::endl;
+
+    std::vector<double> vel;
+    std::vector<double> pwm;
+    vel.reserve(2*levels);
+    pwm.reserve(2*levels);
+
+    for (unsigned int i=0 ; i<jointsList.size(); i++)
+    {
+        vel.clear();
+        pwm.clear();
+        for (int l=0; l<levels; l++)
+        {
+            double level = opl_min[i]+(opl_max[i]-opl_min[i])*l/(levels-1);
+            for (int sign=1; sign>=-1; sign-=2)
+            {
+                double opl = sign*level;
+                sprintf(buff,"Testing joint %d, output %f",(int)jointsList[i],opl);ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+                double v;
+                if (!runSegment(i, opl, v)) continue;
+                //a segment which did not move gives no information on the friction at a velocity
+                if (fabs(v) < 1e-3 || v*opl < 0)
+                {
+                    sprintf(buff,"Joint %d did not move with output %f (velocity %f deg/s), segment discarded",(int)jointsList[i],opl,v);ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+                    continue;
+                }
+                vel.push_back(v);
+                pwm.push_back(opl);
+                segments_file << (int)jointsList[i] << " " << opl << " " << v << std::endl;
+            }
+        }
+        goHome(i);
+
+        friction_model model;
+        model.jnt = (int)jointsList[i];
+        bool ok = fitModel(vel, pwm, use_stribeck, model);
+        ROBOTTESTINGFRAMEWORK_TEST_CHECK(ok, Asserter::format("Joint %d: friction model fitted on %d segments (%d positive, %d negative)",
+                                                              model.jnt, (int)vel.size(), model.n_pos, model.n_neg));
+        if (ok && max_rms_residual >= 0)
+        {
+            ROBOTTESTINGFRAMEWORK_TEST_CHECK(model.rms_residual <= max_rms_residual,
+                                             Asserter::format("Joint %d: rms residual %f (max %f)", model.jnt, model.rms_residual, max_rms_residual));
+        }
+        models.push_back(model);
+    }
+
+    std::string filename = "motorFriction_" + partName + ".txt";
+    std::ofstream fs(filename.c_str());
+    fs << "#joint coulomb_pos coulomb_neg viscous stribeck stribeck_vel rms_residual" << std::endl;
+    ROBOTTESTINGFRAMEWORK_TEST_REPORT("joint | coulomb+ | coulomb- | viscous [pwm/(deg/s)] | stribeck | stribeck vel [deg/s] | rms residual");
+    for (size_t k=0; k<models.size(); k++)
+    {
+        const friction_model& m = models[k];
+        if (!m.valid) continue;
+        ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("%5d | %8.3f | %8.3f | %21.5f | %8.3f | %20.3f | %12.3f",
+                                                           m.jnt, m.coulomb_pos, m.coulomb_neg, m.viscous, m.stribeck, m.stribeck_vel, m.rms_residual));
+        fs << m.jnt << " " << m.coulomb_pos << " " << m.coulomb_neg << " " << m.viscous << " "
+           << m.stribeck << " " << m.stribeck_vel << " " << m.rms_residual << std::endl;
+    }
+    yInfo() << "Friction parameters saved to" << filename;
+}
@@ -0,0 +1,139 @@
+/*
+ * iCub Robot Unit Tests (Robot Testing Framework)
+ *
+ * Copyright (C) 2015-2019 Istituto Italiano di Tecnologia (IIT)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _MOTORFRICTION_H_
+#define _MOTORFRICTION_H_
+
+#include <string>
+#include <vector>
+#include <yarp/robottestingframework/TestCase.h>
+#include <yarp/dev/ControlBoardInterfaces.h>
+#include <yarp/dev/PolyDriver.h>
+#include <yarp/sig/Vector.h>
+
+/**
+* The friction model of a joint, expressed in pwm units: at steady state the pwm balances the friction
+* pwm = coulomb_pos + viscous*v + stribeck*exp(-(v/stribeck_vel)^2)   if v>0
+* pwm = -coulomb_neg + viscous*v - stribeck*exp(-(v/stribeck_vel)^2)  if v<0
+*/
+class friction_model
+{
+    public:
+    int    jnt;
+    bool   valid;
+    int    n_pos;
+    int    n_neg;
+    double coulomb_pos;
+    double coulomb_neg;
+    double viscous;
+    double stribeck;
+    double stribeck_vel;
+    double rms_residual;
+
+    public:
+    friction_model() {jnt=0; valid=false; n_pos=0; n_neg=0; coulomb_pos=0; coulomb_neg=0; viscous=0; stribeck=0; stribeck_vel=0; rms_residual=0;}
+};
+
+/**
+* \ingroup icub-tests
+* This test identifies the friction of the joints in pwm control.
+* For each joint, constant pwm segments are applied at several levels (linearly spaced from outputMin to outputMax) in both
+* directions. Each segment starts from the home position and lasts segmentTime seconds; the steady state velocity is the slope
+* of the linear fit of the encoder over the second half of the segment. As in MotorStiction, a segment is stopped if the joint
+* gets close to its hardware limits (limitMargin), so the levels must be chosen such that the joints reach a steady velocity
+* within the range of motion.
+* The Coulomb + viscous friction model (see friction_model) is fitted in process by least squares over the steady state
+* velocities; with stribeck=true the Stribeck term is also estimated, searching the Stribeck velocity on a grid.
+* The parameters of all the joints are reported and saved in the table motorFriction_<part>.txt, the steady state velocities
+* of each segment in motorFriction_<part>_segments.txt.
+*
+* Example: testRunner -v -t MotorFriction.dll -p "--robot icub --part head --joints ""(0 1 2)"" --home ""(0 0 0)"" --outputMin ""(5 5 5)"" --outputMax ""(20 20 20)"" --levels 5"
+*
+*  Accepts the following parameters:
+* | Parameter name     | Type   | Units | Default Value | Required | Description | Notes |
+* |:------------------:|:------:|:-----:|:-------------:|:--------:|:-----------:|:-----:|
+* | robot              | string | -     | -     | Yes | The name of the robot.     | e.g. icub |
+* | part               | string | -     | -     | Yes | The name of the robot part. | e.g. left_arm |
+* | joints             | vector of ints | - | - | Yes | List of joints to be tested | |
+* | home               | vector of doubles | deg | - | Yes | The starting position of each segment, for each joint | |
+* | outputMin          | vector of doubles | pwm | - | Yes | The smallest pwm level, for each joint | should be above the breakaway value |
+* | outputMax          | vector of doubles | pwm | - | Yes | The largest pwm level, for each joint | |
+* | levels             | int    | -     | 5     | No  | The number of pwm levels in each direction | at least 2 |
+* | segmentTime        | double | s     | 2.0   | No  | The duration of each constant pwm segment | |
+* | limitMargin        | double | deg   | 5.0   | No  | A segment is stopped when the joint is closer than this to a hardware limit | |
+* | stribeck           | bool   | -     | false | No  | Estimate also the Stribeck term | needs at least 3 levels |
+* | max_rms_residual   | double | pwm   | -     | No  | The maximum rms residual of the fit | |
+*
+*/
+class MotorFriction : public yarp::robottestingframework::TestCase
+{
+public:
+    MotorFriction();
+    virtual ~MotorFriction();
+
+    virtual bool setup(yarp::os::Property& property);
+
+    virtual void tearDown();
+
+    virtual void run();
+
+    void goHome(int i);
+    void setModeSingle(int i, int desired_control_mode, yarp::dev::InteractionModeEnum desired_interaction_mode);
+
+    //applies a constant pwm from the home position and returns the steady state velocity. Returns false if the
+    //segment was stopped too early to estimate the velocity
+    bool runSegment(int i, double opl, double& velocity);
+
+    //least squares fit of the friction model on the (velocity, pwm) samples
+    static bool fitModel(const std::vector<double>& vel, const std::vector<double>& pwm, bool stribeck, friction_model& model);
+
+private:
+    static bool solveLeastSquares(const std::vector<std::vector<double> >& rows, const std::vector<double>& y,
+                                  std::vector<double>& x, double& rms);
+
+    std::string robotName;
+    std::string partName;
+    yarp::sig::Vector jointsList;
+    yarp::sig::Vector home;
+    yarp::sig::Vector opl_min;
+    yarp::sig::Vector opl_max;
+    yarp::sig::Vector max_lims;
+    yarp::sig::Vector min_lims;
+    int    levels;
+    double segment_time;
+    double limit_margin;
+    bool   use_stribeck;
+    double max_rms_residual;
+    int    n_part_joints;
+
+    // samples of the current segment, preallocated in setup()
+    std::vector<double> seg_time;
+    std::vector<double> seg_enc;
+
+    yarp::dev::PolyDriver        *dd;
+    yarp::dev::IPositionControl *ipos;
+    yarp::dev::IControlMode     *icmd;
+    yarp::dev::IInteractionMode  *iimd;
+    yarp::dev::IEncoders         *ienc;
+    yarp::dev::IPWMControl       *ipwm;
+    yarp::dev::IControlLimits    *ilim;
+};
+
+#endif //_MOTORFRICTION_H_
@@ -30,6 +30,15 @@
 #include "MotorStiction.h"
 
 //example1    -v -t MotorStiction.dll -p "--robot icub --part left_arm --joints ""(4)"" --home ""(45)"" --outputStep ""(0.5)"" --outputMax ""(50)"" --outputDelay ""(2.0)""  --threshold ""(5.0)"" "
+//example2    -v -t MotorStiction.dll -p "--robot icub --part left_arm --joints ""(4)"" --home ""(45)"" --outputStep ""(0.5)"" --outputMax ""(50)"" --outputDelay ""(2.0)""  --threshold ""(5.0)"" --search adaptive --coarseFactor 8"
+//
+//search ramp (default): the output is increased by outputStep every outputDelay seconds until the joint moves of threshold degrees.
+//search adaptive: the output is increased by coarseFactor*outputStep every outputDelay seconds until the joint moves, then the joint
+//is brought back to its starting position and the breakaway output is bisected with probes lasting outputDelay seconds, starting
+//from rest, until the interval is not larger than outputStep. The same resolution of the ramp is obtained with far less steps.
+//
+//jointGroups ((0 1) (2)): the joints of each group (which must be listed in joints, and must be mechanically independent) are
+//tested at the same time with the ramp search. The joints not listed in any group are tested alone.
 
 using namespace robottestingframework;
 using namespace yarp::os;
@@ -47,6 +56,8 @@ MotorStiction::MotorStiction() : yarp::robottestingframework::TestCase("MotorSti
     iimd=0;
     ienc=0;
     ipwm = 0;
+    adaptive_search = false;
+    coarse_factor = 8;
 }
 
 MotorStiction::~MotorStiction() { }
@@ -67,6 +78,16 @@ bool MotorStiction::setup(yarp::os::Property& property) {
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("threshold"),     "The threshold must be given as the test parameter!");
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("repeat"),        "The repeat must be given as the test parameter!");
 
+    if (property.check("search"))
+    {
+        std::string search = property.find("search").asString();
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(search=="ramp" || search=="adaptive", "search must be ramp or adaptive");
+        adaptive_search = (search=="adaptive");
+    }
+    if (property.check("coarseFactor"))
+        coarse_factor = property.find("coarseFactor").asFloat64();
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(coarse_factor>=1, "coarseFactor must be >= 1");
+
     robotName = property.find("robot").asString();
     partName = property.find("part").asString();
 
@@ -121,6 +142,32 @@ bool MotorStiction::setup(yarp::os::Property& property) {
     opl_max.resize (n_cmd_joints);            for (int i=0; i< n_cmd_joints; i++) opl_max[i]=output_max_Bottle->get(i).asFloat64();
     movement_threshold.resize (n_cmd_joints); for (int i=0; i< n_cmd_joints; i++) movement_threshold[i]=threshold_Bottle->get(i).asFloat64();
 
+    joint_groups.clear();
+    if (property.check("jointGroups"))
+    {
+        Bottle* groupsBottle = property.find("jointGroups").asList();
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(groupsBottle!=0,"unable to parse jointGroups parameter");
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(!adaptive_search,"jointGroups is supported only with the ramp search");
+        std::vector<bool> grouped(n_cmd_joints, false);
+        for (size_t g=0; g<groupsBottle->size(); g++)
+        {
+            Bottle* groupBottle = groupsBottle->get(g).asList();
+            ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(groupBottle!=0,"unable to parse jointGroups parameter");
+            std::vector<int> group;
+            for (size_t k=0; k<groupBottle->size(); k++)
+            {
+                int jnt = groupBottle->get(k).asInt32();
+                int idx = -1;
+                for (int i=0; i<n_cmd_joints; i++) if ((int)jointsList[i]==jnt) idx=i;
+                ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(idx>=0 && !grouped[idx], Asserter::format("joint %d of jointGroups is not in joints or is in more groups", jnt));
+                grouped[idx]=true;
+                group.push_back(idx);
+            }
+            if (!group.empty()) joint_groups.push_back(group);
+        }
+        for (int i=0; i<n_cmd_joints; i++) if (!grouped[i]) joint_groups.push_back(std::vector<int>(1,i));
+    }
+
     max_lims.resize(n_cmd_joints);
     min_lims.resize(n_cmd_joints);
     for (int i=0; i <n_cmd_joints; i++) ilim->getLimits((int)jointsList[i],&min_lims[i],&max_lims[i]);
@@ -382,6 +429,261 @@ void MotorStiction::OplExecute2(int i, std::vector<yarp::os::Bottle>& dataToPlot
     }
 }
 
+MotorStiction::probe_result_t MotorStiction::OplHold(int i, double opl, double duration, Bottle& dataToPlot)
+{
+    //the movement is measured from the position at the start of the probe, since restJoint() brings the joint back only within 1 deg
+    double probe_enc=0;
+    ienc->getEncoder((int)jointsList[i],&probe_enc);
+    double time_started = yarp::os::Time::now();
+    double enc = probe_enc;
+    ipwm->setRefDutyCycle((int)jointsList[i], opl);
+    while (yarp::os::Time::now()-time_started < duration)
+    {
+        ienc->getEncoder((int)jointsList[i],&enc);
+
+        Bottle& row = dataToPlot.addList();
+        Bottle& v1 = row.addList();
+        Bottle& v2 = row.addList();
+        v1.addFloat64(yarp::os::Time::now());
+        v2.addFloat64(enc);
+        v2.addFloat64(opl);
+
+        if (fabs(enc-max_lims[i]) < 1.0 ||
+            fabs(enc-min_lims[i]) < 1.0 )
+        {
+            ipwm->setRefDutyCycle((int)jointsList[i], 0.0);
+            return probe_limit;
+        }
+        if (fabs(enc-probe_enc)>movement_threshold[i])
+        {
+            ipwm->setRefDutyCycle((int)jointsList[i], 0.0);
+            return probe_moved;
+        }
+        yarp::os::Time::delay(0.010);
+    }
+    ipwm->setRefDutyCycle((int)jointsList[i], 0.0);
+    return probe_still;
+}
+
+void MotorStiction::restJoint(int i, double position)
+{
+    char buff[500];
+    setModeSingle(i, VOCAB_CM_POSITION, VOCAB_IM_STIFF);
+    ipos->setRefSpeed((int)jointsList[i],20.0);
+    ipos->positionMove((int)jointsList[i],position);
+
+    double time_started = yarp::os::Time::now();
+    while (1)
+    {
+        double pos;
+        ienc->getEncoder((int)jointsList[i],&pos);
+        if (fabs(pos-position)<1.0) break;
+        if (yarp::os::Time::now()-time_started>20)
+        {
+            sprintf(buff,"Timeout while returning to the starting position, joint %d, curr_enc %f, target %f", (int)jointsList[i],pos,position);
+            ROBOTTESTINGFRAMEWORK_ASSERT_ERROR(buff);
+        }
+        yarp::os::Time::delay(0.010);
+    }
+    //let the joint settle, so that each probe starts from rest
+    yarp::os::Time::delay(0.2);
+    setModeSingle(i, VOCAB_CM_PWM, VOCAB_IM_STIFF);
+    ipwm->setRefDutyCycle((int)jointsList[i], 0.0);
+}
+
+void MotorStiction::OplSearch(int i, std::vector<yarp::os::Bottle>& dataToPlotList, stiction_data& current_test, bool positive_sign)
+{
+    char buff[500];
+    double sign = positive_sign ? 1.0 : -1.0;
+    double start_enc=0;
+    ienc->getEncoder((int)jointsList[i],&start_enc);
+    setModeSingle(i, VOCAB_CM_PWM, VOCAB_IM_STIFF);
+    ipwm->setRefDutyCycle((int)jointsList[i], 0.0);
+    Bottle dataToPlot;
+
+    //coarse ramp: the breakaway output (in absolute value) is in (lower, upper]
+    double coarse_step = opl_step[i]*coarse_factor;
+    double lower = 0;
+    double upper = 0;
+    probe_result_t res = probe_still;
+    while (res == probe_still)
+    {
+        upper = std::min(lower+coarse_step, fabs(opl_max[i]));
+        res = OplHold(i, sign*upper, opl_delay[i], dataToPlot);
+        if (res == probe_still)
+        {
+            if (upper >= fabs(opl_max[i])) break;
+            lower = upper;
+        }
+    }
+
+    bool passed = (res == probe_moved);
+    if (res == probe_still)
+    {
+        sprintf(buff,"Test failed failed because max output was reached(output=%f)",sign*upper);ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+    }
+    else if (res == probe_limit)
+    {
+        sprintf(buff,"Test failed because hw limit was touched (output=%f)",sign*upper);ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+    }
+    else
+    {
+        sprintf(buff,"Coarse ramp: breakaway output in (%f, %f], bisecting",sign*lower,sign*upper);ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+        restJoint(i, start_enc);
+
+        //bisection, each probe starts from rest
+        int probes = 0;
+        while (upper-lower > opl_step[i])
+        {
+            double mid = 0.5*(lower+upper);
+            res = OplHold(i, sign*mid, opl_delay[i], dataToPlot);
+            probes++;
+            if (res == probe_limit)
+            {
+                passed = false;
+                sprintf(buff,"Test failed because hw limit was touched (output=%f)",sign*mid);ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+                break;
+            }
+            if (res == probe_moved)
+            {
+                upper = mid;
+                restJoint(i, start_enc);
+            }
+            else
+            {
+                lower = mid;
+                //the joint may have crept without reaching the threshold
+                double enc;
+                ienc->getEncoder((int)jointsList[i],&enc);
+                if (fabs(enc-start_enc)>movement_threshold[i]/2) restJoint(i, start_enc);
+            }
+        }
+        if (passed)
+        {
+            sprintf(buff,"Test success (output=%f +- %f, %d probes)",sign*0.5*(lower+upper),0.5*(upper-lower),probes);ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+        }
+    }
+
+    double opl = passed ? sign*0.5*(lower+upper) : sign*upper;
+    double ci = passed ? 0.5*(upper-lower) : 0;
+    if (positive_sign) {current_test.pos_opl=opl; current_test.pos_ci=ci; current_test.pos_test_passed=passed;}
+    else               {current_test.neg_opl=opl; current_test.neg_ci=ci; current_test.neg_test_passed=passed;}
+    ipwm->setRefDutyCycle((int)jointsList[i], 0.0);
+    dataToPlotList.push_back(dataToPlot);
+}
+
+void MotorStiction::OplExecuteGroup(const std::vector<int>& group, std::vector<stiction_data>& current_tests, bool positive_sign)
+{
+    //the state of the ramp of each joint of the group
+    struct ramp_t
+    {
+        bool   running;
+        double opl;
+        double start_enc;
+        double last_opl_cmd;
+        Bottle dataToPlot;
+    };
+
+    char buff[500];
+    const double period = 0.010;
+    std::vector<double> encs(n_part_joints);
+    std::vector<ramp_t> ramps(group.size());
+
+    ienc->getEncoders(encs.data());
+    double now = yarp::os::Time::now();
+    for (size_t k=0; k<group.size(); k++)
+    {
+        int i = group[k];
+        setModeSingle(i, VOCAB_CM_PWM, VOCAB_IM_STIFF);
+        ipwm->setRefDutyCycle((int)jointsList[i], 0.0);
+        ramps[k].running = true;
+        ramps[k].opl = 0;
+        ramps[k].start_enc = encs[(int)jointsList[i]];
+        ramps[k].last_opl_cmd = now;
+    }
+
+    double time_old = yarp::os::Time::now();
+    double next_time = yarp::os::Time::now();
+    size_t n_running = group.size();
+    while (n_running > 0)
+    {
+        ienc->getEncoders(encs.data());
+        double time = yarp::os::Time::now();
+
+        for (size_t k=0; k<group.size(); k++)
+        {
+            ramp_t& r = ramps[k];
+            if (!r.running) continue;
+            int i = group[k];
+            int jnt = (int)jointsList[i];
+            double enc = encs[jnt];
+            stiction_data& current_test = current_tests[k];
+
+            ipwm->setRefDutyCycle(jnt, r.opl);
+
+            bool passed = false;
+            if (fabs(enc-r.start_enc)>movement_threshold[i])
+            {
+                r.running=false;
+                passed=true;
+                sprintf(buff,"Test success on joint %d (output=%f)",jnt,r.opl);ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+            }
+            else if (fabs(r.opl)>=opl_max[i])
+            {
+                r.running=false;
+                sprintf(buff,"Test failed on joint %d because max output was reached(output=%f)",jnt,r.opl);ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+            }
+            else if (fabs(enc-max_lims[i]) < 1.0 ||
+                     fabs(enc-min_lims[i]) < 1.0 )
+            {
+                r.running=false;
+                sprintf(buff,"Test failed on joint %d because hw limit was touched (enc=%f)",jnt,enc);ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+            }
+
+            if (!r.running)
+            {
+                //the other joints of the group may still be ramping: hold this one in position where it stopped
+                ipwm->setRefDutyCycle(jnt, 0.0);
+                setModeSingle(i, VOCAB_CM_POSITION, VOCAB_IM_STIFF);
+                ipos->positionMove(jnt, enc);
+                if (positive_sign) {current_test.pos_opl=r.opl; current_test.pos_test_passed=passed;}
+                else               {current_test.neg_opl=r.opl; current_test.neg_test_passed=passed;}
+                n_running--;
+            }
+            else if (time-r.last_opl_cmd>opl_delay[i])
+            {
+                if (positive_sign) {r.opl+=opl_step[i];}
+                else               {r.opl-=opl_step[i];}
+                r.last_opl_cmd=time;
+            }
+
+            Bottle& row = r.dataToPlot.addList();
+            Bottle& v1 = row.addList();
+            Bottle& v2 = row.addList();
+            v1.addFloat64(time);
+            v2.addFloat64(enc);
+            v2.addFloat64(r.opl);
+        }
+
+        if (time-time_old>5.0 && n_running>0)
+        {
+            sprintf(buff,"test in progress on %d joints",(int)n_running);ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+            time_old=time;
+        }
+
+        next_time += period;
+        double wait = next_time-yarp::os::Time::now();
+        if (wait > 0) yarp::os::Time::delay(wait);
+    }
+
+    for (size_t k=0; k<group.size(); k++)
+    {
+        char filename[500];
+        sprintf (filename, "plot_stiction_%s_j%d_%s_c%d.txt",partName.c_str(),current_tests[k].jnt,positive_sign?"p":"n",current_tests[k].cycle);
+        saveToFile(filename,ramps[k].dataToPlot);
+    }
+}
+
 void MotorStiction::run()
 {
     //yarp::os::Time::delay(10);
@@ -392,7 +694,38 @@ void MotorStiction::run()
     setMode(VOCAB_CM_POSITION,VOCAB_IM_STIFF);
     goHome();
 
-    for (unsigned int i=0 ; i<jointsList.size(); i++)
+    for (size_t g=0 ; g<joint_groups.size(); g++)
+    {
+        const std::vector<int>& group = joint_groups[g];
+        for (int repeat_count=0; repeat_count<repeat; repeat_count++)
+        {
+            std::vector<stiction_data> current_tests(group.size());
+            std::string joints_str;
+            for (size_t k=0; k<group.size(); k++)
+            {
+                current_tests[k].jnt=(int)jointsList[group[k]];
+                current_tests[k].cycle=repeat_count;
+                joints_str += std::to_string((int)jointsList[group[k]]) + " ";
+            }
+
+            sprintf(buff,"Testing joints ( %s), cycle %d, positive output",joints_str.c_str(),repeat_count);ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+            OplExecuteGroup(group,current_tests,true);
+
+            setMode(VOCAB_CM_POSITION,VOCAB_IM_STIFF);
+            goHome();
+
+            sprintf(buff,"Testing joints ( %s), cycle %d, negative output",joints_str.c_str(),repeat_count);ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+            OplExecuteGroup(group,current_tests,false);
+
+            setMode(VOCAB_CM_POSITION,VOCAB_IM_STIFF);
+            goHome();
+
+            for (size_t k=0; k<group.size(); k++) stiction_data_list.push_back(current_tests[k]);
+        }
+    }
+
+    //without jointGroups the joints are tested one after the other
+    for (unsigned int i=0 ; i<jointsList.size() && joint_groups.empty(); i++)
     {
         for (int repeat_count=0; repeat_count<repeat; repeat_count++)
         {
@@ -404,7 +737,8 @@ void MotorStiction::run()
             ipwm->setRefDutyCycle((int)jointsList[i], 0.0);
 
             sprintf(buff,"Testing joint %d, cycle %d, positive output",(int)jointsList[i],repeat_count);ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
-            OplExecute(i,dataToPlotList,current_test, true);
+            if (adaptive_search) OplSearch(i,dataToPlotList,current_test, true);
+            else                 OplExecute(i,dataToPlotList,current_test, true);
 
             setMode(VOCAB_CM_POSITION,VOCAB_IM_STIFF);
             goHome();
@@ -413,7 +747,8 @@ void MotorStiction::run()
             ipwm->setRefDutyCycle((int)jointsList[i], 0.0);
 
             sprintf(buff,"Testing joint %d, cycle %d, negative output",(int)jointsList[i],repeat_count);ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
-            OplExecute(i,dataToPlotList,current_test, false);
+            if (adaptive_search) OplSearch(i,dataToPlotList,current_test, false);
+            else                 OplExecute(i,dataToPlotList,current_test, false);
 
             setMode(VOCAB_CM_POSITION,VOCAB_IM_STIFF);
             goHome();
@@ -441,6 +776,16 @@ void MotorStiction::run()
         //system (plotstring);
     }
 
+    if (adaptive_search)
+    {
+        for (unsigned int i=0; i <stiction_data_list.size(); i++)
+        {
+            sprintf(buff, "joint %d, cycle %d: positive output %f +- %f, negative output %f +- %f",stiction_data_list[i].jnt,stiction_data_list[i].cycle,
+                    stiction_data_list[i].pos_opl,stiction_data_list[i].pos_ci,stiction_data_list[i].neg_opl,stiction_data_list[i].neg_ci);
+            ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+        }
+    }
+
     //stiction_data_list.size() include tests for all joints, multiple cycles
     for (unsigned int i=0; i <stiction_data_list.size(); i++)
     {
@@ -39,9 +39,12 @@ class stiction_data
     bool   neg_test_passed;
     double pos_opl;
     double neg_opl;
+    //half width of the interval containing the breakaway output (adaptive search only)
+    double pos_ci;
+    double neg_ci;
 
     public:
-    stiction_data() {jnt=0; cycle=0; pos_test_passed=false; neg_test_passed=false; pos_opl=0; neg_opl=0;}
+    stiction_data() {jnt=0; cycle=0; pos_test_passed=false; neg_test_passed=false; pos_opl=0; neg_opl=0; pos_ci=0; neg_ci=0;}
 };
 
 class MotorStiction : public yarp::robottestingframework::TestCase
@@ -68,6 +71,27 @@ public:
     //ok if the joint reaches the hardware limit
     void OplExecute2(int i, std::vector<yarp::os::Bottle>& dataToPlotList, stiction_data& current_test, bool positive_sign);
 
+    //as OplExecute, but the breakaway output is found with a coarse ramp followed by a bisection.
+    //The result is the center of the final interval, with the interval half width as confidence
+    void OplSearch(int i, std::vector<yarp::os::Bottle>& dataToPlotList, stiction_data& current_test, bool positive_sign);
+
+    //as OplExecute, but on several joints at once: each joint has its own ramp and safety checks,
+    //all of them driven by one fixed rate loop reading all the encoders with a single call
+    void OplExecuteGroup(const std::vector<int>& group, std::vector<stiction_data>& current_tests, bool positive_sign);
+
+private:
+    enum probe_result_t
+    {
+      probe_still = 0,
+      probe_moved = 1,
+      probe_limit = 2
+    };
+
+    //commands the output for the given time, stopping as soon as the joint moves from where the probe started or touches a hardware limit
+    probe_result_t OplHold(int i, double opl, double duration, yarp::os::Bottle& dataToPlot);
+    //brings a single joint back to the given position in position control and then back to pwm control
+    void restJoint(int i, double position);
+
 private:
     std::string robotName;
     std::string partName;
@@ -81,6 +105,10 @@ private:
     yarp::sig::Vector movement_threshold;
     yarp::sig::Vector max_lims;
     yarp::sig::Vector min_lims;
+    //groups of indices in jointsList which may be tested together (jointGroups parameter)
+    std::vector<std::vector<int> > joint_groups;
+    bool   adaptive_search;
+    double coarse_factor;
 
     int    n_part_joints;
 
@@ -0,0 +1,372 @@
+/*
+ * iCub Robot Unit Tests (Robot Testing Framework)
+ *
+ * Copyright (C) 2015-2019 Istituto Italiano di Tecnologia (IIT)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+#include <robottestingframework/TestAssert.h>
+#include <robottestingframework/dll/Plugin.h>
+#include <yarp/os/Time.h>
+#include <yarp/os/Property.h>
+#include <yarp/os/Vocab.h>
+#include "MotorStress.h"
+
+using namespace robottestingframework;
+using namespace yarp::os;
+using namespace yarp::dev;
+
+// prepare the plugin
+ROBOTTESTINGFRAMEWORK_PREPARE_PLUGIN(MotorStress)
+
+MotorStress::MotorStress() : yarp::robottestingframework::TestCase("MotorStress") {
+    dd=0;
+    ipos=0;
+    icmd=0;
+    iimd=0;
+    ienc=0;
+    ipid=0;
+    imot=0;
+    icur=0;
+    ipwm=0;
+    modes=0;
+    prev_modes=0;
+    joints=0;
+    duration=3600;
+    cycles=0;
+    sample_period=0.1;
+    report_period=60;
+    target_tolerance=1.0;
+    timeout_margin=5.0;
+    max_log_samples=100000;
+    log_samples=0;
+    n_part_joints=0;
+    n_cmd_joints=0;
+}
+
+MotorStress::~MotorStress() { }
+
+bool MotorStress::readVector(yarp::os::Property& property, const std::string& name, yarp::sig::Vector& v)
+{
+    if (!property.check(name))
+    {
+        v.clear();
+        return false;
+    }
+    Bottle* b = property.find(name).asList();
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(b!=0, Asserter::format("unable to parse %s parameter", name.c_str()));
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE((int)b->size()==n_cmd_joints, Asserter::format("%s must have one value for each joint", name.c_str()));
+    v.resize(n_cmd_joints);
+    for (int i=0; i<n_cmd_joints; i++) v[i]=b->get(i).asFloat64();
+    return true;
+}
+
+bool MotorStress::setup(yarp::os::Property& property) {
+    if(property.check("name"))
+        setName(property.find("name").asString());
+
+    // updating parameters
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("robot"),  "The robot name must be given as the test parameter!");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("part"),   "The part name must be given as the test parameter!");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("joints"), "The joints list must be given as the test parameter!");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("min"),    "The min positions must be given as the test parameter!");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("max"),    "The max positions must be given as the test parameter!");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("speed"),  "The speed must be given as the test parameter!");
+
+    robotName = property.find("robot").asString();
+    partName = property.find("part").asString();
+
+    if (property.check("duration"))        duration = property.find("duration").asFloat64();
+    if (property.check("cycles"))          cycles = property.find("cycles").asInt32();
+    if (property.check("samplePeriod"))    sample_period = property.find("samplePeriod").asFloat64();
+    if (property.check("reportPeriod"))    report_period = property.find("reportPeriod").asFloat64();
+    if (property.check("targetTolerance")) target_tolerance = property.find("targetTolerance").asFloat64();
+    if (property.check("timeoutMargin"))   timeout_margin = property.find("timeoutMargin").asFloat64();
+    if (property.check("maxLogSamples"))   max_log_samples = property.find("maxLogSamples").asInt32();
+    log_filename = property.check("logFile") ? property.find("logFile").asString() : "motorStress_" + partName + ".txt";
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(duration>0 && sample_period>0 && report_period>0 && target_tolerance>0 && timeout_margin>0 && max_log_samples>0,
+                                                "duration, samplePeriod, reportPeriod, targetTolerance, timeoutMargin and maxLogSamples must be > 0");
+
+    Bottle* jointsBottle = property.find("joints").asList();
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(jointsBottle!=0,"unable to parse joints parameter");
+
+    Property options;
+    options.put("device", "remote_controlboard");
+    options.put("remote", "/"+robotName+"/"+partName);
+    options.put("local", "/MotorStressTest/"+robotName+"/"+partName);
+
+    dd = new PolyDriver(options);
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->isValid(),"Unable to open device driver");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(ipos),"Unable to open position interface");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(ienc),"Unable to open encoders interface");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(icmd),"Unable to open control mode interface");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(iimd),"Unable to open interaction mode interface");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(ipid),"Unable to open pid interface");
+    //the following quantities are only logged, so their interfaces are optional
+    if (!dd->view(imot)) { imot=0; ROBOTTESTINGFRAMEWORK_TEST_REPORT("motor interface not available, the temperature will not be logged"); }
+    if (!dd->view(icur)) { icur=0; ROBOTTESTINGFRAMEWORK_TEST_REPORT("current interface not available, the current will not be logged"); }
+    if (!dd->view(ipwm)) { ipwm=0; ROBOTTESTINGFRAMEWORK_TEST_REPORT("pwm interface not available, the pwm will not be logged"); }
+
+    if (!ienc->getAxes(&n_part_joints))
+    {
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR("unable to get the number of joints of the part");
+    }
+
+    n_cmd_joints = jointsBottle->size();
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(n_cmd_joints>0 && n_cmd_joints<=n_part_joints,"invalid number of joints, it must be >0 & <= number of part joints");
+    jointsList.resize(n_cmd_joints);
+    joints = new int[n_cmd_joints];
+    for (int i=0; i<n_cmd_joints; i++) { jointsList[i]=jointsBottle->get(i).asInt32(); joints[i]=(int)jointsList[i]; }
+
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(readVector(property, "min", min_pos), "unable to parse min parameter");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(readVector(property, "max", max_pos), "unable to parse max parameter");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(readVector(property, "speed", speed), "unable to parse speed parameter");
+    for (int i=0; i<n_cmd_joints; i++)
+    {
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(max_pos[i]-min_pos[i]>2*target_tolerance, "max must be larger than min + 2*targetTolerance");
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(speed[i]>0, "speed must be > 0");
+    }
+    if (!readVector(property, "home", home))
+    {
+        home.resize(n_cmd_joints);
+        for (int i=0; i<n_cmd_joints; i++) home[i]=(min_pos[i]+max_pos[i])/2;
+    }
+    readVector(property, "maxTemperature", max_temperature);
+    readVector(property, "maxTrackingError", max_tracking_error);
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(max_temperature.size()==0 || imot!=0, "maxTemperature is given but the motor interface is not available");
+
+    int n_motors = n_part_joints;
+    if (imot) imot->getNumberOfMotors(&n_motors);
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(n_motors>=n_part_joints, "the number of motors is smaller than the number of joints");
+    enc.resize(n_part_joints, 0.0);
+    pid_err.resize(n_part_joints, 0.0);
+    temperature.resize(n_motors, NAN);
+    current.resize(n_motors, NAN);
+    pwm.resize(n_motors, NAN);
+    modes = new int[n_cmd_joints];
+    prev_modes = new int[n_cmd_joints];
+
+    return true;
+}
+
+void MotorStress::tearDown()
+{
+    char buff[500];
+    sprintf(buff,"Closing test module");ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+    if (log_file.is_open()) log_file.close();
+    if (dd) {delete dd; dd =0;}
+    if (modes)      {delete [] modes; modes=0;}
+    if (prev_modes) {delete [] prev_modes; prev_modes=0;}
+    if (joints)     {delete [] joints; joints=0;}
+}
+
+void MotorStress::setPositionMode()
+{
+    for (int i=0; i<n_cmd_joints; i++) modes[i]=VOCAB_CM_POSITION;
+    icmd->setControlModes(n_cmd_joints, joints, modes);
+    for (int i=0; i<n_cmd_joints; i++) iimd->setInteractionMode(joints[i], VOCAB_IM_STIFF);
+
+    double start = yarp::os::Time::now();
+    while (1)
+    {
+        icmd->getControlModes(n_cmd_joints, joints, modes);
+        int ok=0;
+        for (int i=0; i<n_cmd_joints; i++) if (modes[i]==VOCAB_CM_POSITION) ok++;
+        if (ok==n_cmd_joints) break;
+        if (yarp::os::Time::now()-start>5.0)
+        {
+            ROBOTTESTINGFRAMEWORK_ASSERT_ERROR("Unable to set position control mode");
+        }
+        yarp::os::Time::delay(0.010);
+    }
+}
+
+void MotorStress::goTo(const yarp::sig::Vector& position)
+{
+    ipos->positionMove(n_cmd_joints, joints, position.data());
+
+    double start = yarp::os::Time::now();
+    while (1)
+    {
+        ienc->getEncoders(enc.data());
+        int in_position=0;
+        for (int i=0; i<n_cmd_joints; i++) if (fabs(enc[joints[i]]-position[i])<target_tolerance) in_position++;
+        if (in_position==n_cmd_joints) break;
+        if (yarp::os::Time::now()-start>30.0)
+        {
+            ROBOTTESTINGFRAMEWORK_ASSERT_ERROR("Timeout while reaching desired position");
+        }
+        yarp::os::Time::delay(0.050);
+    }
+}
+
+void MotorStress::openLog()
+{
+    log_file.open(log_filename.c_str());
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(log_file.is_open(), Asserter::format("unable to open the log file %s", log_filename.c_str()));
+    log_file << "#time";
+    for (int i=0; i<n_cmd_joints; i++)
+        log_file << " pos_" << joints[i] << " err_" << joints[i] << " temp_" << joints[i] << " curr_" << joints[i] << " pwm_" << joints[i];
+    log_file << std::endl;
+    log_samples=0;
+}
+
+void MotorStress::writeLog(double t)
+{
+    //the log is bounded: the full file is kept as .old and a new one is started
+    if (log_samples>=max_log_samples)
+    {
+        log_file.close();
+        std::string old_filename = log_filename + ".old";
+        std::remove(old_filename.c_str());
+        std::rename(log_filename.c_str(), old_filename.c_str());
+        openLog();
+    }
+    log_file << t;
+    for (int i=0; i<n_cmd_joints; i++)
+    {
+        int j=joints[i];
+        log_file << " " << enc[j] << " " << pid_err[j] << " " << temperature[j] << " " << current[j] << " " << pwm[j];
+    }
+    log_file << "\n";
+    log_samples++;
+}
+
+bool MotorStress::stopSafely()
+{
+    //a joint in hw fault cannot be moved, the others are stopped where they are
+    for (int i=0; i<n_cmd_joints; i++)
+    {
+        if (modes[i]==VOCAB_CM_HW_FAULT)
+        {
+            ipos->stop(n_cmd_joints, joints);
+            return false;
+        }
+    }
+    ROBOTTESTINGFRAMEWORK_TEST_REPORT("Moving the joints to home");
+    setPositionMode();
+    goTo(home);
+    return true;
+}
+
+void MotorStress::run()
+{
+    char buff[500];
+    setPositionMode();
+    ipos->setRefSpeeds(n_cmd_joints, joints, speed.data());
+    ROBOTTESTINGFRAMEWORK_TEST_REPORT("all joints are going to home....");
+    goTo(home);
+
+    openLog();
+    icmd->getControlModes(n_cmd_joints, joints, prev_modes);
+
+    //each joint goes back and forth independently, starting towards max
+    yarp::sig::Vector target = max_pos;
+    std::vector<int> half_cycles(n_cmd_joints, 0);
+    yarp::sig::Vector max_temp_seen(n_cmd_joints, NAN);
+    yarp::sig::Vector max_err_seen(n_cmd_joints, 0.0);
+    //a half cycle lasts |max-min|/speed: twice that time plus a margin is allowed before the joint is considered stuck
+    yarp::sig::Vector half_cycle_timeout(n_cmd_joints);
+    for (int i=0; i<n_cmd_joints; i++) half_cycle_timeout[i] = 2*fabs(max_pos[i]-min_pos[i])/speed[i] + timeout_margin;
+    ipos->positionMove(n_cmd_joints, joints, target.data());
+
+    std::string stop_reason;
+    double start = yarp::os::Time::now();
+    std::vector<double> half_cycle_start(n_cmd_joints, start);
+    double next_sample = start;
+    double next_report = start+report_period;
+    while (1)
+    {
+        double now = yarp::os::Time::now();
+        double t = now-start;
+        if (t>=duration) break;
+        if (cycles>0 && *std::min_element(half_cycles.begin(), half_cycles.end())>=2*cycles) break;
+
+        ienc->getEncoders(enc.data());
+        ipid->getPidErrors(VOCAB_PIDTYPE_POSITION, pid_err.data());
+        if (imot) imot->getTemperatures(temperature.data());
+        if (icur) icur->getCurrents(current.data());
+        if (ipwm) ipwm->getDutyCycles(pwm.data());
+        icmd->getControlModes(n_cmd_joints, joints, modes);
+
+        for (int i=0; i<n_cmd_joints; i++)
+        {
+            int j=joints[i];
+            if (modes[i]!=prev_modes[i])
+            {
+                sprintf(buff, "joint %d changed control mode from %s to %s at %.1f s", j,
+                        Vocab32::decode(prev_modes[i]).c_str(), Vocab32::decode(modes[i]).c_str(), t);
+                ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+                log_file << "# " << buff << "\n";
+                prev_modes[i]=modes[i];
+            }
+            if (modes[i]==VOCAB_CM_HW_FAULT && stop_reason.empty())
+                stop_reason = Asserter::format("joint %d is in hw fault", j);
+
+            if (!std::isnan(temperature[j]) && (std::isnan(max_temp_seen[i]) || temperature[j]>max_temp_seen[i])) max_temp_seen[i]=temperature[j];
+            if (fabs(pid_err[j])>max_err_seen[i]) max_err_seen[i]=fabs(pid_err[j]);
+            if (max_temperature.size()>0 && temperature[j]>max_temperature[i] && stop_reason.empty())
+                stop_reason = Asserter::format("joint %d motor temperature %.1f above %.1f", j, temperature[j], max_temperature[i]);
+            if (max_tracking_error.size()>0 && fabs(pid_err[j])>max_tracking_error[i] && stop_reason.empty())
+                stop_reason = Asserter::format("joint %d tracking error %.2f above %.2f", j, pid_err[j], max_tracking_error[i]);
+
+            if (fabs(enc[j]-target[i])<target_tolerance)
+            {
+                target[i] = (target[i]==max_pos[i]) ? min_pos[i] : max_pos[i];
+                ipos->positionMove(j, target[i]);
+                half_cycles[i]++;
+                half_cycle_start[i] = now;
+            }
+            else if (now-half_cycle_start[i]>half_cycle_timeout[i] && stop_reason.empty())
+            {
+                stop_reason = Asserter::format("joint %d did not reach %.1f within %.1f s (position %.2f)", j, target[i], half_cycle_timeout[i], enc[j]);
+            }
+        }
+        writeLog(t);
+        if (!stop_reason.empty()) break;
+
+        if (now>=next_report)
+        {
+            for (int i=0; i<n_cmd_joints; i++)
+            {
+                sprintf(buff, "%.0f s: joint %d, cycles %d, max temperature %.1f, max tracking error %.2f",
+                        t, joints[i], half_cycles[i]/2, max_temp_seen[i], max_err_seen[i]);
+                ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+            }
+            log_file.flush();
+            next_report += report_period;
+        }
+
+        next_sample += sample_period;
+        double wait = next_sample-yarp::os::Time::now();
+        if (wait>0) yarp::os::Time::delay(wait);
+    }
+    log_file.flush();
+
+    for (int i=0; i<n_cmd_joints; i++)
+    {
+        sprintf(buff, "joint %d: cycles %d, max temperature %.1f, max tracking error %.2f",
+                joints[i], half_cycles[i]/2, max_temp_seen[i], max_err_seen[i]);
+        ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+    }
+    bool homed = stopSafely();
+    ROBOTTESTINGFRAMEWORK_TEST_FAIL_IF_FALSE(stop_reason.empty(), Asserter::format("test stopped after %.1f s: %s", yarp::os::Time::now()-start, stop_reason.c_str()));
+    ROBOTTESTINGFRAMEWORK_TEST_FAIL_IF_FALSE(homed, "joints left in place because of a hw fault");
+}
@@ -0,0 +1,134 @@
+/*
+ * iCub Robot Unit Tests (Robot Testing Framework)
+ *
+ * Copyright (C) 2015-2019 Istituto Italiano di Tecnologia (IIT)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _MOTORSTRESS_H_
+#define _MOTORSTRESS_H_
+
+#include <string>
+#include <fstream>
+#include <yarp/robottestingframework/TestCase.h>
+#include <yarp/dev/ControlBoardInterfaces.h>
+#include <yarp/dev/PolyDriver.h>
+#include <yarp/sig/Vector.h>
+
+/**
+* \ingroup icub-tests
+* Endurance test of the motors: the joints are moved back and forth between min and max at the given speed for a long time
+* (e.g. some hours, to qualify the motors after a repair).
+* During the test the joint position, the position tracking error (IPidControl::getPidErrors), the motor temperature (IMotor),
+* current and pwm are sampled every samplePeriod seconds and logged in logFile, one row per sample:
+* time, then for each joint: position, tracking error, temperature, current, pwm.
+* The control mode transitions (e.g. to hw fault) are logged as comment lines and reported.
+* The log is bounded: when it contains maxLogSamples rows it is moved to logFile.old and a new one is started, so that at most
+* 2*maxLogSamples rows are kept on disk.
+* The test stops, and fails, if a joint goes in hw fault, if a motor is hotter than maxTemperature, if the tracking error
+* is larger than maxTrackingError or if a joint does not reach min or max within 2*(max-min)/speed+timeoutMargin seconds.
+* Unless a joint is in hw fault, the joints are then moved back to home.
+* Temperature, current and pwm are logged as nan if the corresponding interface is not available.
+*
+* Example: testRunner -v -t MotorStress.dll -p "--robot icub --part head --joints ""(0 1 2)"" --min ""(-30 -20 -45)"" --max ""(22 20 45)"" --speed ""(40 40 40)"" --duration 7200"
+*
+*  Accepts the following parameters:
+* | Parameter name     | Type   | Units | Default Value | Required | Description | Notes |
+* |:------------------:|:------:|:-----:|:-------------:|:--------:|:-----------:|:-----:|
+* | robot              | string | -     | -     | Yes | The name of the robot.     | e.g. icub |
+* | part               | string | -     | -     | Yes | The name of the robot part. | e.g. head |
+* | joints             | vector of ints | - | - | Yes | List of joints to be tested | |
+* | min                | vector of doubles | deg | - | Yes | The lower position of the movement of each joint | |
+* | max                | vector of doubles | deg | - | Yes | The upper position of the movement of each joint | |
+* | speed              | vector of doubles | deg/s | - | Yes | The reference speed of each joint | |
+* | home               | vector of doubles | deg | (min+max)/2 | No | The position of the joints at the end of the test | |
+* | duration           | double | s     | 3600  | No  | The duration of the test | |
+* | cycles             | int    | -     | 0     | No  | If >0, the test ends when all the joints completed this number of cycles | |
+* | samplePeriod       | double | s     | 0.1   | No  | The sampling period of the log | |
+* | reportPeriod       | double | s     | 60    | No  | The period of the progress reports | |
+* | targetTolerance    | double | deg   | 1.0   | No  | The distance from min/max at which a joint is commanded to go back | |
+* | timeoutMargin      | double | s     | 5.0   | No  | The margin added to 2*(max-min)/speed to get the maximum duration of a half cycle | |
+* | maxTemperature     | vector of doubles | degC | - | No | The maximum motor temperature of each joint | if not given, the temperature is only logged |
+* | maxTrackingError   | vector of doubles | deg | - | No | The maximum position tracking error of each joint | if not given, the error is only logged |
+* | logFile            | string | -     | motorStress_<part>.txt | No | The name of the log file | |
+* | maxLogSamples      | int    | -     | 100000 | No | The maximum number of rows of the log file | |
+*
+*/
+class MotorStress : public yarp::robottestingframework::TestCase
+{
+public:
+    MotorStress();
+    virtual ~MotorStress();
+
+    virtual bool setup(yarp::os::Property& property);
+
+    virtual void tearDown();
+
+    virtual void run();
+
+private:
+    bool readVector(yarp::os::Property& property, const std::string& name, yarp::sig::Vector& v);
+    void setPositionMode();
+    void goTo(const yarp::sig::Vector& position);
+    void openLog();
+    void writeLog(double t);
+    bool stopSafely();
+
+    std::string robotName;
+    std::string partName;
+    yarp::sig::Vector jointsList;
+    yarp::sig::Vector min_pos;
+    yarp::sig::Vector max_pos;
+    yarp::sig::Vector speed;
+    yarp::sig::Vector home;
+    yarp::sig::Vector max_temperature;
+    yarp::sig::Vector max_tracking_error;
+    double duration;
+    int    cycles;
+    double sample_period;
+    double report_period;
+    double target_tolerance;
+    double timeout_margin;
+    std::string log_filename;
+    int    max_log_samples;
+    int    n_part_joints;
+    int    n_cmd_joints;
+
+    std::ofstream log_file;
+    int    log_samples;
+
+    // last samples of the whole part, preallocated in setup()
+    yarp::sig::Vector enc;
+    yarp::sig::Vector pid_err;
+    yarp::sig::Vector temperature;
+    yarp::sig::Vector current;
+    yarp::sig::Vector pwm;
+    int*   modes;
+    int*   prev_modes;
+    int*   joints;
+
+    yarp::dev::PolyDriver        *dd;
+    yarp::dev::IPositionControl  *ipos;
+    yarp::dev::IControlMode      *icmd;
+    yarp::dev::IInteractionMode  *iimd;
+    yarp::dev::IEncoders         *ienc;
+    yarp::dev::IPidControl       *ipid;
+    yarp::dev::IMotor            *imot;
+    yarp::dev::ICurrentControl   *icur;
+    yarp::dev::IPWMControl       *ipwm;
+};
+
+#endif //_MOTORSTRESS_H_
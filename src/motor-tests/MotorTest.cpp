@@ -50,6 +50,12 @@ bool MotorTest::setup(yarp::os::Property &configuration) {
     m_aRefAcc=NULL;
     m_aTimeout=NULL;
     m_aHome=NULL;
+    m_aVelTol=NULL;
+    m_aAccTol=NULL;
+    m_aTimeTol=NULL;
+    m_aOvershoot=NULL;
+    m_samplePeriod=0.01;
+    m_settleTime=0.3;
     iEncoders=NULL;
     iPosition=NULL;
     m_initialized=false;
@@ -116,6 +122,26 @@ bool MotorTest::setup(yarp::os::Property &configuration) {
     for (int i=0; i<n; ++i)
         m_aTimeout[i]=bot.get(i).asFloat64();
 
+    m_aVelTol=readOptionalGroup(configuration, "veltol");
+    m_aAccTol=readOptionalGroup(configuration, "acctol");
+    m_aTimeTol=readOptionalGroup(configuration, "timetol");
+    m_aOvershoot=readOptionalGroup(configuration, "overshoot");
+
+    if(configuration.check("samplePeriod"))
+        m_samplePeriod=configuration.find("samplePeriod").asFloat64();
+    if(configuration.check("settleTime"))
+        m_settleTime=configuration.find("settleTime").asFloat64();
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(m_samplePeriod>0 && m_settleTime>=0,
+                        "samplePeriod must be > 0 and settleTime >= 0");
+
+    double maxTimeout=0;
+    for (int i=0; i<m_NumJoints; ++i)
+        if (m_aTimeout[i]>maxTimeout) maxTimeout=m_aTimeout[i];
+    size_t nSamples=(size_t)((maxTimeout+m_settleTime)/m_samplePeriod)+10;
+    m_sampleTime.reserve(nSamples);
+    m_samplePos.reserve(nSamples);
+    m_sampleVel.reserve(nSamples);
+
     // opening interfaces
     yarp::os::Property options;
     options.put("device","remote_controlboard");
@@ -154,6 +180,81 @@ void MotorTest::tearDown() {
     if (m_aRefAcc)    delete [] m_aRefAcc;
     if (m_aTimeout)   delete [] m_aTimeout;
     if (m_aHome)      delete [] m_aHome;
+    if (m_aVelTol)    delete [] m_aVelTol;
+    if (m_aAccTol)    delete [] m_aAccTol;
+    if (m_aTimeTol)   delete [] m_aTimeTol;
+    if (m_aOvershoot) delete [] m_aOvershoot;
+}
+
+double* MotorTest::readOptionalGroup(yarp::os::Property& configuration, const std::string &name) {
+    if(!configuration.check(name))
+        return NULL;
+    yarp::os::Bottle bot = configuration.findGroup(name).tail();
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(bot.size()>=m_NumJoints,
+                        Asserter::format("'%s' parameter must have a value for each joint", name.c_str()));
+    double *values=new double[m_NumJoints];
+    for (int i=0; i<m_NumJoints; ++i)
+        values[i]=bot.get(i).asFloat64();
+    return values;
+}
+
+void MotorTest::checkProfile(int joint, double startPos, double timeReached) {
+    double distance=fabs(m_aTargetVal[joint]-startPos);
+    double dir=(m_aTargetVal[joint]>=startPos)? 1.0:-1.0;
+    if (distance<m_aMinErr[joint]+m_aMaxErr[joint] || m_sampleTime.empty()) {
+        ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("joint %d: movement too short to check the trajectory profile", joint));
+        return;
+    }
+
+    // peak velocity and overshoot
+    double peakVel=0;
+    double overshoot=0;
+    for (size_t k=0; k<m_sampleTime.size(); k++) {
+        if (fabs(m_sampleVel[k])>peakVel) peakVel=fabs(m_sampleVel[k]);
+        double over=(m_samplePos[k]-m_aTargetVal[joint])*dir;
+        if (over>overshoot) overshoot=over;
+    }
+
+    // acceleration from the rise time of the velocity from 10% to 90% of its peak
+    double t10=-1, t90=-1;
+    for (size_t k=0; k<m_sampleTime.size() && t90<0; k++) {
+        if (t10<0 && fabs(m_sampleVel[k])>=0.1*peakVel) t10=m_sampleTime[k];
+        if (fabs(m_sampleVel[k])>=0.9*peakVel) t90=m_sampleTime[k];
+    }
+    double acc=(t90>t10 && t10>=0)? 0.8*peakVel/(t90-t10) : 0;
+
+    // duration of the ideal trapezoidal (or triangular) profile
+    double v=m_aRefVel[joint];
+    double idealTime=distance/v;
+    if (m_aRefAcc!=NULL && m_aRefAcc[joint]>0) {
+        double a=m_aRefAcc[joint];
+        if (distance>=v*v/a)
+            idealTime=distance/v+v/a;
+        else
+            idealTime=2.0*sqrt(distance/a);
+    }
+
+    ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("joint %d profile: peak vel %.2lf (ref %.2lf), acc %.2lf (ref %.2lf), time to target %.3lf (ideal %.3lf), overshoot %.3lf",
+                                      joint, peakVel, v, acc, (m_aRefAcc!=NULL)? m_aRefAcc[joint]:0.0, timeReached, idealTime, overshoot));
+
+    // the peak velocity is lower than refvel when the distance is too short to reach it
+    bool cruise=(m_aRefAcc==NULL) || (distance>=v*v/m_aRefAcc[joint]);
+    if (m_aVelTol!=NULL && cruise) {
+        ROBOTTESTINGFRAMEWORK_TEST_FAIL_IF_FALSE(fabs(peakVel-v)<=v*m_aVelTol[joint]/100.0,
+            Asserter::format("joint %d peak velocity %.2lf within %.1lf%% of refvel %.2lf", joint, peakVel, m_aVelTol[joint], v));
+    }
+    if (m_aAccTol!=NULL && m_aRefAcc!=NULL) {
+        ROBOTTESTINGFRAMEWORK_TEST_FAIL_IF_FALSE(fabs(acc-m_aRefAcc[joint])<=m_aRefAcc[joint]*m_aAccTol[joint]/100.0,
+            Asserter::format("joint %d acceleration %.2lf within %.1lf%% of refacc %.2lf", joint, acc, m_aAccTol[joint], m_aRefAcc[joint]));
+    }
+    if (m_aTimeTol!=NULL && timeReached>=0) {
+        ROBOTTESTINGFRAMEWORK_TEST_FAIL_IF_FALSE(fabs(timeReached-idealTime)<=idealTime*m_aTimeTol[joint]/100.0,
+            Asserter::format("joint %d time to target %.3lf within %.1lf%% of the ideal profile %.3lf", joint, timeReached, m_aTimeTol[joint], idealTime));
+    }
+    if (m_aOvershoot!=NULL) {
+        ROBOTTESTINGFRAMEWORK_TEST_FAIL_IF_FALSE(overshoot<=m_aOvershoot[joint],
+            Asserter::format("joint %d overshoot %.3lf below %.3lf", joint, overshoot, m_aOvershoot[joint]));
+    }
 }
 
 void MotorTest::run() {
@@ -192,21 +293,46 @@ void MotorTest::run() {
 
         ROBOTTESTINGFRAMEWORK_TEST_FAIL_IF_FALSE(iPosition->positionMove(joint, m_aTargetVal[joint]),
             Asserter::format("moving joint %d to %.2lf", joint, m_aTargetVal[joint]));
+        double timeMove=yarp::os::Time::now();
 
         doneAll=false;
         ret=iPosition->checkMotionDone(joint, &doneAll);
         ROBOTTESTINGFRAMEWORK_TEST_FAIL_IF_FALSE(!doneAll&&ret, "checking checkMotionDone returns false after position move");
 
         ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Waiting timeout %.2lf", m_aTimeout[joint]));
+        // sample position and velocity until the target is reached, then for m_settleTime to measure the overshoot
+        m_sampleTime.clear();
+        m_samplePos.clear();
+        m_sampleVel.clear();
         bool reached=false;
-        while(timeNow<timeStart+m_aTimeout[joint] && !reached) {
+        double timeReached=-1;
+        double nextSample=timeMove;
+        double prevPos=m_aHome[joint];
+        double prevTime=timeMove;
+        timeNow=timeMove;
+        while(timeNow<timeMove+m_aTimeout[joint] && (!reached || timeNow<timeMove+timeReached+m_settleTime)) {
             double pos;
+            double vel;
             iEncoders->getEncoder(joint,&pos);
-            reached = yarp::robottestingframework::TestAsserter::isApproxEqual(pos, m_aTargetVal[joint], m_aMinErr[joint], m_aMaxErr[joint]);
             timeNow=yarp::os::Time::now();
-            yarp::os::Time::delay(0.1);
+            if (!iEncoders->getEncoderSpeed(joint,&vel))
+                vel=(timeNow>prevTime)? (pos-prevPos)/(timeNow-prevTime) : 0;
+            prevPos=pos;
+            prevTime=timeNow;
+            m_sampleTime.push_back(timeNow-timeMove);
+            m_samplePos.push_back(pos);
+            m_sampleVel.push_back(vel);
+            if (!reached && yarp::robottestingframework::TestAsserter::isApproxEqual(pos, m_aTargetVal[joint], m_aMinErr[joint], m_aMaxErr[joint])) {
+                reached=true;
+                timeReached=timeNow-timeMove;
+            }
+            nextSample+=m_samplePeriod;
+            double wait=nextSample-yarp::os::Time::now();
+            if (wait>0)
+                yarp::os::Time::delay(wait);
         }
         ROBOTTESTINGFRAMEWORK_TEST_FAIL_IF_FALSE(reached, "reached position");
+        checkProfile(joint, m_aHome[joint], timeReached);
     }
 
     //////// check multiple joints
@@ -21,6 +21,7 @@
 #ifndef _MOTORTEST_H_
 #define _MOTORTEST_H_
 
+#include <vector>
 #include <yarp/robottestingframework/TestCase.h>
 
 #include <yarp/os/Value.h>
@@ -41,6 +42,17 @@
 * \li IPositionControl::setRefAccelerations()
 * \li IEncoders::getEncoder()
 * \li IEncoders::getEncoders()
+* \li IEncoders::getEncoderSpeed()
+*
+* During the movement of each single joint the encoder position and velocity are sampled every samplePeriod seconds,
+* and the joint is considered arrived as soon as it enters the [target-min, target+max] band. The sampling continues for
+* settleTime seconds to measure the overshoot. From the samples the test computes the peak velocity, the acceleration
+* (from the time the velocity takes to go from 10% to 90% of its peak), the time to reach the target and the overshoot.
+* They are compared with refvel, refacc and with the duration of the ideal trapezoidal profile (triangular if the distance is too short to
+* reach refvel, constant velocity if refacc is not given). Each quantity is checked only if the corresponding tolerance is given.
+* Note that veltol, acctol and timetol assume a trapezoidal velocity profile: the iCub firmware generates minimum jerk trajectories, whose
+* peak velocity is about 1.875*refvel and which enter the target band earlier, so they should be given only for trapezoidal trajectory
+* generators (e.g. the fakeRobot contexts).
 *
 *  Accepts the following parameters:
 * | Parameter name | Type   | Units | Default Value | Required | Description | Notes |
@@ -54,6 +66,12 @@
 * | refvel         | vector of doubles of size joints | deg/s | - | Yes | For each joint the reference velocity value to set in the low level trajectory generator. | |
 * | refacc         | vector of doubles of size joints | deg/s^2 | - | No | For each joint the reference acceleration value to set in the low level trajectory generator. | |
 * | timeout         | vector of doubles of size joints | s | - | Yes | For each joint the maximum time to wait for the joint to reach the target. | |
+* | samplePeriod    | double | s | 0.01 | No | The sampling period of the encoders during the single joint movements. | |
+* | settleTime      | double | s | 0.3  | No | The sampling time after the target is reached, to measure the overshoot. | |
+* | veltol          | vector of doubles of size joints | % | - | No | For each joint the maximum error of the peak velocity with respect to refvel. | |
+* | acctol          | vector of doubles of size joints | % | - | No | For each joint the maximum error of the acceleration with respect to refacc. | used only with refacc |
+* | timetol         | vector of doubles of size joints | % | - | No | For each joint the maximum error of the time to reach the target with respect to the ideal profile. | |
+* | overshoot       | vector of doubles of size joints | deg | - | No | For each joint the maximum overshoot. | |
 *
 */
 class MotorTest : public yarp::robottestingframework::TestCase {
@@ -68,6 +86,9 @@ public:
     virtual void run();
 
 private:
+    double* readOptionalGroup(yarp::os::Property& configuration, const std::string &name);
+    void checkProfile(int joint, double startPos, double timeReached);
+
     yarp::dev::PolyDriver m_driver;
     yarp::dev::IEncoders *iEncoders;
     yarp::dev::IPositionControl *iPosition;
@@ -81,6 +102,17 @@ private:
     double *m_aRefVel;
     double *m_aRefAcc;
     double *m_aTimeout;
+    double *m_aVelTol;
+    double *m_aAccTol;
+    double *m_aTimeTol;
+    double *m_aOvershoot;
+    double m_samplePeriod;
+    double m_settleTime;
+
+    // samples of the single joint movement, preallocated in setup()
+    std::vector<double> m_sampleTime;
+    std::vector<double> m_samplePos;
+    std::vector<double> m_sampleVel;
 };
 
 #endif //_MOTORTEST_H_
@@ -32,6 +32,7 @@
 #include "motorEncodersConsistency.h"
 #include <iostream>
 #include <yarp/dev/IRemoteVariables.h>
+#include <yarp/dev/PolyDriver.h>
 
 using namespace std;
 
@@ -46,7 +47,54 @@ using namespace yarp::math;
 // prepare the plugin
 ROBOTTESTINGFRAMEWORK_PREPARE_PLUGIN(OpticalEncodersConsistency)
 
-OpticalEncodersConsistency::OpticalEncodersConsistency() : yarp::robottestingframework::TestCase("OpticalEncodersConsistency") {
+void EncodersConsistencyRecorder::addPart(const std::string& part)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    data[part].clear();
+    data[part].resize(DATASETS_NUM);
+}
+
+void EncodersConsistencyRecorder::record(const std::string& part, dataset_t dataset, const yarp::sig::Vector& v1, const yarp::sig::Vector& v2)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    Bottle& row = data[part][dataset].addList();
+    Bottle& b1 = row.addList();
+    Bottle& b2 = row.addList();
+    b1.read(v1);
+    b2.read(v2);
+}
+
+void EncodersConsistencyRecorder::saveToFiles(const std::string& part)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::vector<Bottle>& d = data[part];
+
+    string partfilename = part+".txt";
+    string testfilename = "encConsis_";
+    saveToFile(testfilename + "jointPos_MotorPos_" + partfilename, d[JNT_POS_MOT_POS]);
+    saveToFile(testfilename + "jointVel_motorVel_" + partfilename, d[JNT_VEL_MOT_VEL]);
+    saveToFile(testfilename + "joint_derivedVel_vel_" + partfilename, d[JNT_DERIVED_VEL]);
+    saveToFile(testfilename + "motor_derivedVel_vel_" + partfilename, d[MOT_DERIVED_VEL]);
+    saveToFile(testfilename + "jointPos_MotorPos_reversed_" + partfilename, d[JNT_POS_MOT_POS_REV]);
+}
+
+void EncodersConsistencyRecorder::saveToFile(std::string filename, yarp::os::Bottle &b)
+{
+    std::fstream fs;
+    fs.open (filename.c_str(), std::fstream::out);
+
+    for (int i=0; i<b.size(); i++)
+    {
+        std::string s = b.get(i).toString();
+        std::replace(s.begin(), s.end(), '(', ' ');
+        std::replace(s.begin(), s.end(), ')', ' ');
+        fs << s << endl;
+    }
+
+    fs.close();
+}
+
+EncodersConsistencyPart::EncodersConsistencyPart(EncodersConsistencyRecorder& rec) : recorder(rec) {
     jointsList=0;
     dd=0;
     ipos=0;
@@ -55,6 +103,7 @@ OpticalEncodersConsistency::OpticalEncodersConsistency() : yarp::robottestingfra
     ienc=0;
     imot=0;
     imotenc=0;
+    ivar=0;
 
     enc_jnt=0;
     enc_jnt2mot=0;
@@ -65,117 +114,88 @@ OpticalEncodersConsistency::OpticalEncodersConsistency() : yarp::robottestingfra
     acc_jnt=0;
     acc_jnt2mot=0;
     acc_mot=0;
+    n_part_joints=0;
     cycles =10;
+    cycle=0;
     tolerance = 1.0;
-    plot_enabled = false;
 }
 
-OpticalEncodersConsistency::~OpticalEncodersConsistency() { }
+EncodersConsistencyPart::~EncodersConsistencyPart() { close(); }
 
-bool OpticalEncodersConsistency::setup(yarp::os::Property& property) {
+bool EncodersConsistencyPart::open(const std::string& robot, const std::string& part, yarp::os::Searchable& config, double tol, int cyc)
+{
+    partName = part;
+    tolerance = tol;
+    cycles = cyc;
 
-    if(property.check("name"))
-        setName(property.find("name").asString());
+    //the tolerance can be overridden for each part
+    if (config.check("tolerance"))
+    {tolerance = config.find("tolerance").asFloat64();}
 
-    char b[5000];
-    strcpy (b,property.toString().c_str());
-    ROBOTTESTINGFRAMEWORK_TEST_REPORT("on setup()");
     // updating parameters
-    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("robot"), "The robot name must be given as the test parameter!");
-    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("part"), "The part name must be given as the test parameter!");
-    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("joints"), "The joints list must be given as the test parameter!");
-    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("home"),      "The home position must be given as the test parameter!");
-    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("max"),       "The max position must be given as the test parameter!");
-    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("min"),       "The min position must be given as the test parameter!");
-    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("speed"),     "The positionMove reference speed must be given as the test parameter!");
-    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("tolerance"), "The tolerance of the control signal must be given as the test parameter!");
-    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("matrix_size"),  "The matrix size must be given!");
-   // ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("matrix"),       "The coupling matrix must be given!");
-    robotName = property.find("robot").asString();
-    partName = property.find("part").asString();
-    if(property.check("plot_enabled"))
-        plot_enabled = property.find("plot_enabled").asBool();
-    /*if(plot_enabled)
-    {
-        plotString1 = property.find("plotString1").asString();
-        plotString2 = property.find("plotString2").asString();
-        plotString3 = property.find("plotString3").asString();
-        plotString4 = property.find("plotString4").asString();
-    }*/
-    Bottle* jointsBottle = property.find("joints").asList();
-    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(jointsBottle!=0,"unable to parse joints parameter");
+    if (!config.check("joints"))      { error = "The joints list must be given for part " + part; return false; }
+    if (!config.check("home"))        { error = "The home position must be given for part " + part; return false; }
+    if (!config.check("max"))         { error = "The max position must be given for part " + part; return false; }
+    if (!config.check("min"))         { error = "The min position must be given for part " + part; return false; }
+    if (!config.check("speed"))       { error = "The positionMove reference speed must be given for part " + part; return false; }
+    if (!config.check("matrix_size")) { error = "The matrix size must be given for part " + part; return false; }
 
-    Bottle* homeBottle = property.find("home").asList();
-    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(homeBottle!=0,"unable to parse home parameter");
+    Bottle* jointsBottle = config.find("joints").asList();
+    if (jointsBottle==0) { error = "unable to parse joints parameter"; return false; }
 
-    Bottle* maxBottle = property.find("max").asList();
-    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(maxBottle!=0,"unable to parse max parameter");
+    Bottle* homeBottle = config.find("home").asList();
+    if (homeBottle==0) { error = "unable to parse home parameter"; return false; }
 
-    Bottle* minBottle = property.find("min").asList();
-    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(minBottle!=0,"unable to parse min parameter");
+    Bottle* maxBottle = config.find("max").asList();
+    if (maxBottle==0) { error = "unable to parse max parameter"; return false; }
 
-    Bottle* speedBottle = property.find("speed").asList();
-    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(speedBottle!=0,"unable to parse speed parameter");
+    Bottle* minBottle = config.find("min").asList();
+    if (minBottle==0) { error = "unable to parse min parameter"; return false; }
 
-    tolerance = property.find("tolerance").asFloat64();
-    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(tolerance>=0,"invalid tolerance");
+    Bottle* speedBottle = config.find("speed").asList();
+    if (speedBottle==0) { error = "unable to parse speed parameter"; return false; }
 
-    int matrix_size=property.find("matrix_size").asInt32();
+    int matrix_size=config.find("matrix_size").asInt32();
     if (matrix_size>0)
     {
         matrix.resize(matrix_size,matrix_size);
         matrix.eye();
 
         // The couplig matrix is retrived run-time by the IRemoteVariable interface accessing the jinimatic_mj variable
-        //
-        // Bottle* matrixBottle = property.find("matrix").asList();
-
-        // if (matrixBottle!= NULL && matrixBottle->size() == (matrix_size*matrix_size) )
-        // {
-        //     for (int i=0; i< (matrix_size*matrix_size); i++)
-        //     {
-        //         matrix.data()[i]=matrixBottle->get(i).asFloat64();
-        //     }
-        // }
-        // else
-        // {
-        //    char buff [500];
-        //    sprintf (buff, "invalid number of elements of parameter matrix %d!=%d", matrixBottle->size() , (matrix_size*matrix_size));
-        //    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR(buff);
-        // }
     }
     else
     {
-        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR("invalid matrix_size: must be >0");
+        error = "invalid matrix_size: must be >0";
+        return false;
     }
 
-    //optional parameters
-    if (property.check("cycles"))
-    {cycles = property.find("cycles").asInt32();}
-
     Property options;
     options.put("device", "remote_controlboard");
-    options.put("remote", "/"+robotName+"/"+partName);
-    options.put("local", "/positionDirectTest/"+robotName+"/"+partName);
+    options.put("remote", "/"+robot+"/"+partName);
+    options.put("local", "/positionDirectTest/"+robot+"/"+partName);
 
     dd = new PolyDriver(options);
-    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->isValid(),"Unable to open device driver");
-    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(ienc),"Unable to open encoders interface");
-    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(ipos),"Unable to open position interface");
-    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(icmd),"Unable to open control mode interface");
-    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(iimd),"Unable to open interaction mode interface");
-    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(imotenc),"Unable to open motor encoders interface");
-    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(imot),"Unable to open motor interface");
-    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(ivar),"Unable to open remote variables interface");
-
+    if (!dd->isValid())       { error = "Unable to open device driver for part " + partName; return false; }
+    if (!dd->view(ienc))      { error = "Unable to open encoders interface"; return false; }
+    if (!dd->view(ipos))      { error = "Unable to open position interface"; return false; }
+    if (!dd->view(icmd))      { error = "Unable to open control mode interface"; return false; }
+    if (!dd->view(iimd))      { error = "Unable to open interaction mode interface"; return false; }
+    if (!dd->view(imotenc))   { error = "Unable to open motor encoders interface"; return false; }
+    if (!dd->view(imot))      { error = "Unable to open motor interface"; return false; }
+    if (!dd->view(ivar))      { error = "Unable to open remote variables interface"; return false; }
 
     if (!ienc->getAxes(&n_part_joints))
     {
-        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR("unable to get the number of joints of the part");
+        error = "unable to get the number of joints of the part";
+        return false;
     }
 
     int n_cmd_joints = jointsBottle->size();
-    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(n_cmd_joints>0 && n_cmd_joints<=n_part_joints,"invalid number of joints, it must be >0 & <= number of part joints");
+    if (!(n_cmd_joints>0 && n_cmd_joints<=n_part_joints))
+    {
+        error = "invalid number of joints, it must be >0 & <= number of part joints";
+        return false;
+    }
     jointsList.clear();
     for (int i=0; i <n_cmd_joints; i++) jointsList.push_back(jointsBottle->get(i).asInt32());
 
@@ -194,6 +214,7 @@ bool OpticalEncodersConsistency::setup(yarp::os::Property& property) {
     prev_acc_jnt.resize(n_cmd_joints); prev_acc_jnt.zero();
     prev_acc_mot.resize(n_cmd_joints); prev_acc_mot.zero();
     prev_acc_jnt2mot.resize(n_cmd_joints); prev_acc_jnt2mot.zero();
+    max_pos_err.resize(n_cmd_joints); max_pos_err.zero();
     zero_vector.resize(n_cmd_joints);
     zero_vector.zero();
 
@@ -209,23 +230,20 @@ bool OpticalEncodersConsistency::setup(yarp::os::Property& property) {
         gearbox[i]=t;
     }
 
+    recorder.addPart(partName);
 
     return true;
 }
 
-void OpticalEncodersConsistency::tearDown()
+void EncodersConsistencyPart::close()
 {
-    char buff[500];
-    sprintf(buff,"Closing test module");ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
-    setMode(VOCAB_CM_POSITION);
-    goHome();
     if (dd) {delete dd; dd =0;}
 }
 
-void OpticalEncodersConsistency::setMode(int desired_mode)
+bool EncodersConsistencyPart::setMode(int desired_mode)
 {
-    if (icmd == 0) ROBOTTESTINGFRAMEWORK_ASSERT_ERROR("Invalid control mode interface");
-    if (iimd == 0) ROBOTTESTINGFRAMEWORK_ASSERT_ERROR("Invalid interaction mode interface");
+    if (icmd == 0) { error = "Invalid control mode interface"; return false; }
+    if (iimd == 0) { error = "Invalid interaction mode interface"; return false; }
 
     for (unsigned int i=0; i<jointsList.size(); i++)
     {
@@ -250,30 +268,33 @@ void OpticalEncodersConsistency::setMode(int desired_mode)
         if (ok==jointsList.size()) break;
         if (timeout>100)
         {
-            ROBOTTESTINGFRAMEWORK_ASSERT_ERROR("Unable to set control mode/interaction mode");
+            error = "Unable to set control mode/interaction mode on part " + partName;
+            return false;
         }
         yarp::os::Time::delay(0.2);
         timeout++;
     }
+    return true;
 }
 
-void OpticalEncodersConsistency::goHome()
+bool EncodersConsistencyPart::moveHome()
 {
-    if (ipos == 0) ROBOTTESTINGFRAMEWORK_ASSERT_ERROR("Invalid position control interface");
-    if (ienc == 0) ROBOTTESTINGFRAMEWORK_ASSERT_ERROR("Invalid encoders interface");
+    if (ipos == 0) { error = "Invalid position control interface"; return false; }
+    if (ienc == 0) { error = "Invalid encoders interface"; return false; }
 
     bool ret = true;
-    char buff [500];
-    sprintf(buff,"Homing the whole part");ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
-
     for (unsigned int i=0; i<jointsList.size(); i++)
     {
         ret = ipos->setRefSpeed((int)jointsList[i],speed[i]);
-        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(ret, "ipos->setRefSpeed returned false");
+        if (!ret) { error = "ipos->setRefSpeed returned false"; return false; }
         ret = ipos->positionMove((int)jointsList[i],home[i]);
-        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(ret, "ipos->positionMove returned false");
+        if (!ret) { error = "ipos->positionMove returned false"; return false; }
     }
+    return true;
+}
 
+bool EncodersConsistencyPart::waitHome()
+{
     int timeout = 0;
     while (1)
     {
@@ -287,44 +308,17 @@ void OpticalEncodersConsistency::goHome()
         if (in_position==jointsList.size()) break;
         if (timeout>100)
         {
-            ROBOTTESTINGFRAMEWORK_ASSERT_ERROR("Timeout while reaching home position");
+            error = "Timeout while reaching home position on part " + partName;
+            return false;
         }
         yarp::os::Time::delay(0.2);
         timeout++;
     }
+    return true;
 }
 
-void OpticalEncodersConsistency::saveToFile(std::string filename, yarp::os::Bottle &b)
-{
-    std::fstream fs;
-    fs.open (filename.c_str(), std::fstream::out);
-
-    for (int i=0; i<b.size(); i++)
-    {
-        std::string s = b.get(i).toString();
-        std::replace(s.begin(), s.end(), '(', ' ');
-        std::replace(s.begin(), s.end(), ')', ' ');
-        fs << s << endl;
-    }
-
-    fs.close();
-}
-
-void OpticalEncodersConsistency::run()
+bool EncodersConsistencyPart::readCouplingMatrix()
 {
-    char buff [500];
-    setMode(VOCAB_CM_POSITION);
-    goHome();
-
-    bool go_to_max=false;
-    for (unsigned int i=0; i<jointsList.size(); i++)
-    {
-        ipos->positionMove((int)jointsList[i], min[i]);
-    }
-
-    int  cycle=0;
-    double start_time = yarp::os::Time::now();
-
     //****************************************************************************************
     //Retrieving coupling matrix using IRemoteVariable
     //****************************************************************************************
@@ -379,17 +373,21 @@ void OpticalEncodersConsistency::run()
     trasp_matrix = matrix.transposed();
     inv_matrix = yarp::math::luinv(matrix);
     inv_trasp_matrix = inv_matrix.transposed();
+    return true;
+}
 
-    sprintf(buff,"Matrix:\n %s \n", matrix.toString().c_str());
-    ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
-    sprintf(buff,"Inv matrix:\n %s \n", inv_matrix.toString().c_str());
-    ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+void EncodersConsistencyPart::run()
+{
+    error.clear();
 
-    Bottle dataToPlot_test1;
-    Bottle dataToPlot_test2;
-    Bottle dataToPlot_test3;
-    Bottle dataToPlot_test4;
-    Bottle dataToPlot_test1rev;
+    bool go_to_max=false;
+    for (unsigned int i=0; i<jointsList.size(); i++)
+    {
+        ipos->positionMove((int)jointsList[i], min[i]);
+    }
+
+    cycle=0;
+    double start_time = yarp::os::Time::now();
 
     bool test_data_is_valid = false;
     bool first_time = true;
@@ -399,10 +397,9 @@ void OpticalEncodersConsistency::run()
     yarp::sig::Vector off_enc_mot2jnt; off_enc_mot2jnt.resize(jointsList.size());
     yarp::sig::Vector tmp_vector;
     tmp_vector.resize(n_part_joints);
+    max_pos_err.zero();
 
-
-
-    while (1)
+    while (!isStopping())
     {
         double curr_time = yarp::os::Time::now();
         double elapsed = curr_time - start_time;
@@ -413,24 +410,17 @@ void OpticalEncodersConsistency::run()
             enc_jnt[i] = tmp_vector[jointsList[i]];
 
 
-        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(ret, "ienc->getEncoders returned false");
+        if (!ret) { error = "ienc->getEncoders returned false"; return; }
         ret = imotenc->getMotorEncoders(tmp_vector.data());             for (unsigned int i = 0; i < jointsList.size(); i++) enc_mot[i] = tmp_vector[jointsList(i)];
-        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(ret, "imotenc->getMotorEncoder returned false");
+        if (!ret) { error = "imotenc->getMotorEncoder returned false"; return; }
         ret = ienc->getEncoderSpeeds(tmp_vector.data());             for (unsigned int i = 0; i < jointsList.size(); i++) vel_jnt[i] = tmp_vector[jointsList(i)];
-        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(ret, "ienc->getEncoderSpeeds returned false");
+        if (!ret) { error = "ienc->getEncoderSpeeds returned false"; return; }
         ret = imotenc->getMotorEncoderSpeeds(tmp_vector.data());        for (unsigned int i = 0; i < jointsList.size(); i++) vel_mot[i] = tmp_vector[jointsList(i)];
-        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(ret, "imotenc->getMotorEncoderSpeeds returned false");
+        if (!ret) { error = "imotenc->getMotorEncoderSpeeds returned false"; return; }
         ret = ienc->getEncoderAccelerations(tmp_vector.data());      for (unsigned int i = 0; i < jointsList.size(); i++) acc_jnt[i] = tmp_vector[jointsList(i)];
-        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(ret, "ienc->getEncoderAccelerations returned false");
+        if (!ret) { error = "ienc->getEncoderAccelerations returned false"; return; }
         ret = imotenc->getMotorEncoderAccelerations(tmp_vector.data()); for (unsigned int i = 0; i < jointsList.size(); i++) acc_mot[i] = tmp_vector[jointsList(i)];
-        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(ret, "imotenc->getMotorEncoderAccelerations returned false");
-
-        //if (enc_jnt == zero_vector) { ROBOTTESTINGFRAMEWORK_TEST_REPORT("Invalid getEncoders data"); test_data_is_valid = true; }
-        //if (enc_mot == zero_vector) { ROBOTTESTINGFRAMEWORK_TEST_REPORT("Invalid getMotorEncoders data"); test_data_is_valid = true; }
-        //if (vel_jnt == zero_vector) { ROBOTTESTINGFRAMEWORK_TEST_REPORT("Invalid getEncoderSpeeds data"); test_data_is_valid = true; }
-        //if (vel_mot == zero_vector) { ROBOTTESTINGFRAMEWORK_TEST_REPORT("Invalid getMotorEncoderSpeeds data"); test_data_is_valid = true; }
-        //if (acc_jnt == zero_vector) { ROBOTTESTINGFRAMEWORK_TEST_REPORT("Invalid getEncoderAccelerations data"); test_data_is_valid = true; }
-        //if (acc_mot == zero_vector) { ROBOTTESTINGFRAMEWORK_TEST_REPORT("Invalid getMotorEncoderAccelerations data"); test_data_is_valid = true; }
+        if (!ret) { error = "imotenc->getMotorEncoderAccelerations returned false"; return; }
 
         if (first_time)
         {
@@ -463,12 +453,13 @@ void OpticalEncodersConsistency::run()
 
         if (elapsed >= 20.0)
         {
-            ROBOTTESTINGFRAMEWORK_ASSERT_ERROR("Timeout while moving joint");
+            error = "Timeout while moving joint on part " + partName;
+            return;
         }
 
         if (reached)
         {
-            sprintf(buff, "Test cycle %d/%d", cycle, cycles); ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+            yInfo() << partName << ": test cycle" << cycle << "/" << cycles;
             if (go_to_max == false)
             {
                 for (unsigned int i = 0; i < jointsList.size(); i++)
@@ -516,33 +507,25 @@ void OpticalEncodersConsistency::run()
         {
             //prepare data to plot
             //JOINT POSITIONS vs MOTOR POSITIONS
-            Bottle& row_test1 = dataToPlot_test1.addList();
-            Bottle& v1_test1 = row_test1.addList();
-            Bottle& v2_test1 = row_test1.addList();
             yarp::sig::Vector v1 = enc_mot - off_enc_mot;
             yarp::sig::Vector v2 = enc_jnt2mot - off_enc_jnt2mot;
-            v1_test1.read(v1);
-            v2_test1.read(v2);
+            recorder.record(partName, EncodersConsistencyRecorder::JNT_POS_MOT_POS, v1, v2);
+            for (unsigned int i = 0; i < jointsList.size(); i++)
+            {
+                if (fabs(v1[i] - v2[i]) > max_pos_err[i]) max_pos_err[i] = fabs(v1[i] - v2[i]);
+            }
         }
 
         {
             //JOINT VELOCITES vs MOTOR VELOCITIES
-            Bottle& row_test2 = dataToPlot_test2.addList();
-            Bottle& v1_test2 = row_test2.addList();
-            Bottle& v2_test2 = row_test2.addList();
-            v1_test2.read(vel_mot);
-            v2_test2.read(vel_jnt2mot);
+            recorder.record(partName, EncodersConsistencyRecorder::JNT_VEL_MOT_VEL, vel_mot, vel_jnt2mot);
         }
 
         {
             //JOINT POSITIONS(DERIVED) vs JOINT SPEED
             if (first_time == false)
             {
-                Bottle& row_test3 = dataToPlot_test3.addList();
-                Bottle& v1_test3 = row_test3.addList();
-                Bottle& v2_test3 = row_test3.addList();
-                v1_test3.read(vel_jnt);
-                v2_test3.read(diff_enc_jnt);
+                recorder.record(partName, EncodersConsistencyRecorder::JNT_DERIVED_VEL, vel_jnt, diff_enc_jnt);
             }
         }
 
@@ -550,23 +533,15 @@ void OpticalEncodersConsistency::run()
             //MOTOR POSITIONS(DERIVED) vs MOTOR SPEED
             if (first_time == false)
             {
-                Bottle& row_test4 = dataToPlot_test4.addList();
-                Bottle& v1_test4 = row_test4.addList();
-                Bottle& v2_test4 = row_test4.addList();
-                v1_test4.read(vel_mot);
-                v2_test4.read(diff_enc_mot);
+                recorder.record(partName, EncodersConsistencyRecorder::MOT_DERIVED_VEL, vel_mot, diff_enc_mot);
             }
         }
 
         {
             //JOINT POSITIONS vs MOTOR POSITIONS REVERSED
-            Bottle& row_test1 = dataToPlot_test1rev.addList();
-            Bottle& v1_test1 = row_test1.addList();
-            Bottle& v2_test1 = row_test1.addList();
             yarp::sig::Vector v1 = enc_jnt;
             yarp::sig::Vector v2 = enc_mot2jnt + off_enc_jnt;
-            v1_test1.read(v1);
-            v2_test1.read(v2);
+            recorder.record(partName, EncodersConsistencyRecorder::JNT_POS_MOT_POS_REV, v1, v2);
         }
 
         //flag set
@@ -574,54 +549,179 @@ void OpticalEncodersConsistency::run()
 
         //exit condition
         if (cycle>=cycles) break;
+
+        //the numerical derivatives above assume a 10ms sample time
+        yarp::os::Time::delay(0.010);
+    }
+}
+
+OpticalEncodersConsistency::OpticalEncodersConsistency() : yarp::robottestingframework::TestCase("OpticalEncodersConsistency") {
+    cycles =10;
+    tolerance = 1.0;
+    plot_enabled = false;
+}
+
+OpticalEncodersConsistency::~OpticalEncodersConsistency() { }
+
+bool OpticalEncodersConsistency::setup(yarp::os::Property& property) {
+
+    if(property.check("name"))
+        setName(property.find("name").asString());
+
+    ROBOTTESTINGFRAMEWORK_TEST_REPORT("on setup()");
+    // updating parameters
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("robot"), "The robot name must be given as the test parameter!");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("part") || property.check("parts"), "The part name must be given as the test parameter!");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("tolerance"), "The tolerance of the control signal must be given as the test parameter!");
+    robotName = property.find("robot").asString();
+    if(property.check("plot_enabled"))
+        plot_enabled = property.find("plot_enabled").asBool();
+
+    tolerance = property.find("tolerance").asFloat64();
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(tolerance>=0,"invalid tolerance");
+
+    //optional parameters
+    if (property.check("cycles"))
+    {cycles = property.find("cycles").asInt32();}
+
+    std::vector<std::string> partNames;
+    if (property.check("parts"))
+    {
+        Bottle* partsBottle = property.find("parts").asList();
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(partsBottle!=0 && partsBottle->size()>0,"unable to parse parts parameter");
+        for (size_t i=0; i<partsBottle->size(); i++) partNames.push_back(partsBottle->get(i).asString());
+    }
+    else
+    {
+        partNames.push_back(property.find("part").asString());
     }
 
+    for (size_t i=0; i<partNames.size(); i++)
+    {
+        EncodersConsistencyPart* p = new EncodersConsistencyPart(recorder);
+        parts.push_back(p);
+        bool ok = false;
+        if (property.check("parts"))
+        {
+            Bottle& group = property.findGroup(partNames[i]);
+            ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(!group.isNull(), Asserter::format("Missing group for part %s", partNames[i].c_str()));
+            ok = p->open(robotName, partNames[i], group, tolerance, cycles);
+        }
+        else
+        {
+            ok = p->open(robotName, partNames[i], property, tolerance, cycles);
+        }
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(ok, p->getError());
+    }
+
+    return true;
+}
+
+void OpticalEncodersConsistency::tearDown()
+{
+    char buff[500];
+    sprintf(buff,"Closing test module");ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+    for (size_t i=0; i<parts.size(); i++) parts[i]->stop();
+    setMode(VOCAB_CM_POSITION);
     goHome();
+    for (size_t i=0; i<parts.size(); i++) delete parts[i];
+    parts.clear();
+}
 
-    yarp::os::ResourceFinder rf;
-    rf.setDefaultContext("scripts");
+void OpticalEncodersConsistency::setMode(int desired_mode)
+{
+    for (size_t i=0; i<parts.size(); i++)
+    {
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(parts[i]->setMode(desired_mode), parts[i]->getError());
+    }
+}
 
-    string partfilename = partName+".txt";
-    string testfilename = "encConsis_";
-    string filename1 = testfilename + "jointPos_MotorPos_" + partfilename;
-    saveToFile(filename1,dataToPlot_test1);
-    string filename2 = testfilename + "jointVel_motorVel_" + partfilename;
-    saveToFile(filename2,dataToPlot_test2);
-    string filename3 = testfilename + "joint_derivedVel_vel_" + partfilename;
-    saveToFile(filename3,dataToPlot_test3);
-    string filename4 = testfilename + "motor_derivedVel_vel_" + partfilename;
-    saveToFile(filename4,dataToPlot_test4);
-
-    string filename1rev = testfilename + "jointPos_MotorPos_reversed_" + partfilename;
-    saveToFile(filename1rev,dataToPlot_test1rev);
+void OpticalEncodersConsistency::goHome()
+{
+    char buff [500];
+    sprintf(buff,"Homing the whole part");ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
 
-    //find octave scripts
-    std::string octaveFile = rf.findFile("encoderConsistencyPlotAll.m");
-    if(octaveFile.size() == 0)
+    //all the parts are commanded first, so that they move together
+    for (size_t i=0; i<parts.size(); i++)
+    {
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(parts[i]->moveHome(), parts[i]->getError());
+    }
+    for (size_t i=0; i<parts.size(); i++)
     {
-        yError()<<"Cannot find file encoderConsistencyPlotAll.m";
-        return;
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(parts[i]->waitHome(), parts[i]->getError());
     }
+}
+
+void OpticalEncodersConsistency::run()
+{
+    char buff [500];
+    setMode(VOCAB_CM_POSITION);
+    goHome();
 
-    //prepare octave command
-    std::string octaveCommand= "octave --path "+ getPath(octaveFile);
-    stringstream ss;
-    ss << jointsList.size();
-    string str = ss.str();
-    octaveCommand+= " -q --eval \"encoderConsistencyPlotAll('" +partName +"'," + str +")\"  --persist";
+    for (size_t i=0; i<parts.size(); i++)
+    {
+        parts[i]->readCouplingMatrix();
+        sprintf(buff,"Matrix (%s):\n %s \n", parts[i]->getPartName().c_str(), parts[i]->getMatrix().toString().c_str());
+        ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+        sprintf(buff,"Inv matrix (%s):\n %s \n", parts[i]->getPartName().c_str(), parts[i]->getInvMatrix().toString().c_str());
+        ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
+    }
 
-    if(plot_enabled)
+    //one acquisition thread per part
+    double start_time = yarp::os::Time::now();
+    for (size_t i=0; i<parts.size(); i++)
     {
-        int ret = system (octaveCommand.c_str());
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(parts[i]->start(), Asserter::format("Unable to start the acquisition thread of part %s", parts[i]->getPartName().c_str()));
     }
-    else
+    for (size_t i=0; i<parts.size(); i++)
+    {
+        parts[i]->join();
+    }
+    ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Acquisition of %d part(s) completed in %.1f s", (int)parts.size(), yarp::os::Time::now()-start_time));
+
+    goHome();
+
+    yarp::os::ResourceFinder rf;
+    rf.setDefaultContext("scripts");
+
+    //find octave scripts
+    std::string octaveFile = rf.findFile("encoderConsistencyPlotAll.m");
+
+    for (size_t p=0; p<parts.size(); p++)
     {
-         yInfo() << "Test has collected all data. You need to plot data to check is test is passed";
-         yInfo() << "Please run following command to plot data.";
-         yInfo() << octaveCommand;
-         yInfo() << "To exit from Octave application please type 'exit' command.";
+        const std::string& partName = parts[p]->getPartName();
+        recorder.saveToFiles(partName);
+
+        ROBOTTESTINGFRAMEWORK_TEST_CHECK(parts[p]->getError().empty(), Asserter::format("Part %s: %s", partName.c_str(), parts[p]->getError().c_str()));
+        ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Part %s: %d/%d cycles, max joint vs motor position mismatch (motor units): %s",
+                                                            partName.c_str(), parts[p]->getCompletedCycles(), cycles,
+                                                            parts[p]->getMaxPosError().toString().c_str()));
+
+        if(octaveFile.size() == 0)
+        {
+            yError()<<"Cannot find file encoderConsistencyPlotAll.m";
+            continue;
+        }
+
+        //prepare octave command
+        std::string octaveCommand= "octave --path "+ getPath(octaveFile);
+        stringstream ss;
+        ss << parts[p]->getJointsNum();
+        string str = ss.str();
+        octaveCommand+= " -q --eval \"encoderConsistencyPlotAll('" +partName +"'," + str +")\"  --persist";
+
+        if(plot_enabled)
+        {
+            int ret = system (octaveCommand.c_str());
+        }
+        else
+        {
+             yInfo() << "Test has collected all data. You need to plot data to check is test is passed";
+             yInfo() << "Please run following command to plot data.";
+             yInfo() << octaveCommand;
+             yInfo() << "To exit from Octave application please type 'exit' command.";
+        }
     }
-   // ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(test_data_is_valid,"Invalid data obtained from encoders interface");
 }
 
 
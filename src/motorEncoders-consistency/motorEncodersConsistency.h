@@ -22,11 +22,17 @@
 #define _OPTICALENCODERSCONSISTENCY_H_
 
 #include <string>
+#include <vector>
+#include <map>
+#include <mutex>
 #include <yarp/robottestingframework/TestCase.h>
 #include <yarp/dev/ControlBoardInterfaces.h>
 #include <yarp/dev/PolyDriver.h>
 #include <yarp/sig/Vector.h>
 #include <yarp/sig/Matrix.h>
+#include <yarp/os/Bottle.h>
+#include <yarp/os/Searchable.h>
+#include <yarp/os/Thread.h>
 
 /**
 * \ingroup icub-tests
@@ -42,9 +48,15 @@
 * The conversion formula from motor measurments (M) to joint encoder measurements (J) is the following:
 * J = kinematic_mj * gearbox * M
 * with kinematic_mj the joints coupling matrix and gearbox the gearbox reduction factor (e.g. 1:100)
+*
+* Several mechanically independent parts can be tested at once by listing them in the parts parameter.
+* In this case the part-specific parameters (joints, home, max, min, speed, matrix_size and optionally tolerance) are read from a group named after each part,
+* every part is cycled by its own acquisition thread and the data of all the parts are collected by a shared recorder.
+* The data files and the results are still produced per part.
 
 * Example: testRunner v -t motorEncodersConsistency.dll -p "--robot icub --part left_arm --joints ""(0 1 2)"" --home ""(-30 30 10)"" --speed ""(20 20 20)"" --max ""(-20 40 20)"" --min ""(-40 20 0)"" --cycles 10 --tolerance 1.0 "
 * Example: testRunner v -s "..\icub-tests\suites\encoders-icubSim.xml"
+* Example: testRunner v -t motorEncodersConsistency.dll -p "--from motorEncoderConsistency_allParts.ini"
 
 * Check the following functions:
 * \li IEncoders::getEncoders()
@@ -60,7 +72,8 @@
 * | Parameter name     | Type   | Units | Default Value | Required | Description | Notes |
 * |:------------------:|:------:|:-----:|:-------------:|:--------:|:-----------:|:-----:|
 * | robot              | string | -     | -             | Yes      | The name of the robot.     | e.g. icub |
-* | part               | string | -     | -             | Yes      | The name of trhe robot part. | e.g. left_arm |
+* | part               | string | -     | -             | Yes      | The name of trhe robot part. | e.g. left_arm. Not used if parts is given |
+* | parts              | vector of strings | - | -        | No       | The names of the robot parts to be tested concurrently | e.g. (left_arm right_arm torso). Each part needs a group with its own joints, home, max, min, speed and matrix_size |
 * | joints             | vector of ints | -     |     - | Yes      | List of joints to be tested | |
 * | home               | vector of doubles of size joints  | deg   | - | Yes | The home position for each joint | |
 * | cycles             | int    | -     | 10            | No       | The number of test cycles (going from max to min position and viceversa | |
@@ -74,41 +87,72 @@
 * | plotstring2 | string |      | - | Yes | The string which generates plot 2 | |
 * | plotstring3 | string |      | - | Yes | The string which generates plot 3 | |
 * | plotstring4 | string |      | - | Yes | The string which generates plot 4 | |
+* | plot_enabled | bool  | -     | false | No | If true, octave is launched at the end of the test to plot the data of each part | |
 
 *
 */
-class OpticalEncodersConsistency : public yarp::robottestingframework::TestCase {
+class EncodersConsistencyRecorder
+{
 public:
-    OpticalEncodersConsistency();
-    virtual ~OpticalEncodersConsistency();
+    enum dataset_t
+    {
+        JNT_POS_MOT_POS     = 0,
+        JNT_VEL_MOT_VEL     = 1,
+        JNT_DERIVED_VEL     = 2,
+        MOT_DERIVED_VEL     = 3,
+        JNT_POS_MOT_POS_REV = 4,
+        DATASETS_NUM        = 5
+    };
+
+    void addPart(const std::string& part);
+    void record(const std::string& part, dataset_t dataset, const yarp::sig::Vector& v1, const yarp::sig::Vector& v2);
+    void saveToFiles(const std::string& part);
 
-    virtual bool setup(yarp::os::Property& property);
+private:
+    void saveToFile(std::string filename, yarp::os::Bottle &b);
 
-    virtual void tearDown();
+    std::mutex mtx;
+    std::map<std::string, std::vector<yarp::os::Bottle> > data;
+};
+
+class EncodersConsistencyPart : public yarp::os::Thread
+{
+public:
+    EncodersConsistencyPart(EncodersConsistencyRecorder& rec);
+    virtual ~EncodersConsistencyPart();
 
+    bool open(const std::string& robot, const std::string& part, yarp::os::Searchable& config, double tol, int cyc);
+    void close();
+
+    bool setMode(int desired_mode);
+    bool moveHome();
+    bool waitHome();
+    bool readCouplingMatrix();
+
+    //performs the test cycles, collecting data into the recorder
     virtual void run();
 
-    void goHome();
-    void setMode(int desired_mode);
-    void saveToFile(std::string filename, yarp::os::Bottle &b);
+    const std::string& getPartName() const { return partName; }
+    const std::string& getError() const { return error; }
+    int getJointsNum() const { return (int)jointsList.size(); }
+    const yarp::sig::Matrix& getMatrix() const { return matrix; }
+    const yarp::sig::Matrix& getInvMatrix() const { return inv_matrix; }
+    const yarp::sig::Vector& getMaxPosError() const { return max_pos_err; }
+    int getCompletedCycles() const { return cycle; }
 
 private:
-    std::string getPath(const std::string& str);
-    std::string robotName;
+    EncodersConsistencyRecorder& recorder;
     std::string partName;
-    std::string plotString1;
-    std::string plotString2;
-    std::string plotString3;
-    std::string plotString4;
+    std::string error;
 
     yarp::sig::Vector jointsList;
 
     double tolerance;
-    bool plot_enabled;
 
     int    n_part_joints;
     int    cycles;
-     
+    int    cycle;
+
     yarp::dev::PolyDriver        *dd;
     yarp::dev::IPositionControl  *ipos;
     yarp::dev::IControlMode      *icmd;
@@ -158,21 +202,49 @@ private:
     yarp::sig::Vector diff_acc_mot;
     yarp::sig::Vector diff_acc_mot2jnt;
 
+    yarp::sig::Vector max_pos_err;
+
     yarp::sig::Vector max;
     yarp::sig::Vector min;
     yarp::sig::Vector home;
     yarp::sig::Vector speed;
     yarp::sig::Vector gearbox;
 
-    yarp::sig::Matrix matrix_arms;
-    yarp::sig::Matrix matrix_torso;
-    yarp::sig::Matrix matrix_legs;
-    yarp::sig::Matrix matrix_head;
-
     yarp::sig::Matrix matrix;
     yarp::sig::Matrix inv_matrix;
     yarp::sig::Matrix trasp_matrix;
     yarp::sig::Matrix inv_trasp_matrix;
 };
 
+class OpticalEncodersConsistency : public yarp::robottestingframework::TestCase {
+public:
+    OpticalEncodersConsistency();
+    virtual ~OpticalEncodersConsistency();
+
+    virtual bool setup(yarp::os::Property& property);
+
+    virtual void tearDown();
+
+    virtual void run();
+
+    void goHome();
+    void setMode(int desired_mode);
+
+private:
+    std::string getPath(const std::string& str);
+    std::string robotName;
+    std::string plotString1;
+    std::string plotString2;
+    std::string plotString3;
+    std::string plotString4;
+
+    double tolerance;
+    bool plot_enabled;
+
+    int    cycles;
+
+    EncodersConsistencyRecorder recorder;
+    std::vector<EncodersConsistencyPart*> parts;
+};
+
 #endif //_opticalEncoders_H
@@ -24,6 +24,8 @@
 #include <yarp/os/Time.h>
 #include <yarp/os/Property.h>
 #include <algorithm>
+#include <string>
+#include <vector>
 #include "motorEncodersSignCheck.h"
 #include "iostream"
 
@@ -43,7 +45,11 @@ MotorEncodersSignCheck::MotorEncodersSignCheck() : yarp::robottestingframework::
     iimd=0;
     ienc=0;
     imenc=0;
+    ilim=0;
     jPosMotion=0;
+    pulse_mode=false;
+    pulse_duration=0.2;
+    pulse_rest=0.3;
 }
 
 MotorEncodersSignCheck::~MotorEncodersSignCheck() { }
@@ -89,6 +95,18 @@ bool MotorEncodersSignCheck::setup(yarp::os::Property& property) {
     Bottle* pwm_start_Bottle = property.find("pwmStart").asList();
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(pwm_start_Bottle!=0,"unable to parse pwmStart parameter");
 
+    if(property.check("mode"))
+    {
+        std::string mode = property.find("mode").asString();
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(mode=="ramp" || mode=="pulse", "mode must be ramp or pulse");
+        pulse_mode = (mode=="pulse");
+    }
+    if(property.check("pulseDuration"))
+        pulse_duration = property.find("pulseDuration").asFloat64();
+    if(property.check("pulseRest"))
+        pulse_rest = property.find("pulseRest").asFloat64();
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(pulse_duration>0 && pulse_rest>=0, "pulseDuration must be greater than zero and pulseRest not negative");
+
 
     Property options;
     options.put("device", "remote_controlboard");
@@ -103,6 +121,7 @@ bool MotorEncodersSignCheck::setup(yarp::os::Property& property) {
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(iimd),"Unable to open interaction mode interface");
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(imenc),"Unable to open interaction mode interface");
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(ipid),"Unable to open ipidcontrol interface");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(ilim),"Unable to open limits interface");
 
     if (!ienc->getAxes(&n_part_joints))
     {
@@ -142,6 +161,48 @@ bool MotorEncodersSignCheck::setup(yarp::os::Property& property) {
             opl_delay[i]=0.1;
     }
 
+    //without jointGroups all the joints are pulsed at once
+    joint_groups.clear();
+    if (property.check("jointGroups"))
+    {
+        Bottle* groupsBottle = property.find("jointGroups").asList();
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(groupsBottle!=0,"unable to parse jointGroups parameter");
+        std::vector<bool> grouped(n_cmd_joints, false);
+        for (size_t g=0; g<groupsBottle->size(); g++)
+        {
+            Bottle* groupBottle = groupsBottle->get(g).asList();
+            ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(groupBottle!=0,"unable to parse jointGroups parameter");
+            std::vector<int> group;
+            for (size_t k=0; k<groupBottle->size(); k++)
+            {
+                int jnt = groupBottle->get(k).asInt32();
+                int idx = -1;
+                for (int i=0; i<n_cmd_joints; i++) if ((int)jointsList[i]==jnt) idx=i;
+                ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(idx>=0 && !grouped[idx], robottestingframework::Asserter::format("joint %d of jointGroups is not in joints or is in more groups", jnt));
+                grouped[idx]=true;
+                group.push_back(idx);
+            }
+            if (!group.empty()) joint_groups.push_back(group);
+        }
+        for (int i=0; i<n_cmd_joints; i++) if (!grouped[i]) joint_groups.push_back(std::vector<int>(1,i));
+    }
+    else
+    {
+        std::vector<int> group;
+        for (int i=0; i<n_cmd_joints; i++) group.push_back(i);
+        joint_groups.push_back(group);
+    }
+
+    max_lims.resize(n_cmd_joints);
+    min_lims.resize(n_cmd_joints);
+    for (int i=0; i <n_cmd_joints; i++) ilim->getLimits((int)jointsList[i],&min_lims[i],&max_lims[i]);
+
+    int n_motor_encs=0;
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(imenc->getNumberOfMotorEncoders(&n_motor_encs), "unable to get the number of motor encoders");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(n_motor_encs>=n_part_joints, "the number of motor encoders is smaller than the number of joints");
+    motor_encs.resize(n_motor_encs);
+    joint_encs.resize(n_part_joints);
+
     jPosMotion = new yarp::robottestingframework::jointsPosMotion(dd, jointsList);
     jPosMotion->setTolerance(2.0);
     jPosMotion->setTimeout(10); //10 sec
@@ -238,6 +299,107 @@ void MotorEncodersSignCheck::OplExecute(int i)
     }
 }
 
+void MotorEncodersSignCheck::PulseExecute(const std::vector<int>& group)
+{
+    //distance from the hw limits at which the pulses of a joint are stopped
+    double const limit_margin = 1.0;
+    int n_group_joints = group.size();
+    std::vector<int> joints(n_group_joints);
+    std::vector<int> pwm_modes(n_group_joints, VOCAB_CM_PWM);
+    std::vector<int> result(n_group_joints, SIGN_UNKNOWN);
+    std::vector<double> start_enc(n_group_joints, 0.0);
+    std::vector<double> last_enc(n_group_joints, 0.0);
+    std::vector<double> opl(n_group_joints);
+    for (int k=0; k<n_group_joints; k++)
+    {
+        joints[k]=(int)jointsList[group[k]];
+        opl[k]=opl_start[group[k]];
+    }
+
+    icmd->setControlModes(n_group_joints, joints.data(), pwm_modes.data());
+    for (int k=0; k<n_group_joints; k++)
+    {
+        iimd->setInteractionMode(joints[k], VOCAB_IM_STIFF);
+        ipwm->setRefDutyCycle(joints[k], 0.0);
+    }
+
+    double test_start = yarp::os::Time::now();
+    int pending = n_group_joints;
+    int pulses = 0;
+    while (pending>0)
+    {
+        //the joints may move (due to stiction or gravity) when pwm is zeroed, so the starting position is read after a rest
+        yarp::os::Time::delay(pulse_rest);
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(imenc->getMotorEncoders(motor_encs.data()), "getMotorEncoders returned false");
+        for (int k=0; k<n_group_joints; k++)
+        {
+            start_enc[k]=motor_encs[joints[k]];
+            if (result[k]==SIGN_UNKNOWN) ipwm->setRefDutyCycle(joints[k], opl[k]);
+        }
+
+        double pulse_start = yarp::os::Time::now();
+        while (yarp::os::Time::now()-pulse_start<pulse_duration && pending>0)
+        {
+            imenc->getMotorEncoders(motor_encs.data());
+            ienc->getEncoders(joint_encs.data());
+            for (int k=0; k<n_group_joints; k++)
+            {
+                if (result[k]!=SIGN_UNKNOWN) continue;
+                int i = group[k];
+                double enc = motor_encs[joints[k]];
+                double jnt_enc = joint_encs[joints[k]];
+                last_enc[k] = enc;
+                if      (enc > start_enc[k]+pos_threshold[i]) result[k]=SIGN_POSITIVE;
+                else if (enc < start_enc[k]-pos_threshold[i]) result[k]=SIGN_NEGATIVE;
+                else if (jnt_enc > max_lims[i]-limit_margin || jnt_enc < min_lims[i]+limit_margin) result[k]=SIGN_LIMIT_REACHED;
+                if (result[k]!=SIGN_UNKNOWN)
+                {
+                    ipwm->setRefDutyCycle(joints[k], 0.0);
+                    pending--;
+                }
+            }
+            yarp::os::Time::delay(0.005);
+        }
+
+        for (int k=0; k<n_group_joints; k++)
+        {
+            if (result[k]!=SIGN_UNKNOWN) continue;
+            int i = group[k];
+            ipwm->setRefDutyCycle(joints[k], 0.0);
+            if (opl[k]+opl_step[i]>opl_max[i])
+            {
+                result[k]=SIGN_MAX_OUTPUT;
+                pending--;
+            }
+            else
+            {
+                opl[k]+=opl_step[i];
+            }
+        }
+        pulses++;
+    }
+
+    ROBOTTESTINGFRAMEWORK_TEST_REPORT(robottestingframework::Asserter::format("Pulse test completed in %.2f s with %d pulses", yarp::os::Time::now()-test_start, pulses));
+    for (int k=0; k<n_group_joints; k++)
+    {
+        switch (result[k])
+        {
+            case SIGN_POSITIVE:
+                ROBOTTESTINGFRAMEWORK_TEST_REPORT(robottestingframework::Asserter::format("Joint %d: TEST SUCCESS (pwm=%f) enc=%f start_enc=%f", joints[k], opl[k], last_enc[k], start_enc[k]));
+            break;
+            case SIGN_NEGATIVE:
+                ROBOTTESTINGFRAMEWORK_TEST_FAIL_IF_FALSE(0, robottestingframework::Asserter::format("Joint %d failed because enc readings drecrease enc=%f start_enc=%f (output=%f)", joints[k], last_enc[k], start_enc[k], opl[k]));
+            break;
+            case SIGN_LIMIT_REACHED:
+                ROBOTTESTINGFRAMEWORK_TEST_FAIL_IF_FALSE(0, robottestingframework::Asserter::format("Joint %d failed because hw limit was touched (enc=%f)", joints[k], last_enc[k]));
+            break;
+            default:
+                ROBOTTESTINGFRAMEWORK_TEST_FAIL_IF_FALSE(0, robottestingframework::Asserter::format("Joint %d failed because max output was reached(output=%f)", joints[k], opl[k]));
+            break;
+        }
+    }
+}
+
 void MotorEncodersSignCheck::run()
 {
 
@@ -245,6 +407,19 @@ void MotorEncodersSignCheck::run()
     jPosMotion->setAndCheckPosControlMode();
     jPosMotion->goTo(home);
 
+    if (pulse_mode)
+    {
+        for (size_t g=0; g<joint_groups.size(); g++)
+        {
+            std::string joints_str;
+            for (size_t k=0; k<joint_groups[g].size(); k++) joints_str += std::to_string((int)jointsList[joint_groups[g][k]]) + " ";
+            ROBOTTESTINGFRAMEWORK_TEST_REPORT(robottestingframework::Asserter::format("Testing joints ( %s) at once with pulses of %.2f s", joints_str.c_str(), pulse_duration));
+            PulseExecute(joint_groups[g]);
+            jPosMotion->setAndCheckPosControlMode();
+            jPosMotion->goTo(home);
+        }
+        return;
+    }
 
     for (unsigned int i=0 ; i<jointsList.size(); i++)
     {
@@ -22,6 +22,7 @@
 #define _MOTORENCODERSSIGNCHECK_H_
 
 //#include <string>
+#include <vector>
 #include <yarp/robottestingframework/TestCase.h>
 #include <yarp/dev/ControlBoardInterfaces.h>
 #include <yarp/dev/PolyDriver.h>
@@ -38,6 +39,12 @@
 * The test sets one joint per time in Open Loop control mode; then applies positive pwm starting with value defined in parameter "pwmStart"
 * and increments pwm with step defined in parameter "pwmStep" until motor doesn't move of Posthreshold degree at least.
 *
+* With mode=pulse all the joints are tested at once: short pwm pulses of pulseDuration seconds, separated by pulseRest seconds
+* at zero pwm, are applied to every joint not yet checked. The amplitude of the pulses starts from pwmStart and increases by pwmStep
+* after each pulse, up to pwmMax. During a pulse all the motor encoders are read with a single call every tick, and the pwm of a joint
+* is zeroed as soon as its motor moves of Posthreshold degrees, in either direction, or the joint gets close to a hw limit.
+* In this mode pwmStep should be larger than in ramp mode, since each step lasts a single pulse, and commandDelay is not used.
+* With jointGroups the joints are pulsed one group at a time, so that coupled joints (e.g. the eyes) can be kept in different groups.
 *
 * Note: This test uses yarp::robottestingframework::jointsPosMotion class, a class for reduce time in developing test.
 *
@@ -56,6 +63,10 @@
 * | pwmMax             | vector of doubles of size joints  | -     | - | Yes | The max pwm applicable | |
 * | Posthreshold       | vector of doubles of size joints  | deg   | 5 | No  | The minumum movement to check if motor position increases | |
 * | commandDelay       | vector of doubles of size joints  | deg   | 0.1 | No  | The delay between two SetRefOpenLooop commands consecutive | |
+* | mode               | string | -     | ramp  | No  | ramp: one joint per time with increasing pwm, pulse: all joints at once with short pwm pulses | |
+* | pulseDuration      | double | s     | 0.2   | No  | The duration of each pwm pulse | used only with mode=pulse |
+* | pulseRest          | double | s     | 0.3   | No  | The time at zero pwm before each pulse | used only with mode=pulse |
+* | jointGroups        | list of lists of ints | - | - | No | The groups of joints pulsed together, the joints not listed are pulsed alone | used only with mode=pulse, e.g. ((0 1 2 3 4) (5)) |
 *
 */
 class MotorEncodersSignCheck : public yarp::robottestingframework::TestCase {
@@ -70,9 +81,19 @@ public:
     virtual void run();
     void setModeSingle(int i, int desired_control_mode, yarp::dev::InteractionModeEnum desired_interaction_mode);
     void OplExecute(int i);
+    void PulseExecute(const std::vector<int>& group);
 
 private:
 
+    enum sign_result_t
+    {
+        SIGN_UNKNOWN = 0,
+        SIGN_POSITIVE,
+        SIGN_NEGATIVE,
+        SIGN_LIMIT_REACHED,
+        SIGN_MAX_OUTPUT
+    };
+
     yarp::robottestingframework::jointsPosMotion *jPosMotion;
 
     std::string robotName;
@@ -87,6 +108,15 @@ private:
     yarp::sig::Vector pos_threshold;
     yarp::sig::Vector opl_start;
 
+    // pulse mode, buffers for the encoders of the whole part are preallocated in setup()
+    bool   pulse_mode;
+    double pulse_duration;
+    double pulse_rest;
+    yarp::sig::Vector motor_encs;
+    yarp::sig::Vector joint_encs;
+    //groups of indices in jointsList which are pulsed together (jointGroups parameter)
+    std::vector<std::vector<int> > joint_groups;
+
     int    n_part_joints;
 
     yarp::dev::PolyDriver        *dd;
@@ -96,6 +126,7 @@ private:
     yarp::dev::IPWMControl       *ipwm;
     yarp::dev::IMotorEncoders    *imenc;
     yarp::dev::IPidControl       *ipid;
+    yarp::dev::IControlLimits    *ilim;
 };
 
 #endif //_opticalEncoders_H
@@ -19,6 +19,7 @@
  */
 
 #include <cmath>
+#include <algorithm>
 
 #include <robottestingframework/dll/Plugin.h>
 #include <robottestingframework/TestAssert.h>
@@ -58,6 +59,11 @@ bool MovementReferencesTest::setup(yarp::os::Property &config)
     iControlMode=NULL;
     iVelocity=NULL;
     initialized=false;
+    pollPeriod=0.001;
+    refTimeout=1.0;
+    motionTimeout=10.0;
+    benchmark=false;
+    benchmarkSamples=50;
 
     if(config.check("name"))
         setName(config.find("name").asString());
@@ -75,6 +81,19 @@ bool MovementReferencesTest::setup(yarp::os::Property &config)
     robotName = config.find("robot").asString();
     partName  = config.find("part").asString();
 
+    if(config.check("pollPeriod"))
+        pollPeriod = config.find("pollPeriod").asFloat64();
+    if(config.check("refTimeout"))
+        refTimeout = config.find("refTimeout").asFloat64();
+    if(config.check("motionTimeout"))
+        motionTimeout = config.find("motionTimeout").asFloat64();
+    if(config.check("benchmark"))
+        benchmark = config.find("benchmark").asBool();
+    if(config.check("benchmarkSamples"))
+        benchmarkSamples = config.find("benchmarkSamples").asInt32();
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(pollPeriod>0 && refTimeout>0 && motionTimeout>0 && benchmarkSamples>0, "pollPeriod, refTimeout, motionTimeout and benchmarkSamples must be > 0");
+    latencies.reserve(benchmarkSamples);
+
 
     Property options;
     options.put("device", "remote_controlboard");
@@ -273,16 +292,26 @@ void MovementReferencesTest::run() {
                 Asserter::format(("go to target pos  for j %d"),jList[i]));
     }
 
-    yarp::os::Time::delay(5);
+    ROBOTTESTINGFRAMEWORK_TEST_CHECK(waitMotionDone(numJoints, jList), "all joints reached home");
 
     ROBOTTESTINGFRAMEWORK_TEST_REPORT("Checking individual joints...");
 
+    std::ofstream fs;
+    if(benchmark)
+    {
+        std::string filename = "movementReferencesLatency_" + partName + ".txt";
+        fs.open(filename.c_str());
+        fs << "#joint reference samples timeouts p50[ms] p90[ms] p99[ms] max[ms]" << std::endl;
+    }
+
     const double res_th = 0.01; //resolution threshold
     //numJoints=numJointsInPart;
     for (int i=0; i<numJoints; ++i)
     {
         //double reached_pos;
         double rec_targetPos=200.0;
+        double latency=0;
+        double t_set=0;
 
     // 1) check get reference position returns the target position set by positionMove(..)
 
@@ -293,22 +322,12 @@ void MovementReferencesTest::run() {
         ROBOTTESTINGFRAMEWORK_TEST_FAIL_IF_FALSE(jPosMotion->goToSingle(jList[i], targetPos[i]),
                 Asserter::format(("go to target pos  for j %d"),jList[i])); //Note: gotosingle use IPositioncontrol2::PositionMove
 
-    yarp::os::Time::delay(0.5);
-
-        ROBOTTESTINGFRAMEWORK_TEST_FAIL_IF_FALSE(iPosition->getTargetPosition(jList[i], &rec_targetPos),
-                Asserter::format(("getting target pos for j %d"),jList[i]));
-
-        bool res = yarp::robottestingframework::TestAsserter::isApproxEqual(targetPos[i], rec_targetPos, res_th, res_th);
+        bool res = waitReference(REF_POSITION, jList[i], targetPos[i], yarp::os::Time::now(), &rec_targetPos, &latency);
         ROBOTTESTINGFRAMEWORK_TEST_CHECK(res, Asserter::format(
                            ("IPositionControl: getting target pos for j %d: setval =%.2f received %.2f"),
                            jList[i], targetPos[i],rec_targetPos));
 
-        //if(!res)
-        //    std::cout <<"ERRORE: getTargetPosition: j " << jList[i] << "sent" << targetPos[i] << "rec" << rec_targetPos;
-        //else
-        //    std::cout <<"OK: getTargetPosition: j " << jList[i] << "sent" << targetPos[i] << "rec" << rec_targetPos;
-
-        yarp::os::Time::delay(3);
+        ROBOTTESTINGFRAMEWORK_TEST_CHECK(waitMotionDone(1, &jList[i]), Asserter::format(("j %d reached target pos"),jList[i]));
 
     //2) check get reference output (pwm mode) returns the ouput set by setRefOutput
         ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Checking pwm reference joint %d", jList[i]));
@@ -318,25 +337,22 @@ void MovementReferencesTest::run() {
 
         double output = 2;
         double rec_output = 0;
+        t_set = yarp::os::Time::now();
         ROBOTTESTINGFRAMEWORK_TEST_FAIL_IF_FALSE(iPWM->setRefDutyCycle(jList[i], output),
                Asserter::format(("set ref output for j %d"),jList[i]));
-yarp::os::Time::delay(0.5);
-
-        ROBOTTESTINGFRAMEWORK_TEST_FAIL_IF_FALSE(iPWM->getRefDutyCycle(jList[i], &rec_output),
-               Asserter::format(("get ref output for j %d"),jList[i]));
 
-        ROBOTTESTINGFRAMEWORK_TEST_CHECK((output == rec_output),
-               Asserter::format(("getting target output for j %d: setval =%.2f received %.2f"),jList[i], output,rec_output));
+        res = waitReference(REF_PWM, jList[i], output, t_set, &rec_output, &latency);
+        ROBOTTESTINGFRAMEWORK_TEST_CHECK(res,
+               Asserter::format(("getting target output for j %d: setval =%.2f received %.2f (%.3f ms)"),jList[i], output,rec_output, latency*1000.0));
 
+        t_set = yarp::os::Time::now();
         ROBOTTESTINGFRAMEWORK_TEST_FAIL_IF_FALSE(iPosition->positionMove(jList[i], homePos[i]),
                 Asserter::format(("go to home  for j %d"),jList[i]));
-yarp::os::Time::delay(0.5);
-        ROBOTTESTINGFRAMEWORK_TEST_FAIL_IF_FALSE(iPosition->getTargetPosition(jList[i], &rec_targetPos),
-               Asserter::format(("getting target pos for j %d"),jList[i]));
 
         //here I expect getTargetPosition returns targetPos[j] and not homePos[j] because joint is in pwm control mode and
-        //the positionMove(homepos) command should be discarded by firmware motor controller
-        res = yarp::robottestingframework::TestAsserter::isApproxEqual(homePos[i], rec_targetPos, res_th, res_th);
+        //the positionMove(homepos) command should be discarded by firmware motor controller. The whole refTimeout is waited
+        //to be sure that the command is not applied late.
+        res = waitReference(REF_POSITION, jList[i], homePos[i], t_set, &rec_targetPos, &latency);
         ROBOTTESTINGFRAMEWORK_TEST_CHECK(!res,
                Asserter::format(("joint %d discards PosotinMove command while it is in opnLoop mode. Set=%.2f rec=%.2f"),jList[i], homePos[i], rec_targetPos));
 
@@ -352,16 +368,13 @@ yarp::os::Time::delay(0.5);
 
         double delta = 0.1;
         double new_directPos = curr_pos+delta;
+        t_set = yarp::os::Time::now();
         ROBOTTESTINGFRAMEWORK_TEST_FAIL_IF_FALSE(iPosDirect->setPosition(jList[i], new_directPos),
                Asserter::format(("Direct:setPosition for j %d"),jList[i]));
-yarp::os::Time::delay(0.5);
-
-        ROBOTTESTINGFRAMEWORK_TEST_FAIL_IF_FALSE(iPosDirect->getRefPosition(jList[i], &rec_targetPos),
-               Asserter::format(("getting target pos for j %d"),jList[i]));
 
-        res = yarp::robottestingframework::TestAsserter::isApproxEqual(new_directPos, rec_targetPos, res_th, res_th);
+        res = waitReference(REF_POSITION_DIRECT, jList[i], new_directPos, t_set, &rec_targetPos, &latency);
         ROBOTTESTINGFRAMEWORK_TEST_CHECK(res,
-               Asserter::format(("iDirect: getting target direct pos for j %d: setval =%.2f received %.2f"),jList[i], new_directPos,rec_targetPos));
+               Asserter::format(("iDirect: getting target direct pos for j %d: setval =%.2f received %.2f (%.3f ms)"),jList[i], new_directPos,rec_targetPos, latency*1000.0));
 
         //here I'm going to check the position reference is not changed.
         ROBOTTESTINGFRAMEWORK_TEST_FAIL_IF_FALSE(iPosition->getTargetPosition(jList[i], &rec_targetPos),
@@ -380,15 +393,136 @@ yarp::os::Time::delay(0.5);
 
         double vel= 0.5;
         double rec_vel;
+        t_set = yarp::os::Time::now();
         ROBOTTESTINGFRAMEWORK_TEST_FAIL_IF_FALSE(iVelocity->velocityMove(jList[i], vel),
                Asserter::format(("IVelocity:velocityMove for j %d"),jList[i]));
 
-yarp::os::Time::delay(0.5);
-        ROBOTTESTINGFRAMEWORK_TEST_FAIL_IF_FALSE(iVelocity->getRefVelocity(jList[i], &rec_vel),
-               Asserter::format(("IVelocity:getting target velocity for j %d"),jList[i]));
-        res = yarp::robottestingframework::TestAsserter::isApproxEqual(vel, rec_vel, res_th, res_th);
+        res = waitReference(REF_VELOCITY, jList[i], vel, t_set, &rec_vel, &latency);
         ROBOTTESTINGFRAMEWORK_TEST_CHECK(res,
-               Asserter::format(("iVelocity: getting target vel for j %d: setval =%.2f received %.2f"),jList[i], vel,rec_vel));
+               Asserter::format(("iVelocity: getting target vel for j %d: setval =%.2f received %.2f (%.3f ms)"),jList[i], vel,rec_vel, latency*1000.0));
+
+    //5) measure the set->get latency of all the references
+        if(benchmark)
+            benchmarkJoint(i, fs);
+    }
+
+}
+
+bool MovementReferencesTest::sendReference(reference_t type, int j, double value)
+{
+    switch(type)
+    {
+        case REF_POSITION:        return iPosition->positionMove(j, value);
+        case REF_POSITION_DIRECT: return iPosDirect->setPosition(j, value);
+        case REF_VELOCITY:        return iVelocity->velocityMove(j, value);
+        case REF_PWM:             return iPWM->setRefDutyCycle(j, value);
+        default:                  return false;
     }
+}
+
+bool MovementReferencesTest::readReference(reference_t type, int j, double *value)
+{
+    switch(type)
+    {
+        case REF_POSITION:        return iPosition->getTargetPosition(j, value);
+        case REF_POSITION_DIRECT: return iPosDirect->getRefPosition(j, value);
+        case REF_VELOCITY:        return iVelocity->getRefVelocity(j, value);
+        case REF_PWM:             return iPWM->getRefDutyCycle(j, value);
+        default:                  return false;
+    }
+}
 
+bool MovementReferencesTest::waitReference(reference_t type, int j, double expected, double t_set, double *rec_value, double *latency)
+{
+    const double res_th = 0.01; //resolution threshold
+    while(1)
+    {
+        bool ok = readReference(type, j, rec_value);
+        double now = yarp::os::Time::now();
+        if(ok && yarp::robottestingframework::TestAsserter::isApproxEqual(expected, *rec_value, res_th, res_th))
+        {
+            *latency = now-t_set;
+            return true;
+        }
+        if(now-t_set > refTimeout)
+        {
+            *latency = now-t_set;
+            return false;
+        }
+        yarp::os::Time::delay(pollPeriod);
+    }
+}
+
+bool MovementReferencesTest::waitMotionDone(int n, const int *joints)
+{
+    //the motion done is polled with a period suitable for a movement, the pollPeriod is meant for the references
+    const double period = std::max(pollPeriod, 0.010);
+    double t_start = yarp::os::Time::now();
+    while(1)
+    {
+        bool done = false;
+        if(iPosition->checkMotionDone(n, joints, &done) && done)
+            return true;
+        if(yarp::os::Time::now()-t_start > motionTimeout)
+            return false;
+        yarp::os::Time::delay(period);
+    }
+}
+
+void MovementReferencesTest::benchmarkJoint(int i, std::ofstream &fs)
+{
+    const char* names[REF_NUM] = {"IPositionControl::getTargetPosition", "IPositionDirect::getRefPosition",
+                                  "IVelocityControl::getRefVelocity", "IPWMControl::getRefDutyCycle"};
+    const int modes[REF_NUM] = {VOCAB_CM_POSITION, VOCAB_CM_POSITION_DIRECT, VOCAB_CM_VELOCITY, VOCAB_CM_PWM};
+
+    for(int t=0; t<REF_NUM; t++)
+    {
+        reference_t type = (reference_t)t;
+        setAndCheckControlMode(jList[i], modes[t]);
+
+        //the two alternated values are close to the current state, so that the joint does not move significantly
+        double pos=0;
+        iEncoders->getEncoder(jList[i], &pos);
+        double values[2];
+        switch(type)
+        {
+            case REF_POSITION:        values[0]=pos+0.5; values[1]=pos;       break;
+            case REF_POSITION_DIRECT: values[0]=pos+0.1; values[1]=pos;       break;
+            case REF_VELOCITY:        values[0]=0.5;     values[1]=-0.5;      break;
+            default:                  values[0]=2;       values[1]=-2;        break;
+        }
+
+        latencies.clear();
+        int timeouts=0;
+        for(int k=0; k<benchmarkSamples; k++)
+        {
+            double rec=0, latency=0;
+            double t_set = yarp::os::Time::now();
+            if(sendReference(type, jList[i], values[k%2]) &&
+               waitReference(type, jList[i], values[k%2], t_set, &rec, &latency))
+                latencies.push_back(latency*1000.0);
+            else
+                timeouts++;
+        }
+
+        //leave the joint still
+        if(type==REF_VELOCITY) iVelocity->velocityMove(jList[i], 0.0);
+        if(type==REF_PWM)      iPWM->setRefDutyCycle(jList[i], 0.0);
+
+        ROBOTTESTINGFRAMEWORK_TEST_CHECK(timeouts==0, Asserter::format("joint %d %s: %d of %d references not returned within %.3f s",
+                                         jList[i], names[t], timeouts, benchmarkSamples, refTimeout));
+        if(latencies.empty())
+            continue;
+
+        std::sort(latencies.begin(), latencies.end());
+        size_t n = latencies.size();
+        double p50 = latencies[std::min(n-1, (size_t)ceil(0.50*n)-1)];
+        double p90 = latencies[std::min(n-1, (size_t)ceil(0.90*n)-1)];
+        double p99 = latencies[std::min(n-1, (size_t)ceil(0.99*n)-1)];
+        double max = latencies[n-1];
+        ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("joint %d %s latency [ms]: p50 %.3f p90 %.3f p99 %.3f max %.3f",
+                                          jList[i], names[t], p50, p90, p99, max));
+        fs << jList[i] << " " << names[t] << " " << n << " " << timeouts << " "
+           << p50 << " " << p90 << " " << p99 << " " << max << std::endl;
+    }
 }
@@ -21,6 +21,9 @@
 #ifndef _MOVEMENTREFERNCESTEST_
 #define _MOVEMENTREFERNCESTEST_
 
+#include <string>
+#include <vector>
+#include <fstream>
 #include <yarp/robottestingframework/TestCase.h>
 
 #include <yarp/os/Value.h>
@@ -40,6 +43,13 @@
 * \li IPositionDirect::getRefPosition()
 * \li IPWMControl::getRefDutyCycle()
 *
+* After each set command the test polls the corresponding getter every pollPeriod seconds until the new value is returned,
+* waiting at most refTimeout seconds, so the checks do not depend on fixed delays. After homing and after reaching the target position
+* the test waits for IPositionControl::checkMotionDone, at most motionTimeout seconds, before moving on.
+* With benchmark=true, for each joint the set->get visibility latency of each reference (IPositionControl::positionMove/getTargetPosition,
+* IPositionDirect::setPosition/getRefPosition, IVelocityControl::velocityMove/getRefVelocity, IPWMControl::setRefDutyCycle/getRefDutyCycle)
+* is measured benchmarkSamples times, alternating two values close to the current state, and the percentiles of the latency are
+* reported and saved in movementReferencesLatency_<part>.txt.
 *
 *  Accepts the following parameters:
 * | Parameter name | Type   | Units | Default Value | Required | Description | Notes |
@@ -51,6 +61,11 @@
 * | target         | vector of doubles of size joints | deg | - | Yes  | For each joint the position to reach for passing the test. | |
 * | refvel         | vector of doubles of size joints | deg/s | - | Yes | For each joint the reference velocity value to set in the low level trajectory generator. | |
 * | refacc         | vector of doubles of size joints | deg/s^2 | - | No | For each joint the reference acceleration value to set in the low level trajectory generator. | |
+* | pollPeriod     | double | s     | 0.001         | No       | The period of the getter polling after a set command. | |
+* | refTimeout     | double | s     | 1.0           | No       | The maximum time waited for a reference to be returned by the getter. | |
+* | motionTimeout  | double | s     | 10.0          | No       | The maximum time waited for the joints to complete a movement. | |
+* | benchmark      | bool   | -     | false         | No       | Measure the set->get latency percentiles of each reference. | |
+* | benchmarkSamples | int  | -     | 50            | No       | The number of latency measurements for each reference and joint. | |
 *
 */
 class MovementReferencesTest : public yarp::robottestingframework::TestCase {
@@ -65,7 +80,21 @@ public:
     virtual void run();
 
 private:
+    enum reference_t
+    {
+        REF_POSITION = 0,
+        REF_POSITION_DIRECT,
+        REF_VELOCITY,
+        REF_PWM,
+        REF_NUM
+    };
+
     void setAndCheckControlMode(int j, int mode);
+    bool sendReference(reference_t type, int j, double value);
+    bool readReference(reference_t type, int j, double *value);
+    bool waitReference(reference_t type, int j, double expected, double t_set, double *rec_value, double *latency);
+    bool waitMotionDone(int n, const int *joints);
+    void benchmarkJoint(int i, std::ofstream &fs);
 
 
     yarp::dev::PolyDriver *dd;
@@ -92,6 +121,13 @@ private:
     yarp::sig::Vector homePos;
     yarp::sig::Vector refVel;
     yarp::sig::Vector refAcc;
+
+    double pollPeriod;
+    double refTimeout;
+    double motionTimeout;
+    bool benchmark;
+    int benchmarkSamples;
+    std::vector<double> latencies;
     //yarp::sig::Vector timeout;
 };
 
@@ -38,7 +38,7 @@ using namespace yarp::dev;
 // prepare the plugin
 ROBOTTESTINGFRAMEWORK_PREPARE_PLUGIN(OpenLoopConsistency)
 
-OpenLoopConsistency::OpenLoopConsistency() : yarp::robottestingframework::TestCase("OpenLoopConsistency") {
+OpenLoopConsistency::OpenLoopConsistency() : ConsistencyTestCase("OpenLoopConsistency") {
     jointsList=0;
     pos_tot=0;
     dd=0;
@@ -78,6 +78,9 @@ bool OpenLoopConsistency::setup(yarp::os::Property& property) {
     n_cmd_joints = jointsBottle->size();
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(n_cmd_joints>0,"invalid number of joints, it must be >0");
 
+    if(property.check("latency_samples"))
+        latency_samples = property.find("latency_samples").asInt32();
+
     Property options;
     options.put("device", "remote_controlboard");
     options.put("remote", "/"+robotName+"/"+partName);
@@ -116,6 +119,8 @@ bool OpenLoopConsistency::setup(yarp::os::Property& property) {
     prevcurr_some=new double[n_cmd_joints];
     home=new double[n_cmd_joints];
     for (int i=0; i <n_cmd_joints; i++) jointsList[i]=jointsBottle->get(i).asInt32();
+    cmode_some.resize(n_cmd_joints);
+    imode_some.resize(n_cmd_joints);
     for (int i=0; i <n_cmd_joints; i++) home[i]=homeBottle->get(i).asFloat64();
     return true;
 }
@@ -136,32 +141,43 @@ void OpenLoopConsistency::setMode(int desired_control_mode, yarp::dev::Interacti
 {
     for (int i=0; i<n_cmd_joints; i++)
     {
-        icmd->setControlMode(jointsList[i],desired_control_mode);
-        iimd->setInteractionMode(jointsList[i],desired_interaction_mode);
-        yarp::os::Time::delay(0.010);
+        cmode_some[i]=desired_control_mode;
+        imode_some[i]=desired_interaction_mode;
     }
+    icmd->setControlModes(n_cmd_joints,jointsList,cmode_some.data());
+    iimd->setInteractionModes(n_cmd_joints,jointsList,imode_some.data());
+    yarp::os::Time::delay(0.010);
 }
 
 void OpenLoopConsistency::verifyMode(int desired_control_mode, yarp::dev::InteractionModeEnum desired_interaction_mode, std::string title)
 {
-    int cmode;
-    yarp::dev::InteractionModeEnum imode;
+    std::vector<int> cmode(n_cmd_joints);
+    std::vector<yarp::dev::InteractionModeEnum> imode(n_cmd_joints);
     int timeout = 0;
 
     while (1)
     {
+        //the modes of all the tested joints are read with one call for each interface
+        double start_time=yarp::os::Time::now();
+        icmd->getControlModes(n_cmd_joints,jointsList,cmode.data());
+        addLatency(api_multi,start_time);
+        start_time=yarp::os::Time::now();
+        iimd->getInteractionModes(n_cmd_joints,jointsList,imode.data());
+        addLatency(api_multi,start_time);
+
         int ok=0;
+        int i_wrong=0;
         for (int i=0; i<n_cmd_joints; i++)
         {
-            icmd->getControlMode (jointsList[i],&cmode);
-            iimd->getInteractionMode(jointsList[i],&imode);
-            if (cmode==desired_control_mode && imode==desired_interaction_mode) ok++;
+            if (cmode[i]==desired_control_mode && imode[i]==desired_interaction_mode) ok++;
+            else i_wrong=i;
         }
         if (ok==n_cmd_joints) break;
         if (timeout>100)
         {
+            int i=i_wrong;
             char sbuf[500];
-            sprintf(sbuf,"Test (%s) failed: current mode is (%s,%s), it should be (%s,%s)",title.c_str(), Vocab32::decode((NetInt32)desired_control_mode).c_str(),Vocab32::decode((NetInt32)desired_interaction_mode).c_str(), Vocab32::decode((NetInt32)cmode).c_str(),Vocab32::decode((NetInt32)imode).c_str());
+            sprintf(sbuf,"Test (%s) failed: current mode is (%s,%s), it should be (%s,%s)",title.c_str(), Vocab32::decode((NetInt32)desired_control_mode).c_str(),Vocab32::decode((NetInt32)desired_interaction_mode).c_str(), Vocab32::decode((NetInt32)cmode[i]).c_str(),Vocab32::decode((NetInt32)imode[i]).c_str());
             ROBOTTESTINGFRAMEWORK_ASSERT_ERROR(sbuf);
         }
         yarp::os::Time::delay(0.2);
@@ -202,11 +218,14 @@ void OpenLoopConsistency::goHome()
 void OpenLoopConsistency::setRefOpenloop(double value)
 {
     cmd_single=value;
+    double start_time;
     if (cmd_mode==single_joint)
     {
         for (int i=0; i<n_cmd_joints; i++)
         {
+            start_time=yarp::os::Time::now();
             ipwm->setRefDutyCycle(jointsList[i], cmd_single);
+            addLatency(api_single,start_time);
         }
     }
     else if (cmd_mode==some_joints)
@@ -214,7 +233,9 @@ void OpenLoopConsistency::setRefOpenloop(double value)
         //same of single_joint, since multiple joint is not currently supported
         for (int i=0; i<n_cmd_joints; i++)
         {
+            start_time=yarp::os::Time::now();
             ipwm->setRefDutyCycle(jointsList[i], cmd_single);
+            addLatency(api_single,start_time);
         }
     }
     else if (cmd_mode==all_joints)
@@ -223,7 +244,9 @@ void OpenLoopConsistency::setRefOpenloop(double value)
         {
             cmd_tot[i]=cmd_single;
         }
+        start_time=yarp::os::Time::now();
         ipwm->setRefDutyCycles(cmd_tot);
+        addLatency(api_all,start_time);
     }
     else
     {
@@ -232,203 +255,39 @@ void OpenLoopConsistency::setRefOpenloop(double value)
     yarp::os::Time::delay(0.010);
 }
 
+bool OpenLoopConsistency::getRefSingle(int j, double* ref)
+{
+    return ipwm->getRefDutyCycle(j,ref);
+}
+
+bool OpenLoopConsistency::getRefAll(double* refs)
+{
+    return ipwm->getRefDutyCycles(refs);
+}
+
 void OpenLoopConsistency::verifyRefOpenloop(double verify_val, std::string title)
 {
-    double value;
-    char sbuf[500];
-    if (cmd_mode==single_joint)
-    {
-        for (int i=0; i<n_cmd_joints; i++)
-        {
-            ipwm->getRefDutyCycle(jointsList[i], &value);
-            if (value==verify_val)
-            {
-                sprintf(sbuf,"Test (%s) passed, j%d current reference is (%f)",title.c_str(),i, verify_val);
-                ROBOTTESTINGFRAMEWORK_TEST_REPORT(sbuf);
-            }
-            else
-            {
-                sprintf(sbuf,"Test (%s) failed: current reference is (%f), it should be (%f)",title.c_str(), value, verify_val);
-                ROBOTTESTINGFRAMEWORK_ASSERT_ERROR(sbuf);
-            }
-        }
-    }
-    else if (cmd_mode==some_joints)
-    {
-        //same of single_joint, since multiple joint is not currently supported
-        for (int i=0; i<n_cmd_joints; i++)
-        {
-            ipwm->getRefDutyCycle(jointsList[i], &value);
-            if (value==verify_val)
-            {
-                sprintf(sbuf,"Test (%s) passed j%d current reference is (%f)",title.c_str(),i, verify_val);
-                ROBOTTESTINGFRAMEWORK_TEST_REPORT(sbuf);
-            }
-            else
-            {
-                sprintf(sbuf,"Test (%s) failed: current reference is (%f), it should be (%f)",title.c_str(), value, verify_val);
-                ROBOTTESTINGFRAMEWORK_ASSERT_ERROR(sbuf);
-            }
-        }
-    }
-    else if (cmd_mode==all_joints)
-    {
-        int ok=0;
-        ipwm->getRefDutyCycles(cmd_tot);
-        for (int i=0; i<n_part_joints; i++)
-        {
-            if (verify_val==cmd_tot[i]) ok++;
-        }
-        if (ok==n_part_joints)
-        {
-            sprintf(sbuf,"Test (%s) passed, current reference is (%f)",title.c_str(), verify_val);
-            ROBOTTESTINGFRAMEWORK_TEST_REPORT(sbuf);
-        }
-        else
-        {
-            sprintf(sbuf,"Test (%s) failed: only %d joints (of %d) are ok",title.c_str(),ok,n_part_joints);
-            ROBOTTESTINGFRAMEWORK_ASSERT_ERROR(sbuf);
-        }
-    }
-    else
-    {
-        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR("Invalid cmd_mode");
-    }
-    yarp::os::Time::delay(0.010);
+    //a single all-joints call is used whatever the command mode, the command mode only affects the setter
+    double start_time=yarp::os::Time::now();
+    ipwm->getRefDutyCycles(cmd_tot);
+    addLatency(api_all,start_time);
+    verifyValues(cmd_tot,(cmd_mode==all_joints) ? n_part_joints : n_cmd_joints,(cmd_mode==all_joints) ? 0 : jointsList,verify_val,true,title,"reference");
 }
 
 void OpenLoopConsistency::verifyOutputEqual(double verify_val, std::string title)
 {
-    double value;
-    char sbuf[500];
-    if (cmd_mode==single_joint)
-    {
-        for (int i=0; i<n_cmd_joints; i++)
-        {
-            ipwm->getDutyCycle(jointsList[i], &value);
-            if (value==verify_val)
-            {
-                sprintf(sbuf,"Test (%s) passed, j%d current output is (%f)",title.c_str(),i, verify_val);
-                ROBOTTESTINGFRAMEWORK_TEST_REPORT(sbuf);
-            }
-            else
-            {
-                sprintf(sbuf,"Test (%s) failed: current output is (%f), it should be (%f)",title.c_str(), value, verify_val);
-                ROBOTTESTINGFRAMEWORK_ASSERT_ERROR(sbuf);
-            }
-        }
-    }
-    else if (cmd_mode==some_joints)
-    {
-        //same of single_joint, since multiple joint is not currently supported
-        for (int i=0; i<n_cmd_joints; i++)
-        {
-            ipwm->getDutyCycle(jointsList[i], &value);
-            if (value==verify_val)
-            {
-                sprintf(sbuf,"Test (%s) passed j%d current output is (%f)",title.c_str(),i,verify_val);
-                ROBOTTESTINGFRAMEWORK_TEST_REPORT(sbuf);
-            }
-            else
-            {
-                sprintf(sbuf,"Test (%s) failed: current output is (%f), it should be (%f)",title.c_str(), value, verify_val);
-                ROBOTTESTINGFRAMEWORK_ASSERT_ERROR(sbuf);
-            }
-        }
-    }
-    else if (cmd_mode==all_joints)
-    {
-        int ok=0;
-        ipwm->getDutyCycles(cmd_tot);
-        for (int i=0; i<n_part_joints; i++)
-        {
-            if (verify_val==cmd_tot[i]) ok++;
-            else
-            {
-                ROBOTTESTINGFRAMEWORK_TEST_REPORT(robottestingframework::Asserter::format("verify_val=%.2f, read_val=%.2f j=%d",verify_val, cmd_tot[i], i ));
-            }
-        }
-        if (ok==n_part_joints)
-        {
-            sprintf(sbuf,"Test (%s) passed current output is (%f)",title.c_str(), verify_val);
-            ROBOTTESTINGFRAMEWORK_TEST_REPORT(sbuf);
-        }
-        else
-        {
-            sprintf(sbuf,"Test (%s) failed: only %d joints (of %d) are ok",title.c_str(),ok,n_part_joints);
-            ROBOTTESTINGFRAMEWORK_ASSERT_ERROR(sbuf);
-        }
-    }
-    else
-    {
-        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR("Invalid cmd_mode");
-    }
-    yarp::os::Time::delay(0.010);
+    double start_time=yarp::os::Time::now();
+    ipwm->getDutyCycles(cmd_tot);
+    addLatency(api_all,start_time);
+    verifyValues(cmd_tot,(cmd_mode==all_joints) ? n_part_joints : n_cmd_joints,(cmd_mode==all_joints) ? 0 : jointsList,verify_val,true,title,"output");
 }
 
 void OpenLoopConsistency::verifyOutputDiff(double verify_val, std::string title)
 {
-    double value;
-    char sbuf[500];
-    if (cmd_mode==single_joint)
-    {
-        for (int i=0; i<n_cmd_joints; i++)
-        {
-            ipwm->getDutyCycle(jointsList[i], &value);
-            if (value!=verify_val)
-            {
-                sprintf(sbuf,"Test (%s) passed j%d, current output is (%f!=%f)",title.c_str(),i,value,verify_val);
-                ROBOTTESTINGFRAMEWORK_TEST_REPORT(sbuf);
-            }
-            else
-            {
-                sprintf(sbuf,"Test (%s) failed: current output is (%f), it should be (%f)",title.c_str(), value, verify_val);
-                ROBOTTESTINGFRAMEWORK_ASSERT_ERROR(sbuf);
-            }
-        }
-    }
-    else if (cmd_mode==some_joints)
-    {
-        //same of single_joint, since multiple joint is not currently supported
-        for (int i=0; i<n_cmd_joints; i++)
-        {
-            ipwm->getDutyCycle(jointsList[i], &value);
-            if (value!=verify_val)
-            {
-                sprintf(sbuf,"Test (%s) passed j%d current output is (%f!=%f)",title.c_str(), i,value,verify_val);
-                ROBOTTESTINGFRAMEWORK_TEST_REPORT(sbuf);
-            }
-            else
-            {
-                sprintf(sbuf,"Test (%s) failed: current output is (%f), it should be (%f)",title.c_str(), value, verify_val);
-                ROBOTTESTINGFRAMEWORK_ASSERT_ERROR(sbuf);
-            }
-        }
-    }
-    else if (cmd_mode==all_joints)
-    {
-        int ok=0;
-        ipwm->getDutyCycles(cmd_tot);
-        for (int i=0; i<n_part_joints; i++)
-        {
-            if (verify_val!=cmd_tot[i]) ok++;
-        }
-        if (ok==n_part_joints)
-        {
-            sprintf(sbuf,"Test (%s) passed current output is (%f!=%f)",title.c_str(),value,verify_val);
-            ROBOTTESTINGFRAMEWORK_TEST_REPORT(sbuf);
-        }
-        else
-        {
-            sprintf(sbuf,"Test (%s) failed: only %d joints (of %d) are ok",title.c_str(),ok,n_part_joints);
-            ROBOTTESTINGFRAMEWORK_ASSERT_ERROR(sbuf);
-        }
-    }
-    else
-    {
-        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR("Invalid cmd_mode");
-    }
-    yarp::os::Time::delay(0.010);
+    double start_time=yarp::os::Time::now();
+    ipwm->getDutyCycles(cmd_tot);
+    addLatency(api_all,start_time);
+    verifyValues(cmd_tot,(cmd_mode==all_joints) ? n_part_joints : n_cmd_joints,(cmd_mode==all_joints) ? 0 : jointsList,verify_val,false,title,"output");
 }
 
 void OpenLoopConsistency::run()
@@ -464,4 +323,6 @@ void OpenLoopConsistency::run()
     verifyRefOpenloop(-1,"test7a");
     //verifyOutputDiff(0,"test7b"); //TO BE CHECKED
 
+    measureLatencies(icmd,n_part_joints,n_cmd_joints,jointsList,"getRefDutyCycle x joints","getRefDutyCycles(all)");
+    reportLatencies();
 }
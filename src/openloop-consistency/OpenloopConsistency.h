@@ -22,11 +22,13 @@
 #define _OPENLOOPCONSISTENCY_H_
 
 #include <string>
-#include <yarp/robottestingframework/TestCase.h>
+#include <vector>
 #include <yarp/dev/ControlBoardInterfaces.h>
 #include <yarp/dev/PolyDriver.h>
 
-class OpenLoopConsistency : public yarp::robottestingframework::TestCase {
+#include "ConsistencyTestCase.h"
+
+class OpenLoopConsistency : public ConsistencyTestCase {
 public:
     OpenLoopConsistency();
     virtual ~OpenLoopConsistency();
@@ -48,6 +50,9 @@ public:
     void verifyOutputDiff(double value, std::string title);
 
 private:
+    virtual bool getRefSingle(int j, double* ref);
+    virtual bool getRefAll(double* refs);
+
     std::string robotName;
     std::string partName;
     int* jointsList;
@@ -79,6 +84,9 @@ private:
     double* prevcurr_some;
 
     double* pos_tot;
+
+    std::vector<int> cmode_some;
+    std::vector<yarp::dev::InteractionModeEnum> imode_some;
 };
 
 #endif //_OPENLOOPCONSISTENCY_H_
@@ -41,6 +41,33 @@ using namespace yarp::math;
 // prepare the plugin
 ROBOTTESTINGFRAMEWORK_PREPARE_PLUGIN(OpticalEncodersDrift)
 
+void DriftEstimator::add(double value)
+{
+    //the samples are stored relative to the first one to keep the sums well conditioned
+    if (n==0) first=value;
+    double x=n;
+    double y=value-first;
+    sx+=x;
+    sy+=y;
+    sxx+=x*x;
+    sxy+=x*y;
+    n++;
+}
+
+double DriftEstimator::rate() const
+{
+    if (n<2) return 0;
+    double den=n*sxx-sx*sx;
+    if (den==0) return 0;
+    return (n*sxy-sx*sy)/den;
+}
+
+double DriftEstimator::offset() const
+{
+    if (n==0) return 0;
+    return first+(sy-rate()*sx)/n;
+}
+
 OpticalEncodersDrift::OpticalEncodersDrift() : yarp::robottestingframework::TestCase("OpticalEncodersDrift") {
     jointsList=0;
     dd=0;
@@ -55,6 +82,11 @@ OpticalEncodersDrift::OpticalEncodersDrift() : yarp::robottestingframework::Test
     end_enc_mot=0;
     err_enc_mot=0;
     cycles=100;
+    chunk_size=1000;
+    chunk_rows=0;
+    max_drift_rate=0;
+    min_drift_samples=10;
+    prev_valid=false;
 }
 
 OpticalEncodersDrift::~OpticalEncodersDrift() { }
@@ -101,6 +133,19 @@ bool OpticalEncodersDrift::setup(yarp::os::Property& property) {
 
     plot = property.find("plot_enabled").asBool();
 
+    //optional parameters
+    if (property.check("chunk_size"))
+    {chunk_size = property.find("chunk_size").asInt32();}
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(chunk_size>0,"invalid chunk_size");
+
+    if (property.check("max_drift_rate"))
+    {max_drift_rate = property.find("max_drift_rate").asFloat64();}
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(max_drift_rate>=0,"invalid max_drift_rate");
+
+    if (property.check("min_drift_samples"))
+    {min_drift_samples = property.find("min_drift_samples").asInt32();}
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(min_drift_samples>=2,"invalid min_drift_samples, it must be >=2");
+
     if(plot)
         ROBOTTESTINGFRAMEWORK_TEST_REPORT("This test will run gnuplot utility at the end.");
     else
@@ -141,11 +186,17 @@ bool OpticalEncodersDrift::setup(yarp::os::Property& property) {
     home.resize (n_cmd_joints); for (int i=0; i< n_cmd_joints; i++) home[i]=homeBottle->get(i).asFloat64();
     speed.resize(n_cmd_joints); for (int i=0; i< n_cmd_joints; i++) speed[i]=speedBottle->get(i).asFloat64();
 
+    chunk.resize(chunk_size*2*n_cmd_joints);
+    prev_jnt.resize(n_cmd_joints);
+    prev_mot.resize(n_cmd_joints);
+    drift.resize(n_cmd_joints);
+
     return true;
 }
 
 void OpticalEncodersDrift::tearDown()
 {
+    if (dataFile.is_open()) dataFile.close();
     if (dd) {delete dd; dd =0;}
 }
 
@@ -211,20 +262,62 @@ bool OpticalEncodersDrift::goHome()
     return true;
 }
 
-void OpticalEncodersDrift::saveToFile(std::string filename, yarp::os::Bottle &b)
+void OpticalEncodersDrift::openDataFile(std::string filename)
+{
+    if (dataFile.is_open()) dataFile.close();
+    dataFile.open (filename.c_str(), std::fstream::out | std::fstream::trunc);
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dataFile.is_open(), Asserter::format("Unable to open data file %s", filename.c_str()));
+    chunk_rows=0;
+}
+
+void OpticalEncodersDrift::appendSample(const yarp::sig::Vector &mot, const yarp::sig::Vector &jnt)
 {
-    std::fstream fs;
-    fs.open (filename.c_str(), std::fstream::out);
+    //this is the output format: n values for the motor encoders, then n values for the jnt encoders
+    size_t n = jointsList.size();
+    double* row = chunk.data() + chunk_rows*2*n;
+    for (size_t i=0; i<n; i++)
+    {
+        row[i]   = mot[i];
+        row[n+i] = jnt[i];
+    }
+    chunk_rows++;
+    if (chunk_rows>=chunk_size) flushDataFile();
+}
 
-    for (unsigned int i=0; i<b.size(); i++)
+void OpticalEncodersDrift::flushDataFile()
+{
+    size_t n = 2*jointsList.size();
+    for (int r=0; r<chunk_rows; r++)
     {
-        std::string s = b.get(i).toString();
-        std::replace(s.begin(), s.end(), '(', ' ');
-        std::replace(s.begin(), s.end(), ')', ' ');
-        fs << s << std::endl;
+        const double* row = chunk.data() + r*n;
+        for (size_t i=0; i<n; i++)
+        {
+            if (i>0) dataFile << ' ';
+            dataFile << row[i];
+        }
+        dataFile << '\n';
     }
+    dataFile.flush();
+    chunk_rows=0;
+}
 
-    fs.close();
+void OpticalEncodersDrift::updateDriftEstimate(const yarp::sig::Vector &mot, const yarp::sig::Vector &jnt)
+{
+    if (prev_valid)
+    {
+        for (size_t i=0; i<jointsList.size(); i++)
+        {
+            //only the crossings towards max are used, to keep backlash out of the estimate
+            if (prev_jnt[i] < home[i] && jnt[i] >= home[i])
+            {
+                double alpha = (home[i]-prev_jnt[i])/(jnt[i]-prev_jnt[i]);
+                drift[i].add(prev_mot[i]+alpha*(mot[i]-prev_mot[i]));
+            }
+        }
+    }
+    prev_jnt = jnt;
+    prev_mot = mot;
+    prev_valid = true;
 }
 
 void OpticalEncodersDrift::run()
@@ -240,7 +333,18 @@ void OpticalEncodersDrift::run()
 
     int  curr_cycle=0;
     double start_time = yarp::os::Time::now();
-    Bottle dataToPlot;
+
+    std::string filename = "encDrift_plot_";
+    filename += partName;
+    filename += ".txt";
+    openDataFile(filename);
+
+    for (size_t i =0; i< drift.size(); i++) drift[i].reset();
+    prev_valid = false;
+    bool drift_exceeded = false;
+
+    yarp::sig::Vector enc_jnt_of_interest (jointsList.size());
+    yarp::sig::Vector enc_mot_of_interest (jointsList.size());
 
     imot->getMotorEncoders             (home_enc_mot.data());
     while(1)
@@ -252,21 +356,28 @@ void OpticalEncodersDrift::run()
         ienc->getEncoders                  (enc_jnt.data());
         imot->getMotorEncoders             (enc_mot.data());
         //extract only the joints of interest
-        yarp::sig::Vector enc_jnt_of_interest (jointsList.size());
-        yarp::sig::Vector enc_mot_of_interest (jointsList.size());
         for (size_t i =0; i< jointsList.size(); i++)
         {
             enc_jnt_of_interest[i] = enc_jnt[jointsList[i]];
             enc_mot_of_interest[i] = enc_mot[jointsList[i]];
         }
-        //put the data into a Bottle
-        //this is the output format: n values for the motor encoders, then n values for the jnt encoders
-        Bottle& row = dataToPlot.addList();
-        Bottle& b_mot = row.addList();
-        Bottle& b_jnt = row.addList();
-        b_mot.read(enc_mot_of_interest);
-        b_jnt.read(enc_jnt_of_interest);
-       
+        appendSample(enc_mot_of_interest, enc_jnt_of_interest);
+
+        updateDriftEstimate(enc_mot_of_interest, enc_jnt_of_interest);
+        if (max_drift_rate > 0)
+        {
+            for (size_t i =0; i< jointsList.size(); i++)
+            {
+                if (drift[i].samples() >= min_drift_samples && fabs(drift[i].rate()) > max_drift_rate)
+                {
+                    ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Joint %d: drift rate %f exceeds %f after %d home crossings, stopping the test",
+                                                                        (int)jointsList[i], drift[i].rate(), max_drift_rate, drift[i].samples()));
+                    drift_exceeded = true;
+                }
+            }
+            if (drift_exceeded) break;
+        }
+
         bool reached= false;
         int in_position=0;
         for (unsigned int i=0; i<jointsList.size(); i++)
@@ -274,7 +385,7 @@ void OpticalEncodersDrift::run()
             double curr_val=0;
             if (go_to_max==false) curr_val = min[i];
             else                  curr_val = max[i];
-            if (fabs(enc_jnt[i]-curr_val)<tolerance) in_position++;
+            if (fabs(enc_jnt_of_interest[i]-curr_val)<tolerance) in_position++;
         }
         if (in_position==jointsList.size()) reached=true;
 
@@ -288,7 +399,7 @@ void OpticalEncodersDrift::run()
             if (go_to_max==false)
             {
                 for (unsigned int i=0; i<jointsList.size(); i++)
-                    ipos->positionMove(i,max[i]);
+                    ipos->positionMove((int)jointsList[i],max[i]);
                 go_to_max=true;
                 curr_cycle++;
                 start_time = yarp::os::Time::now();
@@ -297,7 +408,7 @@ void OpticalEncodersDrift::run()
             else
             {
                 for (unsigned int i=0; i<jointsList.size(); i++)
-                    ipos->positionMove(i,min[i]);
+                    ipos->positionMove((int)jointsList[i],min[i]);
                 go_to_max=false;
                 curr_cycle++;
                 start_time = yarp::os::Time::now();
@@ -310,6 +421,9 @@ void OpticalEncodersDrift::run()
         yarp::os::Time::delay(0.010);
     }
 
+    flushDataFile();
+    dataFile.close();
+
     bool isInHome = goHome();
     yarp::os::Time::delay(2.0);
 
@@ -328,12 +442,13 @@ void OpticalEncodersDrift::run()
     }
 
 
-    std::string filename = "encDrift_plot_";
-    filename += partName;
-    filename += ".txt";
+    for (size_t i =0; i< jointsList.size(); i++)
+    {
+        ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Joint %d: %d home crossings, motor encoder offset %f, drift rate %f per cycle",
+                                                            (int)jointsList[i], drift[i].samples(), drift[i].offset(), drift[i].rate()));
+    }
 
     int num_j = jointsList.size();
-    saveToFile(filename,dataToPlot);
 
     char plotstring[1000];
     //gnuplot -e "unset key; plot for [col=1:6] 'C:\software\icub-tests\build\plugins\Debug\plot.txt' using col with lines" -persist
@@ -349,6 +464,7 @@ void OpticalEncodersDrift::run()
         ROBOTTESTINGFRAMEWORK_TEST_REPORT(robottestingframework::Asserter::format("%s", plotstring));
     }
 
+    ROBOTTESTINGFRAMEWORK_TEST_FAIL_IF_FALSE(!drift_exceeded, "The drift rate of the motor encoders exceeds max_drift_rate");
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(isInHome, "This part is not in home. Suite test will be terminated!");
 
 }
@@ -22,6 +22,8 @@
 #define _OPTICALENCODERSDRIFT_H_
 
 #include <string>
+#include <fstream>
+#include <vector>
 #include <yarp/robottestingframework/TestCase.h>
 #include <yarp/dev/ControlBoardInterfaces.h>
 #include <yarp/dev/PolyDriver.h>
@@ -35,6 +37,10 @@
 * The test collects data during the joint motion, saves data to a text file a plots the result. If the relative encoder is working correctly, the plot should have no drift.
 * Otherwise, a drift in the plot may be caused by a damaged reflective encoder/ optical disk.
 * For best reliability an high number of cycles (e.g. >100) is suggested.
+* Samples are streamed to the data file in chunks of chunk_size rows, so the memory used by the test does not depend on the number of cycles.
+* Every time a joint crosses its home position while moving towards max, the motor encoder value at the crossing is interpolated
+* and used to update an online least-squares estimate of the drift (motor encoder offset per cycle).
+* If max_drift_rate is given, the test stops and fails as soon as the estimated drift rate of a joint exceeds it.
 
 * example: testRunner -v -t OpticalEncodersDrift.dll -p "--robot icub --part head --joints ""(0 1 2)"" --home ""(0 0 0)" --speed "(20 20 20)" --max "(10 10 10)" --min "(-10 -10 -10)" --cycles 100 --tolerance 1.0 "
 * example: testRunner -v -t OpticalEncodersDrift.dll -p "--robot icub --part head --joints ""(2)""     --home ""(0)""    --speed "(20      )" --max "(10      )" --min "(-10)"         --cycles 100 --tolerance 1.0 "
@@ -55,10 +61,33 @@
 * | min                | vector of doubles of size joints  | deg   | - | Yes | The min position using during the joint movement | |
 * | tolerance          | vector of doubles of size joints  | deg   | - | Yes | The tolerance used when moving from min to max reference position and viceversa | |
 * | speed              | vector of doubles of size joints  | deg/s | - | Yes | The reference speed used during the movement  | |
+* | plot_enabled       | bool   | -     | false         | No       | If true, gnuplot is launched at the end of the test | |
+* | chunk_size         | int    | -     | 1000          | No       | The number of samples kept in memory before being appended to the data file | |
+* | max_drift_rate     | double | deg/cycle | 0         | No       | The maximum allowed drift of the motor encoder at the home crossing, per cycle | 0 disables the check |
+* | min_drift_samples  | int    | -     | 10            | No       | The number of home crossings required before the drift rate is checked | |
 
 *
 */
 
+class DriftEstimator
+{
+    public:
+    DriftEstimator() {reset();}
+    void   reset() {n=0; sx=0; sy=0; sxx=0; sxy=0; first=0;}
+    void   add(double value);
+    double rate() const;
+    double offset() const;
+    int    samples() const {return n;}
+
+    private:
+    int    n;
+    double sx;
+    double sy;
+    double sxx;
+    double sxy;
+    double first;
+};
+
 class OpticalEncodersDrift : public yarp::robottestingframework::TestCase {
 public:
     OpticalEncodersDrift();
@@ -72,7 +101,10 @@ public:
 
     bool goHome();
     void setMode(int desired_mode);
-    void saveToFile(std::string filename, yarp::os::Bottle &b);
+    void openDataFile(std::string filename);
+    void appendSample(const yarp::sig::Vector &mot, const yarp::sig::Vector &jnt);
+    void flushDataFile();
+    void updateDriftEstimate(const yarp::sig::Vector &mot, const yarp::sig::Vector &jnt);
 
 private:
     std::string robotName;
@@ -103,6 +135,18 @@ private:
     yarp::sig::Vector speed;
 
     bool plot; //if true, the test runs gnuplot utility at end of test.
+
+    int    chunk_size;
+    int    chunk_rows;
+    yarp::sig::Vector chunk;
+    std::fstream dataFile;
+
+    double max_drift_rate;
+    int    min_drift_samples;
+    yarp::sig::Vector prev_jnt;
+    yarp::sig::Vector prev_mot;
+    bool   prev_valid;
+    std::vector<DriftEstimator> drift;
 };
 
 #endif //_opticalEncodersDRIFT_H
@@ -27,6 +27,11 @@
 #include <fstream>
 #include <algorithm>
 #include <cstdlib>
+#include <cmath>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 #include "PositionControlAccuracyExternalPid.h"
 
@@ -37,6 +42,119 @@ using namespace yarp::dev;
 // prepare the plugin
 ROBOTTESTINGFRAMEWORK_PREPARE_PLUGIN(PositionControlAccuracyExernalPid)
 
+ExternalPidLoop::ExternalPidLoop(double period) : PeriodicThread(period),
+    m_ienc(0), m_ipwm(0), m_pid(0), m_joint(0), m_zero(0), m_step(0), m_step_duration(0),
+    m_vup(0), m_vdown(0), m_start_time(0), m_prev_time(0), m_time_zero(0), m_affinity_set(false), m_done(false)
+{
+}
+
+void ExternalPidLoop::configure(IEncodersTimed* ienc, IPWMControl* ipwm, iCub::ctrl::parallelPID* pid,
+                                int n_part_joints, int joint, double zero, double step, double step_duration,
+                                double vup, double vdown, const std::vector<int>& cpus)
+{
+    m_ienc = ienc;
+    m_ipwm = ipwm;
+    m_pid = pid;
+    m_joint = joint;
+    m_zero = zero;
+    m_step = step;
+    m_step_duration = step_duration;
+    m_vup = vup;
+    m_vdown = vdown;
+    m_cpus = cpus;
+    m_encoders.assign(n_part_joints, 0.0);
+    m_stamps.assign(n_part_joints, 0.0);
+
+    //the buffers are allocated here, so that the loop does not allocate memory
+    size_t n_samples = (size_t)(step_duration/getPeriod())+100;
+    std::vector<double>* buffers[] = {&time, &pos, &ref, &pwm, &period, &compute, &encoder_age};
+    for (auto b : buffers)
+    {
+        b->clear();
+        b->reserve(n_samples);
+    }
+}
+
+bool ExternalPidLoop::threadInit()
+{
+    m_start_time = 0;
+    m_prev_time = 0;
+    m_time_zero = 0;
+    m_done = false;
+    m_affinity_set = false;
+
+#if defined(__linux__)
+    if (!m_cpus.empty())
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (size_t i = 0; i < m_cpus.size(); i++) CPU_SET(m_cpus[i], &set);
+        m_affinity_set = (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0);
+        if (!m_affinity_set) yWarning() << "Unable to set the CPU affinity of the pid thread";
+    }
+#else
+    if (!m_cpus.empty()) yWarning() << "The CPU affinity of the pid thread is supported only on Linux";
+#endif
+    return true;
+}
+
+void ExternalPidLoop::run()
+{
+    if (m_done) return;
+
+    double now = yarp::os::Time::now();
+    if (m_start_time == 0)
+    {
+        m_start_time = now;
+        m_prev_time = now;
+    }
+    double elapsed = now - m_start_time;
+
+    double reference;
+    if (elapsed <= 1.0)
+    {
+        reference = m_zero;
+    }
+    else if (elapsed <= m_step_duration)
+    {
+        reference = m_zero + m_step;
+        if (m_time_zero == 0) m_time_zero = elapsed;
+    }
+    else
+    {
+        m_done = true;
+        return;
+    }
+
+    //pid computation
+    m_ienc->getEncodersTimed(m_encoders.data(), m_stamps.data());
+    double age = yarp::os::Time::now() - m_stamps[m_joint];
+    double encoder = m_encoders[m_joint];
+    double cmd = m_pid->compute(yarp::sig::Vector(1, reference), yarp::sig::Vector(1, encoder))[0];
+
+    //stiction compensation
+    if (reference > encoder)
+    {
+        cmd += m_vup;
+    }
+    else
+    {
+        cmd += m_vdown;
+    }
+
+    //control
+    m_ipwm->setRefDutyCycle(m_joint, cmd);
+
+    time.push_back(elapsed);
+    pos.push_back(encoder);
+    ref.push_back(reference);
+    pwm.push_back(cmd);
+    period.push_back(now - m_prev_time);
+    compute.push_back(yarp::os::Time::now() - now);
+    encoder_age.push_back(age);
+    m_prev_time = now;
+}
+
 PositionControlAccuracyExernalPid::PositionControlAccuracyExernalPid() : yarp::robottestingframework::TestCase("PositionControlAccuracyExernalPid") {
     m_jointsList = 0;
     m_encoders = 0;
@@ -52,6 +170,10 @@ PositionControlAccuracyExernalPid::PositionControlAccuracyExernalPid() : yarp::r
     m_step_duration=4;
     m_pospid_vup=0;
     m_pospid_vdown=0;
+    ienct=0;
+    m_settling_band=0.05;
+    m_thread_priority=-1;
+    m_thread_policy=1;
 }
 
 PositionControlAccuracyExernalPid::~PositionControlAccuracyExernalPid() { }
@@ -81,6 +203,18 @@ bool PositionControlAccuracyExernalPid::setup(yarp::os::Property& property) {
       {m_pospid_vup = property.find("pid_vup").asFloat64();}
     if(property.check("pid_vdown"))
       {m_pospid_vdown = property.find("pid_vdown").asFloat64();}
+    if(property.check("settling_band"))
+      {m_settling_band = property.find("settling_band").asFloat64();}
+    if(property.check("thread_priority"))
+      {m_thread_priority = property.find("thread_priority").asInt32();}
+    if(property.check("thread_policy"))
+      {m_thread_policy = property.find("thread_policy").asInt32();}
+    if(property.check("cpu_affinity"))
+    {
+        Bottle* cpusBottle = property.find("cpu_affinity").asList();
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(cpusBottle!=0,"unable to parse cpu_affinity parameter");
+        for (size_t i = 0; i < cpusBottle->size(); i++) m_cpus.push_back(cpusBottle->get(i).asInt32());
+    }
 
     m_robotName = property.find("robot").asString();
     m_partName = property.find("part").asString();
@@ -99,6 +233,8 @@ bool PositionControlAccuracyExernalPid::setup(yarp::os::Property& property) {
 
     m_sampleTime = property.find("sampleTime").asFloat64();
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(m_sampleTime>0, "invalid sampleTime");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(m_step!=0, "invalid step");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(m_step_duration>1.0, "invalid step_duration, it must be >1s");
 
     Property options;
     options.put("device", "remote_controlboard");
@@ -109,6 +245,7 @@ bool PositionControlAccuracyExernalPid::setup(yarp::os::Property& property) {
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->isValid(),"Unable to open device driver");
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(idir),"Unable to open position direct interface");
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(ienc),"Unable to open encoders interface");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(ienct),"Unable to open timed encoders interface");
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(ipos),"Unable to open position interface");
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(icmd),"Unable to open control mode interface");
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(iimd),"Unable to open interaction mode interface");
@@ -244,10 +381,93 @@ bool PositionControlAccuracyExernalPid::goHome()
     return true;
 }
 
+PositionControlAccuracyExernalPid::stepResponse PositionControlAccuracyExernalPid::computeStepResponse(const ExternalPidLoop& loop, double zero)
+{
+    stepResponse r;
+    r.rise_time = std::nan("");
+    r.settling_time = std::nan("");
+    r.response_delay = std::nan("");
+    r.overshoot = 0;
+    r.steady_state_error = 0;
+
+    double time_zero = loop.timeZero();
+    double t10 = std::nan("");
+    double t90 = std::nan("");
+    double last_outside = time_zero;
+    double y_max = 0;
+    double end_time = loop.time.empty() ? time_zero : loop.time.back();
+    double err_sum = 0;
+    int    err_n = 0;
+
+    for (size_t k = 0; k < loop.time.size(); k++)
+    {
+        double t = loop.time[k];
+        if (t < time_zero) continue;
+
+        // position normalized with respect to the step, so that also negative steps are handled
+        double y = (loop.pos[k] - zero) / m_step;
+        if (std::isnan(r.response_delay) && y >= 0.05) r.response_delay = t - time_zero;
+        if (std::isnan(t10) && y >= 0.1) t10 = t;
+        if (std::isnan(t90) && y >= 0.9) t90 = t;
+        if (y > y_max) y_max = y;
+        if (fabs(y - 1.0) > m_settling_band) last_outside = t;
+
+        if (t >= end_time - 0.2 * (end_time - time_zero))
+        {
+            err_sum += loop.ref[k] - loop.pos[k];
+            err_n++;
+        }
+    }
+
+    if (!std::isnan(t10) && !std::isnan(t90)) r.rise_time = t90 - t10;
+    r.overshoot = std::max(0.0, (y_max - 1.0) * 100.0);
+    if (last_outside < end_time) r.settling_time = last_outside - time_zero;
+    if (err_n > 0) r.steady_state_error = err_sum / err_n;
+    return r;
+}
+
+void PositionControlAccuracyExernalPid::reportTiming(const ExternalPidLoop& loop)
+{
+    //the first period is not significant, the loop measures it from its own first tick
+    double p_sum = 0, p_sq = 0, p_max = 0, c_sum = 0, c_max = 0, a_sum = 0, a_max = 0;
+    int overruns = 0;
+    size_t n = loop.period.size();
+    for (size_t k = 1; k < n; k++)
+    {
+        p_sum += loop.period[k];
+        p_sq += loop.period[k] * loop.period[k];
+        p_max = std::max(p_max, loop.period[k]);
+        if (loop.period[k] > 1.5 * m_sampleTime) overruns++;
+    }
+    for (size_t k = 0; k < n; k++)
+    {
+        c_sum += loop.compute[k];
+        c_max = std::max(c_max, loop.compute[k]);
+        a_sum += loop.encoder_age[k];
+        a_max = std::max(a_max, loop.encoder_age[k]);
+    }
+    double p_mean = (n > 1) ? p_sum / (n - 1) : 0;
+    double p_std = (n > 1) ? sqrt(std::max(0.0, p_sq / (n - 1) - p_mean * p_mean)) : 0;
+
+    ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("period %.3f+-%.3f ms (max %.3f ms, %d overruns), compute time %.3f ms (max %.3f ms), encoder age %.3f ms (max %.3f ms)",
+                                                       p_mean * 1000, p_std * 1000, p_max * 1000, overruns,
+                                                       (n > 0) ? c_sum / n * 1000 : 0, c_max * 1000,
+                                                       (n > 0) ? a_sum / n * 1000 : 0, a_max * 1000));
+}
+
 void PositionControlAccuracyExernalPid::run()
 {
+    ExternalPidLoop loop(m_sampleTime);
+    if (m_thread_priority >= 0)
+    {
+        loop.setPriority(m_thread_priority, m_thread_policy);
+    }
+
     for (int i = 0; i < m_n_cmd_joints; i++)
     {
+        std::vector<stepResponse> responses;
+        m_dataToSave.clear();
+
         for (int cycle = 0; cycle < m_cycles; cycle++)
         {
             setMode(VOCAB_CM_POSITION);
@@ -259,7 +479,6 @@ void PositionControlAccuracyExernalPid::run()
             ppid->reset(yarp::sig::Vector(1,0.0));
 
             setMode(VOCAB_CM_PWM);
-            double start_time = yarp::os::Time::now();
 
             char cbuff[64];
             sprintf(cbuff, "Testing Joint: %d cycle: %d", i, cycle);
@@ -267,75 +486,61 @@ void PositionControlAccuracyExernalPid::run()
             std::string buff(cbuff);
             ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
 
-            double time_zero = 0;
-            yarp::os::Bottle      dataToPlotRaw;
-            yarp::os::Bottle      dataToPlotSync;
-            ienc->getEncoders(m_encoders);
-
-            while (1)
+            loop.configure(ienct, ipwm, ppid, m_n_part_joints, m_jointsList[i], m_zeros[i], m_step, m_step_duration,
+                           m_pospid_vup, m_pospid_vdown, m_cpus);
+            ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(loop.start(), "Unable to start the pid thread");
+            while (!loop.isDone())
             {
-                double curr_time = yarp::os::Time::now();
-                double elapsed = curr_time - start_time;
-                double ref=0;
-                if (elapsed <= 1.0)
-                {
-                    ref=m_zeros[i];
-                }
-                else if (elapsed > 1.0 && elapsed <= m_step_duration)
-                {
-                    ref=m_zeros[i]+m_step;
-                    if (time_zero == 0) time_zero = elapsed;
-                }
-                else
-                {
-                    break;
-                }
-
-                //pid computation
-                ienc->getEncoders(m_encoders);
-                m_cmd_single = ppid->compute(yarp::sig::Vector(1,ref),yarp::sig::Vector(1,m_encoders[m_jointsList[i]]))[0];
-
-                //stiction compensation
-                if (ref>m_encoders[m_jointsList[i]])
-                {
-                    m_cmd_single+=m_pospid_vup;
-                }
-                else
-                {
-                    m_cmd_single+=m_pospid_vdown;
-                }
-
-                //control
-                ipwm->setRefDutyCycle(m_jointsList[i], m_cmd_single);
-
-                Bottle& b1 = dataToPlotRaw.addList();
-                b1.addInt32(cycle);
-                b1.addFloat64(elapsed);
-                b1.addFloat64(m_encoders[m_jointsList[i]]);
-                b1.addFloat64(ref);
-                b1.addFloat64(m_cmd_single);
-                yarp::os::Time::delay(m_sampleTime);
+                yarp::os::Time::delay(0.05);
+            }
+            loop.stop();
+            if (!m_cpus.empty() && cycle == 0)
+            {
+                ROBOTTESTINGFRAMEWORK_TEST_CHECK(loop.affinitySet(), "CPU affinity of the pid thread");
             }
 
-            //reorder data
-            for (int t = 0; t < dataToPlotRaw.size(); t++)
+            stepResponse r = computeStepResponse(loop, m_zeros[i]);
+            responses.push_back(r);
+            ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("rise time %.3f s, overshoot %.2f %%, settling time %.3f s, steady state error %.4f deg, response delay %.1f ms",
+                                                               r.rise_time, r.overshoot, r.settling_time, r.steady_state_error, r.response_delay * 1000));
+            reportTiming(loop);
+
+            //time is saved with respect to the instant of the step
+            double time_zero = loop.timeZero();
+            for (size_t k = 0; k < loop.time.size(); k++)
             {
-                int    cycle = dataToPlotRaw.get(t).asList()->get(0).asInt32();
-                double time = dataToPlotRaw.get(t).asList()->get(1).asFloat64();
-                double val = dataToPlotRaw.get(t).asList()->get(2).asFloat64();
-                double cmd = dataToPlotRaw.get(t).asList()->get(3).asFloat64();
-                double duty = dataToPlotRaw.get(t).asList()->get(4).asFloat64();
-                Bottle& b1 = dataToPlotSync.addList();
+                Bottle& b1 = m_dataToSave.addList();
                 b1.addInt32(cycle);
-                b1.addFloat64(time - time_zero);
-                b1.addFloat64(val);
-                b1.addFloat64(cmd);
-                b1.addFloat64(duty);
+                b1.addFloat64(loop.time[k] - time_zero);
+                b1.addFloat64(loop.pos[k]);
+                b1.addFloat64(loop.ref[k]);
+                b1.addFloat64(loop.pwm[k]);
+                b1.addFloat64(loop.period[k]);
+                b1.addFloat64(loop.compute[k]);
+                b1.addFloat64(loop.encoder_age[k]);
             }
-
-            m_dataToSave.append(dataToPlotSync);
         } //cycle loop
 
+        //mean and standard deviation across the cycles, the cycles where a quantity is not defined are skipped
+        const char* names[5] = {"rise time [s]", "overshoot [%]", "settling time [s]", "steady state error [deg]", "response delay [s]"};
+        for (int q = 0; q < 5; q++)
+        {
+            double sum = 0, sq = 0;
+            int n = 0;
+            for (size_t c = 0; c < responses.size(); c++)
+            {
+                double v[5] = {responses[c].rise_time, responses[c].overshoot, responses[c].settling_time,
+                               fabs(responses[c].steady_state_error), responses[c].response_delay};
+                if (std::isnan(v[q])) continue;
+                sum += v[q];
+                sq += v[q] * v[q];
+                n++;
+            }
+            double mean = (n > 0) ? sum / n : std::nan("");
+            double std_dev = (n > 0) ? sqrt(std::max(0.0, sq / n - mean * mean)) : std::nan("");
+            ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Joint %d %s: %.4f+-%.4f (%d/%d cycles)", m_jointsList[i], names[q], mean, std_dev, n, (int)responses.size()));
+        }
+
         //save data
         std::string filename;
         if (m_requested_filename=="")
@@ -343,40 +548,26 @@ void PositionControlAccuracyExernalPid::run()
             char cfilename[128];
             sprintf(cfilename, "positionControlAccuracyExternalPid_plot_%s%d.txt", m_partName.c_str(), i);
             filename = cfilename;
-            //filename += m_partName;
-            //filename += std::to_string(i);
-            //filename += ".txt";
         }
         else
         {
             filename=m_requested_filename;
         }
         yInfo() << "Saving file to: "<< filename;
-        saveToFile(filename, m_dataToSave);
+        //a single requested file collects all the joints
+        saveToFile(filename, m_dataToSave, m_requested_filename != "" && i > 0);
     } //joint loop
 
     //data acquisition ends here
     setMode(VOCAB_CM_POSITION);
     goHome();
     ROBOTTESTINGFRAMEWORK_TEST_REPORT("Data acquisition complete");
-
-    //plot data
-    /*for (int i = 0; i < m_n_cmd_joints; i++)
-    {
-        std::string filename = "positionControlAccuracy_plot_";
-        filename += m_partName;
-        filename += std::to_string(i);
-        filename += ".txt";
-        char plotstring[1000];
-        sprintf(plotstring, "gnuplot -e \" unset key; plot for [col=1:%d] '%s' using col with lines \" -persist", m_n_cmd_joints, filename.c_str());
-        system(plotstring);
-    }*/
 }
 
-void PositionControlAccuracyExernalPid::saveToFile(std::string filename, yarp::os::Bottle &b)
+void PositionControlAccuracyExernalPid::saveToFile(std::string filename, yarp::os::Bottle &b, bool append)
 {
     std::fstream fs;
-    fs.open(filename.c_str(), std::fstream::out);
+    fs.open(filename.c_str(), append ? (std::fstream::out | std::fstream::app) : std::fstream::out);
 
     for (int i = 0; i<b.size(); i++)
     {
@@ -21,19 +21,75 @@
 #ifndef _POSITIONACCURACYEXTERNALPID_H_
 #define _POSITIONACCURACYEXTERNALPID_H_
 
+#include <atomic>
 #include <string>
+#include <vector>
+#include <yarp/os/PeriodicThread.h>
 #include <yarp/robottestingframework/TestCase.h>
 #include <yarp/dev/ControlBoardInterfaces.h>
 #include <yarp/dev/PolyDriver.h>
 //#include <iCub/ctrl/math.h>
 #include <iCub/ctrl/pids.h>
 
+/**
+* The external position loop. It runs on its own periodic thread, optionally with a real time priority and a CPU affinity, for the
+* duration of one step cycle, and for each tick it records the samples of the step response together with the actual period,
+* the computation time (encoder reading, pid computation and pwm command) and the age of the encoder sample used by the pid.
+*/
+class ExternalPidLoop : public yarp::os::PeriodicThread
+{
+public:
+    ExternalPidLoop(double period);
+
+    void configure(yarp::dev::IEncodersTimed* ienc, yarp::dev::IPWMControl* ipwm, iCub::ctrl::parallelPID* pid,
+                   int n_part_joints, int joint, double zero, double step, double step_duration,
+                   double vup, double vdown, const std::vector<int>& cpus);
+    bool isDone() const { return m_done; }
+    double timeZero() const { return m_time_zero; }
+    bool affinitySet() const { return m_affinity_set; }
+
+    bool threadInit() override;
+    void run() override;
+
+    std::vector<double> time;
+    std::vector<double> pos;
+    std::vector<double> ref;
+    std::vector<double> pwm;
+    std::vector<double> period;
+    std::vector<double> compute;
+    std::vector<double> encoder_age;
+
+private:
+    yarp::dev::IEncodersTimed*  m_ienc;
+    yarp::dev::IPWMControl*     m_ipwm;
+    iCub::ctrl::parallelPID*    m_pid;
+    std::vector<double>         m_encoders;
+    std::vector<double>         m_stamps;
+    std::vector<int>            m_cpus;
+    int    m_joint;
+    double m_zero;
+    double m_step;
+    double m_step_duration;
+    double m_vup;
+    double m_vdown;
+    double m_start_time;
+    double m_prev_time;
+    std::atomic<double> m_time_zero;
+    bool   m_affinity_set;
+    std::atomic<bool> m_done;
+};
+
 /**
 * \ingroup icub-tests
 * This tests checks the response of the system to a position step, sending directly PWM commands to a joint.
 * The PWM commands are computed using iCub::ctrl::parallelPID class.
-* This test currently does not return any error report. It simply moves a joint, and saves data to a different file for each joint.
-* The data acquired can be analyzed with a Matlab script to evaluate the position PID properties.
+* The external loop runs on a dedicated periodic thread (see ExternalPidLoop), with an optional real time priority and CPU affinity, so that
+* the effective control period does not depend on the scheduling of the test thread. For each cycle the test reports the step metrics
+* (rise time, overshoot, settling time, steady state error) together with the timing of the loop (actual period and jitter, computation
+* time, age of the encoder sample used by the pid, overruns) and the delay between the step command and the first encoder movement,
+* so that the controller performance can be separated from the scheduling noise of the test host.
+* The data acquired are saved to a different file for each joint (or all appended to the requested filename), and can be analyzed with a Matlab script to evaluate the position PID properties.
+* Each row contains cycle, time, position, reference and pwm, followed by the loop period, the computation time and the encoder age.
 * Be aware that a step greater than 5 degrees at the maximum speed can be dangerous for both the robot and the human operator!
 
 * example: testRunner -v -t PositionControlAccuracyExternalPid.dll -p "--robot icubSim --part head --joints ""(0 1 2)"" --zeros ""(0 0 0)""  --step 5  --cycles 10 --sampleTime 0.010 --Kp 1.0"
@@ -56,6 +112,10 @@
 * | Ki                 | double |       | 0     | No  | The Integral gain | |
 * | Kd                 | double |       | 0     | No  | The Derivative gain | |
 * | MaxValue           | double | %     | 100   | No  | max value for PID output (saturator). | |
+* | settling_band      | double | -     | 0.05  | No  | The band around the reference used to compute the settling time, as a fraction of the step | |
+* | thread_priority    | int    | -     | -     | No  | The priority of the pid thread | if not given the default priority is used |
+* | thread_policy      | int    | -     | 1     | No  | The scheduling policy of the pid thread (e.g. 1 = SCHED_FIFO, 2 = SCHED_RR on Linux) | used only with thread_priority |
+* | cpu_affinity       | vector of ints | - | - | No | The CPUs the pid thread is allowed to run on | Linux only |
 *
 */
 
@@ -73,9 +133,21 @@ public:
     bool goHome();
     void executeCmd();
     void setMode(int desired_mode);
-    void saveToFile(std::string filename, yarp::os::Bottle &b);
+    void saveToFile(std::string filename, yarp::os::Bottle &b, bool append = false);
 
 private:
+    struct stepResponse
+    {
+        double rise_time;
+        double overshoot;
+        double settling_time;
+        double steady_state_error;
+        double response_delay;
+    };
+
+    stepResponse computeStepResponse(const ExternalPidLoop& loop, double zero);
+    void reportTiming(const ExternalPidLoop& loop);
+
     std::string m_robotName;
     std::string m_partName;
     int*        m_jointsList;
@@ -92,6 +164,7 @@ private:
     yarp::dev::IControlMode     *icmd;
     yarp::dev::IInteractionMode  *iimd;
     yarp::dev::IEncoders         *ienc;
+    yarp::dev::IEncodersTimed    *ienct;
     yarp::dev::IPositionDirect   *idir;
     yarp::dev::IPWMControl       *ipwm;
 
@@ -106,6 +179,10 @@ private:
     std::string  m_requested_filename;
     double m_home_tolerance;
     double m_step_duration;
+    double m_settling_band;
+    int    m_thread_priority;
+    int    m_thread_policy;
+    std::vector<int> m_cpus;
 };
 
 #endif
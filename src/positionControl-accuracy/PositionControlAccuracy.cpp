@@ -50,6 +50,15 @@ PositionControlAccuracy::PositionControlAccuracy() : yarp::robottestingframework
     idir=0;
     m_home_tolerance=0.5;
     m_step_duration=4;
+    m_settling_band=0.05;
+    m_max_rise_time=-1;
+    m_max_overshoot=-1;
+    m_max_settling_time=-1;
+    m_max_steady_state_error=-1;
+    m_sweep=false;
+    m_cost_weights[0]=1.0;
+    m_cost_weights[1]=1.0;
+    m_cost_weights[2]=1.0;
 }
 
 PositionControlAccuracy::~PositionControlAccuracy() { }
@@ -74,6 +83,16 @@ bool PositionControlAccuracy::setup(yarp::os::Property& property) {
       {m_home_tolerance = property.find("home_tolerance").asFloat64();}
     if(property.check("step_duration"))
       {m_step_duration = property.find("step_duration").asFloat64();}
+    if(property.check("settling_band"))
+      {m_settling_band = property.find("settling_band").asFloat64();}
+    if(property.check("max_rise_time"))
+      {m_max_rise_time = property.find("max_rise_time").asFloat64();}
+    if(property.check("max_overshoot"))
+      {m_max_overshoot = property.find("max_overshoot").asFloat64();}
+    if(property.check("max_settling_time"))
+      {m_max_settling_time = property.find("max_settling_time").asFloat64();}
+    if(property.check("max_steady_state_error"))
+      {m_max_steady_state_error = property.find("max_steady_state_error").asFloat64();}
 
     m_robotName = property.find("robot").asString();
     m_partName = property.find("part").asString();
@@ -92,6 +111,14 @@ bool PositionControlAccuracy::setup(yarp::os::Property& property) {
 
     m_sampleTime = property.find("sampleTime").asFloat64();
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(m_sampleTime>0, "invalid sampleTime");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(m_step!=0, "invalid step");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(m_step_duration>1.0, "invalid step_duration, it must be >1s");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(m_settling_band>0, "invalid settling_band");
+
+    size_t n_samples = (size_t)(m_step_duration/m_sampleTime)+10;
+    m_time.reserve(n_samples);
+    m_pos.reserve(n_samples);
+    m_cmd.reserve(n_samples);
 
     Property options;
     options.put("device", "remote_controlboard");
@@ -118,33 +145,80 @@ bool PositionControlAccuracy::setup(yarp::os::Property& property) {
     for (int i = 0; i <m_n_cmd_joints; i++) m_jointsList[i] = jointsBottle->get(i).asInt32();
     for (int i = 0; i <m_n_cmd_joints; i++) m_zeros[i] = zerosBottle->get(i).asFloat64();
 
-    double p_Kp=std::nanf("");
-    double p_Ki=std::nanf("");
-    double p_Kd=std::nanf("");
-    double p_Max=std::nanf("");
-
-    int cj=m_jointsList[0];
-    ipid->getPid(VOCAB_PIDTYPE_POSITION,cj,&m_orig_pid);
-    m_new_pid=m_orig_pid;
+    //the original pid of each joint is restored at the end of the test, also if the test fails
+    m_orig_pids.resize(m_n_cmd_joints);
+    for (int i = 0; i <m_n_cmd_joints; i++)
+    {
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(ipid->getPid(VOCAB_PIDTYPE_POSITION, m_jointsList[i], &m_orig_pids[i]),
+                                                    Asserter::format("Unable to read the position pid of joint %d", m_jointsList[i]));
+    }
 
+    gainSet gains;
+    gains.kp=std::nan("");
+    gains.ki=std::nan("");
+    gains.kd=std::nan("");
     if(property.check("Kp"))
-      {p_Kp = property.find("Kp").asFloat64();}
+      {gains.kp = property.find("Kp").asFloat64();}
     if(property.check("Ki"))
-      {p_Ki = property.find("Ki").asFloat64();}
+      {gains.ki = property.find("Ki").asFloat64();}
     if(property.check("Kd"))
-      {p_Kd = property.find("Kd").asFloat64();}
-    //if(property.check("MaxValue"))
-    //  {p_Max = property.find("MaxValue").asFloat64();}
-    if (std::isnan(p_Kp)==false) {m_new_pid.kp=p_Kp;}
-    if (std::isnan(p_Kd)==false) {m_new_pid.kd=p_Kd;}
-    if (std::isnan(p_Ki)==false) {m_new_pid.ki=p_Ki;}
-
-    /*if (std::isnan(p_Kp)==false ||
-        std::isnan(p_Ki)==false ||
-        std::isnan(p_Kd)==false)
+      {gains.kd = property.find("Kd").asFloat64();}
+    m_gains.clear();
+    m_gains.push_back(gains);
+
+    //sweep mode: an explicit list of gain sets, or the grid of the given gains
+    if(property.check("sweep_gains"))
     {
-        ipid->setPid(cj,m_new_pid);
-    }*/
+        Bottle* b = property.find("sweep_gains").asList();
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(b!=0 && b->size()>0, "unable to parse sweep_gains parameter");
+        m_gains.clear();
+        for (size_t k = 0; k < b->size(); k++)
+        {
+            Bottle* g = b->get(k).asList();
+            ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(g!=0 && g->size()==3, "each element of sweep_gains must be a list (Kp Ki Kd)");
+            gainSet set;
+            set.kp = g->get(0).asFloat64();
+            set.ki = g->get(1).asFloat64();
+            set.kd = g->get(2).asFloat64();
+            m_gains.push_back(set);
+        }
+        m_sweep = true;
+    }
+    else if(property.check("sweep_Kp") || property.check("sweep_Ki") || property.check("sweep_Kd"))
+    {
+        //a missing axis of the grid keeps the original gain of the joint, or the one given with Kp/Ki/Kd
+        std::vector<double> grid[3];
+        const char* keys[3] = {"sweep_Kp", "sweep_Ki", "sweep_Kd"};
+        double defaults[3] = {gains.kp, gains.ki, gains.kd};
+        for (int a = 0; a < 3; a++)
+        {
+            Bottle* b = property.find(keys[a]).asList();
+            if (b)
+            {
+                for (size_t k = 0; k < b->size(); k++) grid[a].push_back(b->get(k).asFloat64());
+            }
+            if (grid[a].empty()) grid[a].push_back(defaults[a]);
+        }
+        m_gains.clear();
+        for (size_t p = 0; p < grid[0].size(); p++)
+            for (size_t q = 0; q < grid[1].size(); q++)
+                for (size_t d = 0; d < grid[2].size(); d++)
+                {
+                    gainSet set;
+                    set.kp = grid[0][p];
+                    set.ki = grid[1][q];
+                    set.kd = grid[2][d];
+                    m_gains.push_back(set);
+                }
+        m_sweep = true;
+    }
+
+    if(property.check("cost_weights"))
+    {
+        Bottle* b = property.find("cost_weights").asList();
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(b!=0 && b->size()==3, "cost_weights must be a list (overshoot settling error)");
+        for (int k = 0; k < 3; k++) m_cost_weights[k] = b->get(k).asFloat64();
+    }
 
     return true;
 }
@@ -154,6 +228,7 @@ void PositionControlAccuracy::tearDown()
     if (m_jointsList) { delete [] m_jointsList; m_jointsList = 0; }
     if (m_zeros) { delete [] m_zeros; m_zeros = 0; }
     if (m_encoders) { delete [] m_encoders; m_encoders = 0; }
+    m_orig_pids.clear();
     if (dd) {delete dd; dd =0;}
 }
 
@@ -220,22 +295,177 @@ bool PositionControlAccuracy::goHome()
     return true;
 }
 
-void PositionControlAccuracy::run()
+PositionControlAccuracy::stepResponse PositionControlAccuracy::computeStepResponse(double zero, double time_zero)
+{
+    stepResponse r;
+    r.rise_time = std::nan("");
+    r.overshoot = 0;
+    r.settling_time = std::nan("");
+    r.steady_state_error = 0;
+
+    double t10 = std::nan("");
+    double t90 = std::nan("");
+    double last_outside = time_zero;
+    double y_max = 0;
+    double end_time = m_time.empty() ? time_zero : m_time.back();
+    double err_sum = 0;
+    int    err_n = 0;
+
+    for (size_t k = 0; k < m_time.size(); k++)
+    {
+        if (m_time[k] < time_zero) continue;
+
+        // position normalized with respect to the step, so that also negative steps are handled
+        double y = (m_pos[k] - zero) / m_step;
+        if (std::isnan(t10) && y >= 0.1) t10 = m_time[k];
+        if (std::isnan(t90) && y >= 0.9) t90 = m_time[k];
+        if (y > y_max) y_max = y;
+        if (fabs(y - 1.0) > m_settling_band) last_outside = m_time[k];
+
+        if (m_time[k] >= end_time - 0.2 * (end_time - time_zero))
+        {
+            err_sum += m_cmd[k] - m_pos[k];
+            err_n++;
+        }
+    }
+
+    if (!std::isnan(t10) && !std::isnan(t90)) r.rise_time = t90 - t10;
+    r.overshoot = std::max(0.0, (y_max - 1.0) * 100.0);
+    if (last_outside < end_time) r.settling_time = last_outside - time_zero;
+    if (err_n > 0) r.steady_state_error = err_sum / err_n;
+    return r;
+}
+
+void PositionControlAccuracy::summarizeStepResponses(const std::vector<stepResponse>& responses, double mean[4], double std_dev[4], int n[4])
+{
+    // mean and standard deviation of each quantity, the cycles where a quantity is not defined are skipped
+    for (int q = 0; q < 4; q++) { mean[q] = 0; std_dev[q] = 0; n[q] = 0; }
+    for (size_t c = 0; c < responses.size(); c++)
+    {
+        double v[4] = {responses[c].rise_time, responses[c].overshoot, responses[c].settling_time, fabs(responses[c].steady_state_error)};
+        for (int q = 0; q < 4; q++)
+        {
+            if (std::isnan(v[q])) continue;
+            mean[q] += v[q];
+            std_dev[q] += v[q] * v[q];
+            n[q]++;
+        }
+    }
+    for (int q = 0; q < 4; q++)
+    {
+        if (n[q] == 0) { mean[q] = std::nan(""); std_dev[q] = std::nan(""); continue; }
+        mean[q] /= n[q];
+        std_dev[q] = sqrt(std::max(0.0, std_dev[q] / n[q] - mean[q] * mean[q]));
+    }
+}
+
+void PositionControlAccuracy::checkStepResponses(int joint, const std::vector<stepResponse>& responses)
+{
+    double mean[4], std_dev[4];
+    int    n[4];
+    summarizeStepResponses(responses, mean, std_dev, n);
+
+    ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Joint %d: rise time %.3f+-%.3f s, overshoot %.2f+-%.2f %%, settling time %.3f+-%.3f s, steady state error %.4f+-%.4f deg",
+                                                       joint, mean[0], std_dev[0], mean[1], std_dev[1], mean[2], std_dev[2], mean[3], std_dev[3]));
+    ROBOTTESTINGFRAMEWORK_TEST_CHECK(n[0] == (int)responses.size(), Asserter::format("Joint %d reached 90%% of the step in %d/%d cycles", joint, n[0], (int)responses.size()));
+    ROBOTTESTINGFRAMEWORK_TEST_CHECK(n[2] == (int)responses.size(), Asserter::format("Joint %d settled in %d/%d cycles", joint, n[2], (int)responses.size()));
+
+    if (m_max_rise_time >= 0)
+        ROBOTTESTINGFRAMEWORK_TEST_CHECK(mean[0] <= m_max_rise_time, Asserter::format("Joint %d rise time %.3f s (max %.3f s)", joint, mean[0], m_max_rise_time));
+    if (m_max_overshoot >= 0)
+        ROBOTTESTINGFRAMEWORK_TEST_CHECK(mean[1] <= m_max_overshoot, Asserter::format("Joint %d overshoot %.2f %% (max %.2f %%)", joint, mean[1], m_max_overshoot));
+    if (m_max_settling_time >= 0)
+        ROBOTTESTINGFRAMEWORK_TEST_CHECK(mean[2] <= m_max_settling_time, Asserter::format("Joint %d settling time %.3f s (max %.3f s)", joint, mean[2], m_max_settling_time));
+    if (m_max_steady_state_error >= 0)
+        ROBOTTESTINGFRAMEWORK_TEST_CHECK(mean[3] <= m_max_steady_state_error, Asserter::format("Joint %d steady state error %.4f deg (max %.4f deg)", joint, mean[3], m_max_steady_state_error));
+}
+
+yarp::dev::Pid PositionControlAccuracy::makePid(int i, const gainSet& gains)
+{
+    //the gains which are not given keep the original value
+    yarp::dev::Pid pid = m_orig_pids[i];
+    if (!std::isnan(gains.kp)) pid.kp = gains.kp;
+    if (!std::isnan(gains.ki)) pid.ki = gains.ki;
+    if (!std::isnan(gains.kd)) pid.kd = gains.kd;
+    return pid;
+}
+
+void PositionControlAccuracy::restorePids()
+{
+    for (size_t i = 0; i < m_orig_pids.size(); i++)
+    {
+        if (!ipid->setPid(VOCAB_PIDTYPE_POSITION, m_jointsList[i], m_orig_pids[i]))
+            yError() << "Unable to restore the original position pid of joint" << m_jointsList[i];
+    }
+}
+
+void PositionControlAccuracy::acquireStep(int i, double& time_zero)
+{
+    double start_time = yarp::os::Time::now();
+    time_zero = 0;
+    m_time.clear();
+    m_pos.clear();
+    m_cmd.clear();
+
+    while (1)
+    {
+        double curr_time = yarp::os::Time::now();
+        double elapsed = curr_time - start_time;
+
+        if (elapsed <= 1.0)
+        {
+            m_cmd_single = m_zeros[i]; //0.0;
+        }
+        else if (elapsed > 1.0 && elapsed <= m_step_duration)
+        {
+            m_cmd_single = m_zeros[i] + m_step;
+            if (time_zero == 0) time_zero = elapsed;
+        }
+        else
+        {
+            break;
+        }
+
+        ienc->getEncoders(m_encoders);
+        idir->setPosition(m_jointsList[i], m_cmd_single);
+
+        m_time.push_back(elapsed);
+        m_pos.push_back(m_encoders[m_jointsList[i]]);
+        m_cmd.push_back(m_cmd_single);
+        yarp::os::Time::delay(m_sampleTime);
+    }
+}
+
+std::string PositionControlAccuracy::dataFilename(int i)
+{
+    if (m_requested_filename!="") return m_requested_filename;
+    char cfilename[128];
+    sprintf(cfilename, "positionControlAccuracy_plot_%s%d.txt", m_partName.c_str(), i);
+    return cfilename;
+}
+
+void PositionControlAccuracy::runSteps()
 {
     for (int i = 0; i < m_n_cmd_joints; i++)
     {
+        std::vector<stepResponse> responses;
+        responses.reserve(m_cycles);
+
+        std::string filename = dataFilename(i);
+        yInfo() << "Saving file to: "<< filename;
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(m_store.open(filename, m_jointsList[i], m_requested_filename!="" && i>0), "Unable to open " + filename);
+
         for (int cycle = 0; cycle < m_cycles; cycle++)
         {
-			ipid->setPid(VOCAB_PIDTYPE_POSITION,m_jointsList[i],m_orig_pid);
+            ipid->setPid(VOCAB_PIDTYPE_POSITION,m_jointsList[i],m_orig_pids[i]);
             setMode(VOCAB_CM_POSITION);
             if (goHome() == false)
             {
                 ROBOTTESTINGFRAMEWORK_ASSERT_FAIL("Test stopped");
             };
 
-            ipid->setPid(VOCAB_PIDTYPE_POSITION,m_jointsList[i],m_new_pid);
+            ipid->setPid(VOCAB_PIDTYPE_POSITION,m_jointsList[i],makePid(i, m_gains[0]));
             setMode(VOCAB_CM_POSITION_DIRECT);
-            double start_time = yarp::os::Time::now();
 
             char cbuff[64];
             sprintf(cbuff, "Testing Joint: %d cycle: %d", i, cycle);
@@ -244,106 +474,111 @@ void PositionControlAccuracy::run()
             ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
 
             double time_zero = 0;
-            yarp::os::Bottle      dataToPlotRaw;
-            yarp::os::Bottle      dataToPlotSync;
+            acquireStep(i, time_zero);
 
-            while (1)
-            {
-                double curr_time = yarp::os::Time::now();
-                double elapsed = curr_time - start_time;
+            stepResponse r = computeStepResponse(m_zeros[i], time_zero);
+            responses.push_back(r);
+            ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("rise time %.3f s, overshoot %.2f %%, settling time %.3f s, steady state error %.4f deg",
+                                                               r.rise_time, r.overshoot, r.settling_time, r.steady_state_error));
 
-                if (elapsed <= 1.0)
-                {
-                    m_cmd_single = m_zeros[i]; //0.0;
-                }
-                else if (elapsed > 1.0 && elapsed <= m_step_duration)
-                {
-                    m_cmd_single = m_zeros[i] + m_step;
-                    if (time_zero == 0) time_zero = elapsed;
-                }
-                else
-                {
-                    break;
-                }
+            //time is saved with respect to the instant of the step
+            ROBOTTESTINGFRAMEWORK_TEST_CHECK(m_store.writeSegment(cycle, time_zero, m_time, m_pos, m_cmd), "Unable to save the data of the cycle");
+        } //cycle loop
 
-                ienc->getEncoders(m_encoders);
-                idir->setPosition(m_jointsList[i], m_cmd_single);
+        m_store.close();
+        checkStepResponses(m_jointsList[i], responses);
+        ipid->setPid(VOCAB_PIDTYPE_POSITION,m_jointsList[i],m_orig_pids[i]);
+    } //joint loop
+}
 
-                Bottle& b1 = dataToPlotRaw.addList();
-                b1.addInt32(cycle);
-                b1.addFloat64(elapsed);
-                b1.addFloat64(m_encoders[m_jointsList[i]]);
-                b1.addFloat64(m_cmd_single);
-                yarp::os::Time::delay(m_sampleTime);
-            }
+void PositionControlAccuracy::runSweep()
+{
+    for (int i = 0; i < m_n_cmd_joints; i++)
+    {
+        //the joint is homed only once: each cycle starts commanding the zero position in position direct mode
+        ipid->setPid(VOCAB_PIDTYPE_POSITION,m_jointsList[i],m_orig_pids[i]);
+        setMode(VOCAB_CM_POSITION);
+        if (goHome() == false)
+        {
+            ROBOTTESTINGFRAMEWORK_ASSERT_FAIL("Test stopped");
+        };
+        setMode(VOCAB_CM_POSITION_DIRECT);
 
-            //reorder data
-            for (int t = 0; t < dataToPlotRaw.size(); t++)
+        std::string filename = dataFilename(i);
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(m_store.open(filename, m_jointsList[i], m_requested_filename!="" && i>0), "Unable to open " + filename);
+
+        std::vector<sweepResult> results(m_gains.size());
+        std::vector<stepResponse> responses;
+        responses.reserve(m_cycles);
+        for (size_t g = 0; g < m_gains.size(); g++)
+        {
+            yarp::dev::Pid pid = makePid(i, m_gains[g]);
+            ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Testing Joint: %d gains %d/%d: Kp %g Ki %g Kd %g",
+                                                               i, (int)g+1, (int)m_gains.size(), pid.kp, pid.ki, pid.kd));
+            ipid->setPid(VOCAB_PIDTYPE_POSITION,m_jointsList[i],pid);
+
+            responses.clear();
+            for (int cycle = 0; cycle < m_cycles; cycle++)
             {
-                int    cycle = dataToPlotRaw.get(t).asList()->get(0).asInt32();
-                double time = dataToPlotRaw.get(t).asList()->get(1).asFloat64();
-                double val = dataToPlotRaw.get(t).asList()->get(2).asFloat64();
-                double cmd = dataToPlotRaw.get(t).asList()->get(3).asFloat64();
-                Bottle& b1 = dataToPlotSync.addList();
-                b1.addInt32(cycle);
-                b1.addFloat64(time - time_zero);
-                b1.addFloat64(val);
-                b1.addFloat64(cmd);
+                double time_zero = 0;
+                acquireStep(i, time_zero);
+                responses.push_back(computeStepResponse(m_zeros[i], time_zero));
+                m_store.writeSegment((int)g*m_cycles + cycle, time_zero, m_time, m_pos, m_cmd);
             }
 
-            m_dataToSave.append(dataToPlotSync);
-        } //cycle loop
-
-        //save data
-        std::string filename;
-        if (m_requested_filename=="")
-        {
-            char cfilename[128];
-            sprintf(cfilename, "positionControlAccuracy_plot_%s%d.txt", m_partName.c_str(), i);
-            filename = cfilename;
-            //filename += m_partName;
-            //filename += std::to_string(i);
-            //filename += ".txt";
+            sweepResult& res = results[g];
+            res.pid = pid;
+            summarizeStepResponses(responses, res.mean, res.std_dev, res.n);
+
+            //a cycle which does not settle is charged as if it settled at the end of the step
+            double overshoot = res.mean[1];
+            double settling = (res.n[2] == m_cycles) ? res.mean[2] : m_step_duration;
+            double error = std::isnan(res.mean[3]) ? fabs(m_step) : res.mean[3];
+            res.cost = m_cost_weights[0] * overshoot / 100.0 +
+                       m_cost_weights[1] * settling / m_step_duration +
+                       m_cost_weights[2] * error / fabs(m_step);
         }
-        else
+        m_store.close();
+        ipid->setPid(VOCAB_PIDTYPE_POSITION,m_jointsList[i],m_orig_pids[i]);
+
+        //ranking, the best gain set first
+        std::sort(results.begin(), results.end(), [](const sweepResult& a, const sweepResult& b) { return a.cost < b.cost; });
+
+        char cfilename[128];
+        sprintf(cfilename, "positionControlAccuracy_sweep_%s%d.txt", m_partName.c_str(), i);
+        std::ofstream fs(cfilename);
+        fs << "#rank Kp Ki Kd rise_time overshoot settling_time steady_state_error cost" << std::endl;
+
+        ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Joint %d gain sets ranking:", m_jointsList[i]));
+        for (size_t r = 0; r < results.size(); r++)
         {
-            filename=m_requested_filename;
+            const sweepResult& res = results[r];
+            ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("%2d) Kp %g Ki %g Kd %g: rise time %.3f s, overshoot %.2f %%, settling time %.3f s (%d/%d settled), steady state error %.4f deg, cost %.4f",
+                                                               (int)r+1, res.pid.kp, res.pid.ki, res.pid.kd, res.mean[0], res.mean[1], res.mean[2],
+                                                               res.n[2], m_cycles, res.mean[3], res.cost));
+            fs << r+1 << " " << res.pid.kp << " " << res.pid.ki << " " << res.pid.kd << " " << res.mean[0] << " " << res.mean[1] << " "
+               << res.mean[2] << " " << res.mean[3] << " " << res.cost << std::endl;
         }
-        yInfo() << "Saving file to: "<< filename;
-        saveToFile(filename, m_dataToSave);
-        ipid->setPid(VOCAB_PIDTYPE_POSITION,m_jointsList[i],m_orig_pid);
     } //joint loop
-
-    //data acquisition ends here
-    setMode(VOCAB_CM_POSITION);
-    goHome();
-    ROBOTTESTINGFRAMEWORK_TEST_REPORT("Data acquisition complete");
-
-    //plot data
-    /*for (int i = 0; i < m_n_cmd_joints; i++)
-    {
-        std::string filename = "positionControlAccuracy_plot_";
-        filename += m_partName;
-        filename += std::to_string(i);
-        filename += ".txt";
-        char plotstring[1000];
-        sprintf(plotstring, "gnuplot -e \" unset key; plot for [col=1:%d] '%s' using col with lines \" -persist", m_n_cmd_joints, filename.c_str());
-        system(plotstring);
-    }*/
 }
 
-void PositionControlAccuracy::saveToFile(std::string filename, yarp::os::Bottle &b)
+void PositionControlAccuracy::run()
 {
-    std::fstream fs;
-    fs.open(filename.c_str(), std::fstream::out);
-
-    for (int i = 0; i<b.size(); i++)
+    try
+    {
+        if (m_sweep) runSweep();
+        else         runSteps();
+    }
+    catch (...)
     {
-        std::string s = b.get(i).toString();
-        std::replace(s.begin(), s.end(), '(', ' ');
-        std::replace(s.begin(), s.end(), ')', ' ');
-        fs << s << std::endl;
+        m_store.close();
+        restorePids();
+        throw;
     }
+    restorePids();
 
-    fs.close();
+    //data acquisition ends here
+    setMode(VOCAB_CM_POSITION);
+    goHome();
+    ROBOTTESTINGFRAMEWORK_TEST_REPORT("Data acquisition complete");
 }
@@ -21,16 +21,34 @@
 #ifndef _POSITIONACCURACY_H_
 #define _POSITIONACCURACY_H_
 
+#include <fstream>
 #include <string>
+#include <vector>
 #include <yarp/robottestingframework/TestCase.h>
 #include <yarp/dev/ControlBoardInterfaces.h>
 #include <yarp/dev/PolyDriver.h>
+#include "CycleDataStore.h"
 
 /**
 * \ingroup icub-tests
 * This tests checks the a position PID response, sending a step reference signal with a positionDirect command.
-* This test currently does not return any error report. It simply moves a joint, and saves data to a different file for each joint.
-* The data acquired can be analyzed with a Matlab script to evaluate the position PID properties.
+* For each cycle the step response is analyzed and the following quantities are computed:
+* \li rise time: the time needed to go from 10% to 90% of the step;
+* \li overshoot: the maximum position beyond the step, in percentage of the step amplitude;
+* \li settling time: the time after which the position stays within settling_band of the step amplitude from the reference;
+* \li steady state error: the mean error between reference and position in the last 20% of the step duration.
+*
+* Mean and standard deviation across the cycles are reported for each joint, and the mean values are checked against the
+* thresholds given in the test parameters (a check is skipped if its threshold is not given).
+* The data acquired are also saved to a different file for each joint (or all to the requested filename), and can be further analyzed with the plotDataPosition.m script.
+* Each cycle is written as soon as it is completed, see CycleDataStore for the file format.
+*
+* If sweep_gains or any of sweep_Kp, sweep_Ki, sweep_Kd is given, the test runs in sweep mode: for each joint and for each gain set
+* (the explicit list, or the grid of the given gains) the step is repeated for the given number of cycles. The joint is homed only once,
+* and each cycle starts commanding the home position in position direct mode. The gain sets are ranked by the cost
+* w_o*overshoot/100 + w_s*settling_time/step_duration + w_e*steady_state_error/step, where a cycle that does not settle is charged with
+* step_duration. The ranking is reported and saved in positionControlAccuracy_sweep_<part><joint>.txt.
+* The original pid of each joint is always restored at the end of the test, also if the test fails.
 * Be aware that a step greater than 5 degrees at the maximum speed can be dangerous for both the robot and the human operator!
 
 * example: testRunner -v -t PositionControlAccuracy.dll -p "--robot icubSim --part head --joints ""(0 1 2)"" --zeros ""(0 0 0)""  --step 5  --cycles 10 --sampleTime 0.010"
@@ -48,7 +66,20 @@
 * | sampleTime         | double | s     | -     | Yes | The sample time of the control thread | |
 * | home_tolerance     | double | deg   | 0.5   | No  | The max acceptable position error during the homing phase. | |
 * | filename           | string |       |       | No  | The output filename. If not specified, the name will be generated using 'part' parameter and joint number | |
-* | step_duration      | double | s     |       | No  | The duration of the step. After this time, a new test cycle starts. | |
+* | step_duration      | double | s     | 4     | No  | The duration of the step. After this time, a new test cycle starts. | |
+* | settling_band      | double | -     | 0.05  | No  | The band around the reference used to compute the settling time, as a fraction of the step | |
+* | max_rise_time      | double | s     | -     | No  | The maximum mean rise time | |
+* | max_overshoot      | double | %     | -     | No  | The maximum mean overshoot | |
+* | max_settling_time  | double | s     | -     | No  | The maximum mean settling time | |
+* | max_steady_state_error | double | deg | -   | No  | The maximum mean absolute steady state error | |
+* | Kp                 | double | -     | -     | No  | The proportional gain used during the test | the original one if not given |
+* | Ki                 | double | -     | -     | No  | The integral gain used during the test | the original one if not given |
+* | Kd                 | double | -     | -     | No  | The derivative gain used during the test | the original one if not given |
+* | sweep_Kp           | vector of doubles | - | - | No | Proportional gains of the sweep grid | see below |
+* | sweep_Ki           | vector of doubles | - | - | No | Integral gains of the sweep grid | see below |
+* | sweep_Kd           | vector of doubles | - | - | No | Derivative gains of the sweep grid | see below |
+* | sweep_gains        | list of (Kp Ki Kd) | - | - | No | Explicit list of gain sets to be swept, alternative to the grid | |
+* | cost_weights       | vector of 3 doubles | - | (1 1 1) | No | Weights of overshoot, settling time and steady state error in the sweep cost | |
 *
 */
 
@@ -66,9 +97,42 @@ public:
     bool goHome();
     void executeCmd();
     void setMode(int desired_mode);
-    void saveToFile(std::string filename, yarp::os::Bottle &b);
 
 private:
+    struct stepResponse
+    {
+        double rise_time;
+        double overshoot;
+        double settling_time;
+        double steady_state_error;
+    };
+
+    struct gainSet
+    {
+        double kp;
+        double ki;
+        double kd;
+    };
+
+    struct sweepResult
+    {
+        yarp::dev::Pid pid;
+        double mean[4];
+        double std_dev[4];
+        int    n[4];
+        double cost;
+    };
+
+    stepResponse computeStepResponse(double zero, double time_zero);
+    void summarizeStepResponses(const std::vector<stepResponse>& responses, double mean[4], double std_dev[4], int n[4]);
+    void checkStepResponses(int joint, const std::vector<stepResponse>& responses);
+    void acquireStep(int i, double& time_zero);
+    std::string dataFilename(int i);
+    yarp::dev::Pid makePid(int i, const gainSet& gains);
+    void restorePids();
+    void runSteps();
+    void runSweep();
+
     std::string m_robotName;
     std::string m_partName;
     int*        m_jointsList;
@@ -78,7 +142,7 @@ private:
     double      m_step;
     int         m_n_part_joints;
     int         m_n_cmd_joints;
-    yarp::os::Bottle      m_dataToSave;
+    CycleDataStore        m_store;
 
     yarp::dev::PolyDriver        *dd;
     yarp::dev::IPositionControl *ipos;
@@ -93,8 +157,21 @@ private:
     std::string m_requested_filename;
     double m_home_tolerance;
     double m_step_duration;
-    yarp::dev::Pid m_orig_pid;
-    yarp::dev::Pid m_new_pid;
+    std::vector<yarp::dev::Pid> m_orig_pids;
+    std::vector<gainSet>        m_gains;
+    bool   m_sweep;
+    double m_cost_weights[3];
+
+    double m_settling_band;
+    double m_max_rise_time;
+    double m_max_overshoot;
+    double m_max_settling_time;
+    double m_max_steady_state_error;
+
+    // samples of the current cycle, preallocated in setup()
+    std::vector<double> m_time;
+    std::vector<double> m_pos;
+    std::vector<double> m_cmd;
 };
 
 #endif
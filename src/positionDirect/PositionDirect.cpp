@@ -19,6 +19,10 @@
  */
 
 #include <math.h>
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdio>
 #include <robottestingframework/TestAssert.h>
 #include <robottestingframework/dll/Plugin.h>
 #include <yarp/os/Time.h>
@@ -33,6 +37,30 @@ using namespace yarp::dev;
 // prepare the plugin
 ROBOTTESTINGFRAMEWORK_PREPARE_PLUGIN(PositionDirect)
 
+EncoderStampReader::EncoderStampReader(yarp::dev::IEncodersTimed* ienc, int n_part_joints, int joint, double period) :
+    PeriodicThread(period), m_ienc(ienc), m_encoders(n_part_joints), m_stamps(n_part_joints), m_joint(joint),
+    m_last_stamp(0), m_updates(0)
+{
+}
+
+bool EncoderStampReader::threadInit()
+{
+    m_updates = 0;
+    m_ienc->getEncodersTimed(m_encoders.data(), m_stamps.data());
+    m_last_stamp = m_stamps[m_joint];
+    return true;
+}
+
+void EncoderStampReader::run()
+{
+    m_ienc->getEncodersTimed(m_encoders.data(), m_stamps.data());
+    if (m_stamps[m_joint] != m_last_stamp)
+    {
+        m_updates++;
+        m_last_stamp = m_stamps[m_joint];
+    }
+}
+
 PositionDirect::PositionDirect() : yarp::robottestingframework::TestCase("PositionDirect") {
     jointsList=0;
     pos_tot=0;
@@ -41,9 +69,29 @@ PositionDirect::PositionDirect() : yarp::robottestingframework::TestCase("Positi
     icmd=0;
     iimd=0;
     ienc=0;
+    ienct=0;
     idir=0;
+    stamp_tot=0;
+    benchmark=false;
+    excitation=sine;
+    minFrequency=0.1;
+    maxFrequency=5.0;
+    excitationDuration=20.0;
+    bodePoints=20;
+    minBandwidth=-1;
+    multisineScale=1.0;
+    benchDuration=5.0;
+    failedCmds=0;
+    encUpdates=0;
     cmd_some=0;
     cmd_tot=0;
+    deadlineTolerance=0.5;
+    maxPhaseLag=-1;
+    minAmplitudeRatio=-1;
+    maxTrackingError=-1;
+    maxMissedDeadlines=-1;
+    missedDeadlines=0;
+    maxLateness=0;
 }
 
 PositionDirect::~PositionDirect() { }
@@ -64,7 +112,8 @@ bool PositionDirect::setup(yarp::os::Property& property) {
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("cycles"), "The number of cycles of the control signal must be given as the test parameter!");
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("tolerance"), "The tolerance of the control signal must be given as the test parameter!");
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("sampleTime"), "The sampleTime of the control signal must be given as the test parameter!");
-    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(property.check("cmdMode"), "the cmdType must be given as the test parameter! 0=single_joint, 1=all_joints, 2=some_joints");
+    if(property.check("benchmark"))
+        benchmark = property.find("benchmark").asBool();
 
     robotName = property.find("robot").asString();
     partName = property.find("part").asString();
@@ -91,9 +140,75 @@ bool PositionDirect::setup(yarp::os::Property& property) {
     sampleTime = property.find("sampleTime").asFloat64();
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(sampleTime>0,"invalid sampleTime");
 
-    cmd_mode = (cmd_mode_t) property.find("cmdMode").asInt32();
+    cmd_mode = (cmd_mode_t) property.check("cmdMode",Value((int)some_joints)).asInt32();
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(cmd_mode>=0 && cmd_mode<=2,"invalid cmdMode: can be 0=single_joint, 1=all_joints ,2=some_joints");
 
+    if(property.check("deadlineTolerance"))
+        deadlineTolerance = property.find("deadlineTolerance").asFloat64();
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(deadlineTolerance>0,"invalid deadlineTolerance");
+    if(property.check("maxPhaseLag"))
+        maxPhaseLag = property.find("maxPhaseLag").asFloat64();
+    if(property.check("minAmplitudeRatio"))
+        minAmplitudeRatio = property.find("minAmplitudeRatio").asFloat64();
+    if(property.check("maxTrackingError"))
+        maxTrackingError = property.find("maxTrackingError").asFloat64();
+    if(property.check("maxMissedDeadlines"))
+        maxMissedDeadlines = property.find("maxMissedDeadlines").asInt32();
+
+    std::string excitation_name = property.check("excitation",Value("sine")).asString();
+    if (excitation_name=="sine")           excitation=sine;
+    else if (excitation_name=="chirp")     excitation=chirp;
+    else if (excitation_name=="multisine") excitation=multisine;
+    else ROBOTTESTINGFRAMEWORK_ASSERT_ERROR("invalid excitation: can be sine, chirp or multisine");
+
+    if (excitation!=sine)
+    {
+        minFrequency = property.check("minFrequency",Value(0.1)).asFloat64();
+        maxFrequency = property.check("maxFrequency",Value(5.0)).asFloat64();
+        excitationDuration = property.check("excitationDuration",Value(20.0)).asFloat64();
+        bodePoints = property.check("bodePoints",Value(20)).asInt32();
+        if(property.check("minBandwidth"))
+            minBandwidth = property.find("minBandwidth").asFloat64();
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(minFrequency>0 && maxFrequency>minFrequency,"invalid minFrequency/maxFrequency");
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(maxFrequency<0.5/sampleTime,"maxFrequency must be below the Nyquist frequency 0.5/sampleTime");
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(excitationDuration*minFrequency>=1,"excitationDuration must last at least one period of minFrequency");
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(bodePoints>1,"invalid bodePoints");
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(!benchmark,"benchmark is available only with the sine excitation");
+        if (excitation==multisine) prepareMultisine();
+    }
+
+    if(benchmark)
+    {
+        benchPeriods.clear();
+        Bottle* b = property.find("benchmarkPeriods").asList();
+        if(b)
+        {
+            for(size_t i=0; i<b->size(); i++) benchPeriods.push_back(b->get(i).asFloat64());
+        }
+        else
+        {
+            benchPeriods = {0.020, 0.010, 0.005, 0.002, 0.001};
+        }
+        for(size_t i=0; i<benchPeriods.size(); i++)
+            ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(benchPeriods[i]>0,"invalid benchmarkPeriods");
+
+        benchModes.clear();
+        b = property.find("benchmarkModes").asList();
+        if(b)
+        {
+            for(size_t i=0; i<b->size(); i++) benchModes.push_back(b->get(i).asInt32());
+        }
+        else
+        {
+            benchModes = {single_joint, some_joints, all_joints};
+        }
+        for(size_t i=0; i<benchModes.size(); i++)
+            ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(benchModes[i]>=0 && benchModes[i]<=2,"invalid benchmarkModes: can be 0=single_joint, 1=all_joints ,2=some_joints");
+
+        benchDuration = property.check("benchmarkDuration",Value(5.0)).asFloat64();
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(benchDuration>0,"invalid benchmarkDuration");
+    }
+
     Property options;
     options.put("device", "remote_controlboard");
     options.put("remote", "/"+robotName+"/"+partName);
@@ -103,6 +218,7 @@ bool PositionDirect::setup(yarp::os::Property& property) {
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->isValid(),"Unable to open device driver");
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(idir),"Unable to open position direct interface");
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(ienc),"Unable to open encoders interface");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(ienct),"Unable to open timed encoders interface");
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(ipos),"Unable to open position interface");
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(icmd),"Unable to open control mode interface");
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(iimd),"Unable to open interaction mode interface");
@@ -112,18 +228,19 @@ bool PositionDirect::setup(yarp::os::Property& property) {
         ROBOTTESTINGFRAMEWORK_ASSERT_ERROR("unable to get the number of joints of the part");
     }
 
-    if (cmd_mode==all_joints && n_part_joints!=n_cmd_joints)
+    if (!benchmark && cmd_mode==all_joints && n_part_joints!=n_cmd_joints)
     {
         ROBOTTESTINGFRAMEWORK_ASSERT_ERROR("if all_joints=2 mode is selected, joints parameter must include the full list of joints");
     }
 
-    if (cmd_mode==single_joint && n_cmd_joints!=1)
+    if (!benchmark && cmd_mode==single_joint && n_cmd_joints!=1)
     {
         ROBOTTESTINGFRAMEWORK_ASSERT_ERROR("if single_joint=1 mode is selected, joints parameter must include one single joint");
     }
 
     cmd_tot = new double[n_part_joints];
     pos_tot=new double[n_part_joints];
+    stamp_tot=new double[n_part_joints];
     jointsList=new int[n_cmd_joints];
     cmd_some=new double[n_cmd_joints];
     for (int i=0; i <n_cmd_joints; i++) jointsList[i]=jointsBottle->get(i).asInt32();
@@ -169,13 +286,14 @@ void PositionDirect::setMode(int desired_mode)
     }
 }
 
-void PositionDirect::executeCmd()
+bool PositionDirect::executeCmd()
 {
+    bool ret=true;
     if (cmd_mode==single_joint)
     {
         for (int i=0; i<n_cmd_joints; i++)
         {
-            idir->setPosition(jointsList[i],cmd_single);
+            ret&=idir->setPosition(jointsList[i],cmd_single);
         }
     }
     else if (cmd_mode==some_joints)
@@ -184,15 +302,15 @@ void PositionDirect::executeCmd()
         {
             cmd_some[i]=cmd_single;
         }
-        idir->setPositions(n_cmd_joints,jointsList, cmd_some);
+        ret=idir->setPositions(n_cmd_joints,jointsList, cmd_some);
     }
     else if (cmd_mode==all_joints)
     {
-        for (int i=0; i<n_part_joints; i++)
+        for (int i=0; i<n_cmd_joints; i++)
         {
-            cmd_tot[i]=cmd_single;
+            cmd_tot[jointsList[i]]=cmd_single;
         }
-        idir->setPositions(cmd_tot);
+        ret=idir->setPositions(cmd_tot);
     }
     else
     {
@@ -200,6 +318,7 @@ void PositionDirect::executeCmd()
     }
 
     prev_cmd=cmd_single;
+    return ret;
 }
 
 void PositionDirect::goHome()
@@ -229,31 +348,430 @@ void PositionDirect::goHome()
     }
 }
 
-void PositionDirect::run()
+void PositionDirect::fitSine(const std::vector<double>& t, const std::vector<double>& x, double omega,
+                             double& amplitude, double& phase, double& offset)
 {
-    setMode(VOCAB_CM_POSITION);
-    goHome();
-    setMode(VOCAB_CM_POSITION_DIRECT);
+    // least squares fit of x = a*sin(omega*t) + b*cos(omega*t) + c, solved with the normal equations
+    double A[3][3] = {{0,0,0},{0,0,0},{0,0,0}};
+    double B[3] = {0,0,0};
+    for (size_t k=0; k<t.size(); k++)
+    {
+        double r[3] = {sin(omega*t[k]), cos(omega*t[k]), 1.0};
+        for (int i=0; i<3; i++)
+        {
+            for (int j=0; j<3; j++) A[i][j] += r[i]*r[j];
+            B[i] += r[i]*x[k];
+        }
+    }
+
+    double det = A[0][0]*(A[1][1]*A[2][2]-A[1][2]*A[2][1])
+               - A[0][1]*(A[1][0]*A[2][2]-A[1][2]*A[2][0])
+               + A[0][2]*(A[1][0]*A[2][1]-A[1][1]*A[2][0]);
+    if (fabs(det)<1e-12)
+    {
+        amplitude=0; phase=0; offset=0;
+        return;
+    }
+
+    double sol[3];
+    for (int c=0; c<3; c++)
+    {
+        double M[3][3];
+        for (int i=0; i<3; i++)
+            for (int j=0; j<3; j++)
+                M[i][j] = (j==c) ? B[i] : A[i][j];
+        sol[c] = (M[0][0]*(M[1][1]*M[2][2]-M[1][2]*M[2][1])
+                - M[0][1]*(M[1][0]*M[2][2]-M[1][2]*M[2][0])
+                + M[0][2]*(M[1][0]*M[2][1]-M[1][1]*M[2][0]))/det;
+    }
+
+    amplitude = sqrt(sol[0]*sol[0]+sol[1]*sol[1]);
+    phase = atan2(sol[1],sol[0]);
+    offset = sol[2];
+}
+
+void PositionDirect::trackingMetrics(int i, double& lag, double& ratio, double& rms)
+{
+    const double omega = 2*M_PI*frequency;
+    double cmd_amplitude, cmd_phase, cmd_offset;
+    double enc_amplitude, enc_phase, enc_offset;
+    fitSine(cmdTimes, cmdValues, omega, cmd_amplitude, cmd_phase, cmd_offset);
+    fitSine(encTimes, encValues[i], omega, enc_amplitude, enc_phase, enc_offset);
+
+    lag = (cmd_phase-enc_phase)*180.0/M_PI;
+    while (lag>180.0)   lag-=360.0;
+    while (lag<=-180.0) lag+=360.0;
+    ratio = (cmd_amplitude>0) ? enc_amplitude/cmd_amplitude : 0;
+
+    // the encoder sample k is read right after the command k: compare it with the command held by the joint
+    double sq_err=0;
+    int n_err=0;
+    for (size_t k=0; k<encTimes.size(); k++)
+    {
+        if (encTimes[k]-encTimes[0] < 1.0/frequency) continue;
+        double e = encValues[i][k]-cmdValues[k];
+        sq_err+=e*e;
+        n_err++;
+    }
+    rms = (n_err>0) ? sqrt(sq_err/n_err) : 0;
+}
+
+void PositionDirect::checkTracking()
+{
+    const double omega = 2*M_PI*frequency;
+    size_t n_cmd = cmdTimes.size();
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(n_cmd>3, "Not enough commands recorded to evaluate the tracking");
+
+    double cmd_amplitude, cmd_phase, cmd_offset;
+    fitSine(cmdTimes, cmdValues, omega, cmd_amplitude, cmd_phase, cmd_offset);
+
+    ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Commands sent: %d (%d failed), missed deadlines: %d, max lateness: %.2f ms, command amplitude: %.3f deg",
+                                                       (int)n_cmd, failedCmds, missedDeadlines, maxLateness*1000.0, cmd_amplitude));
+    if (maxMissedDeadlines>=0)
+    {
+        ROBOTTESTINGFRAMEWORK_TEST_CHECK(missedDeadlines<=maxMissedDeadlines,
+                                         Asserter::format("Missed deadlines %d (max %d)", missedDeadlines, maxMissedDeadlines));
+    }
+
+    for (int i=0; i<n_cmd_joints; i++)
+    {
+        double lag, ratio, rms;
+        trackingMetrics(i, lag, ratio, rms);
+        double delay = lag/(360.0*frequency);
+
+        ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Joint %d: phase lag %+.2f deg (%.1f ms), amplitude ratio %.3f (%+.2f dB), rms tracking error %.4f deg",
+                                                           jointsList[i], lag, delay*1000.0, ratio, (ratio>0) ? 20*log10(ratio) : -INFINITY, rms));
+        if (maxPhaseLag>=0)
+        {
+            ROBOTTESTINGFRAMEWORK_TEST_CHECK(fabs(lag)<=maxPhaseLag,
+                                             Asserter::format("Joint %d phase lag %.2f deg (max %.2f)", jointsList[i], lag, maxPhaseLag));
+        }
+        if (minAmplitudeRatio>=0)
+        {
+            ROBOTTESTINGFRAMEWORK_TEST_CHECK(ratio>=minAmplitudeRatio,
+                                             Asserter::format("Joint %d amplitude ratio %.3f (min %.3f)", jointsList[i], ratio, minAmplitudeRatio));
+        }
+        if (maxTrackingError>=0)
+        {
+            ROBOTTESTINGFRAMEWORK_TEST_CHECK(rms<=maxTrackingError,
+                                             Asserter::format("Joint %d rms tracking error %.4f deg (max %.4f)", jointsList[i], rms, maxTrackingError));
+        }
+    }
+}
+
+double PositionDirect::reference(double t)
+{
+    if (excitation==chirp)
+    {
+        // logarithmic chirp from minFrequency to maxFrequency in excitationDuration seconds
+        double k = maxFrequency/minFrequency;
+        double phase = 2*M_PI*minFrequency*excitationDuration/log(k)*(pow(k,t/excitationDuration)-1.0);
+        return amplitude*sin(phase)+zero;
+    }
+    if (excitation==multisine)
+    {
+        // shifted so that the signal starts from zero, the offset does not matter for the identification
+        double value=0;
+        for (size_t i=0; i<multisineFreqs.size(); i++)
+            value+=sin(2*M_PI*multisineFreqs[i]*t+multisinePhases[i])-sin(multisinePhases[i]);
+        return multisineScale*value+zero;
+    }
+    return amplitude*sin(2*M_PI*frequency*t)+zero;
+}
+
+void PositionDirect::prepareMultisine()
+{
+    // log spaced frequencies, rounded to the bins of a signal of period excitationDuration
+    multisineFreqs.clear();
+    multisinePhases.clear();
+    int n = bodePoints*2;
+    for (int i=0; i<n; i++)
+    {
+        double f = minFrequency*pow(maxFrequency/minFrequency,(double)i/(n-1));
+        double bin = std::max(1.0,floor(f*excitationDuration+0.5))/excitationDuration;
+        if (multisineFreqs.empty() || bin>multisineFreqs.back()) multisineFreqs.push_back(bin);
+    }
+
+    // Schroeder phases keep the crest factor low
+    int m = multisineFreqs.size();
+    for (int i=0; i<m; i++) multisinePhases.push_back(-M_PI*i*(i+1)/m);
+
+    // scale the signal so that its peak is equal to the amplitude
+    multisineScale=1.0;
+    double peak=0;
+    double saved_zero=zero;
+    zero=0;
+    for (double t=0; t<excitationDuration; t+=sampleTime)
+        peak = std::max(peak,fabs(reference(t)));
+    zero=saved_zero;
+    multisineScale = (peak>0) ? amplitude/peak : 1.0;
+}
+
+void PositionDirect::fft(std::vector<std::complex<double> >& x)
+{
+    // iterative radix-2 Cooley-Tukey, the size must be a power of two
+    size_t n = x.size();
+    for (size_t i=1, j=0; i<n; i++)
+    {
+        size_t bit = n>>1;
+        for (; j&bit; bit>>=1) j^=bit;
+        j^=bit;
+        if (i<j) std::swap(x[i],x[j]);
+    }
+    for (size_t len=2; len<=n; len<<=1)
+    {
+        std::complex<double> wlen(cos(-2*M_PI/len),sin(-2*M_PI/len));
+        for (size_t i=0; i<n; i+=len)
+        {
+            std::complex<double> w(1.0,0.0);
+            for (size_t k=0; k<len/2; k++)
+            {
+                std::complex<double> u = x[i+k];
+                std::complex<double> v = x[i+k+len/2]*w;
+                x[i+k] = u+v;
+                x[i+k+len/2] = u-v;
+                w*=wlen;
+            }
+        }
+    }
+}
+
+void PositionDirect::identifyBandwidth()
+{
+    // resample the encoders on the uniform grid of the command deadlines
+    size_t n_grid = (size_t)(excitationDuration/sampleTime);
+    size_t n_fft = 1;
+    while (n_fft<n_grid) n_fft<<=1;
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(encTimes.size()>1 && n_grid>1, "Not enough samples recorded to identify the frequency response");
+
+    std::vector<std::complex<double> > U(n_fft), Y(n_fft);
+    for (size_t k=0; k<n_grid; k++) U[k] = reference(k*sampleTime)-zero;
+    fft(U);
+
+    std::string filename = "positionDirect_bode_"+partName+".txt";
+    FILE* file = fopen(filename.c_str(),"w");
+    if (file) fprintf(file,"#joint frequency[Hz] magnitude[dB] phase[deg]\n");
+
+    double df = 1.0/(n_fft*sampleTime);
+    for (int i=0; i<n_cmd_joints; i++)
+    {
+        size_t s=0;
+        for (size_t k=0; k<n_fft; k++)
+        {
+            double t = k*sampleTime;
+            if (k>=n_grid)
+            {
+                Y[k]=0;
+                continue;
+            }
+            while (s+2<encTimes.size() && encTimes[s+1]<t) s++;
+            double alpha = (encTimes[s+1]>encTimes[s]) ? (t-encTimes[s])/(encTimes[s+1]-encTimes[s]) : 0;
+            alpha = std::max(0.0,std::min(1.0,alpha));
+            Y[k] = encValues[i][s]+alpha*(encValues[i][s+1]-encValues[i][s])-zero;
+        }
+        fft(Y);
+
+        // H1 estimate averaged on log spaced bands between minFrequency and maxFrequency
+        ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Joint %d frequency response:", jointsList[i]));
+        //bandwidth stays -1 if the magnitude never drops below -3 dB, prev_f is the highest band actually measured
+        double bandwidth=-1;
+        double prev_f=0, prev_mag=0;
+        for (int b=0; b<bodePoints; b++)
+        {
+            double f_lo = minFrequency*pow(maxFrequency/minFrequency,(double)b/bodePoints);
+            double f_hi = minFrequency*pow(maxFrequency/minFrequency,(double)(b+1)/bodePoints);
+            std::complex<double> cross(0,0);
+            double power=0;
+            for (size_t k=(size_t)ceil(f_lo/df); k<n_fft/2 && k*df<f_hi; k++)
+            {
+                cross+=Y[k]*std::conj(U[k]);
+                power+=std::norm(U[k]);
+            }
+            if (power<=0) continue;
+
+            std::complex<double> H = cross/power;
+            double f = sqrt(f_lo*f_hi);
+            double mag = 20*log10(std::abs(H));
+            double phase = std::arg(H)*180.0/M_PI;
+            ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("  %7.3f Hz: %+7.2f dB %+8.2f deg", f, mag, phase));
+            if (file) fprintf(file,"%d %f %f %f\n", jointsList[i], f, mag, phase);
+
+            if (bandwidth<0 && mag<-3.0)
+            {
+                // interpolate the -3 dB crossing on the log frequency axis
+                if (prev_f>0 && prev_mag!=mag) bandwidth = prev_f*pow(f/prev_f,(prev_mag+3.0)/(prev_mag-mag));
+                else bandwidth = f;
+            }
+            prev_f=f;
+            prev_mag=mag;
+        }
+
+        if (bandwidth>0)
+        {
+            ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Joint %d -3 dB bandwidth: %.3f Hz", jointsList[i], bandwidth));
+            if (minBandwidth>=0)
+            {
+                ROBOTTESTINGFRAMEWORK_TEST_CHECK(bandwidth>=minBandwidth,
+                                                 Asserter::format("Joint %d bandwidth %.3f Hz (min %.3f Hz)", jointsList[i], bandwidth, minBandwidth));
+            }
+        }
+        else if (prev_f>0)
+        {
+            // the bandwidth is only known to be above the highest measured band, it passes only if that is enough
+            ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Joint %d -3 dB bandwidth: above %.3f Hz", jointsList[i], prev_f));
+            if (minBandwidth>=0)
+            {
+                ROBOTTESTINGFRAMEWORK_TEST_CHECK(prev_f>=minBandwidth,
+                                                 Asserter::format("Joint %d bandwidth above %.3f Hz (min %.3f Hz)", jointsList[i], prev_f, minBandwidth));
+            }
+        }
+        else
+        {
+            ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Joint %d -3 dB bandwidth: not measured, no excitation power between %.3f and %.3f Hz", jointsList[i], minFrequency, maxFrequency));
+            if (minBandwidth>=0)
+            {
+                ROBOTTESTINGFRAMEWORK_TEST_CHECK(false, Asserter::format("Joint %d bandwidth not measured (min %.3f Hz)", jointsList[i], minBandwidth));
+            }
+        }
+    }
+
+    if (file) fclose(file);
+}
+
+void PositionDirect::stream(double period, double duration)
+{
+    // preallocate the recorded streams, so that the loop does not allocate memory
+    size_t n_samples = (size_t)(duration/period)+10;
+    cmdTimes.clear();  cmdTimes.reserve(n_samples);
+    cmdValues.clear(); cmdValues.reserve(n_samples);
+    encTimes.clear();  encTimes.reserve(n_samples);
+    encValues.assign(n_cmd_joints, std::vector<double>());
+    for (int i=0; i<n_cmd_joints; i++) encValues[i].reserve(n_samples);
+    missedDeadlines=0;
+    maxLateness=0;
+    failedCmds=0;
+    encUpdates=0;
+
+    // the joints that are not tested hold their position when the all joints method is used
+    ienc->getEncoders(cmd_tot);
+    // the encoder updates are counted by a dedicated reader, so that their rate is not limited by the command rate
+    EncoderStampReader reader(ienct, n_part_joints, jointsList[0], 0.001);
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(reader.start(), "Unable to start the encoder reader thread");
 
     double start_time = yarp::os::Time::now();
     const double max_step = 2.0;
-    prev_cmd=cmd_single = amplitude*sin(0.0)+zero;
+    prev_cmd=cmd_single = reference(0.0);
+    long int tick=0;
     while(1)
     {
-        double curr_time = yarp::os::Time::now();
-        double elapsed = curr_time-start_time;
-        cmd_single = amplitude*(2*3.14159265359*frequency*elapsed)+zero;
+        // wait for the deadline of the current tick
+        double deadline = start_time+tick*period;
+        double now = yarp::os::Time::now();
+        if (deadline>now) yarp::os::Time::delay(deadline-now);
+
+        double cmd_time = yarp::os::Time::now();
+        double lateness = cmd_time-deadline;
+        if (lateness>maxLateness) maxLateness=lateness;
+        if (lateness>deadlineTolerance*period) missedDeadlines++;
+
+        double elapsed = deadline-start_time;
+        cmd_single = reference(elapsed);
 
         ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(fabs(prev_cmd-cmd_single)<max_step,
                             Asserter::format("error in signal generation: previous: %+6.3f current: %+6.3f max step:  %+6.3f",
                                              prev_cmd,cmd_single,max_step));
-        ienc->getEncoders(pos_tot);
-        executeCmd();
-        //printf("%+6.3f %f\n",elapsed, cmd);
-        yarp::os::Time::delay(sampleTime);
-        if (elapsed*frequency>cycles) break;
+        if (!executeCmd()) failedCmds++;
+        cmdTimes.push_back(cmd_time-start_time);
+        cmdValues.push_back(cmd_single);
+
+        ienct->getEncodersTimed(pos_tot,stamp_tot);
+        encTimes.push_back(yarp::os::Time::now()-start_time);
+        for (int i=0; i<n_cmd_joints; i++) encValues[i].push_back(pos_tot[jointsList[i]]);
+
+        // on overrun, the ticks whose deadline already passed are skipped and counted as missed
+        tick++;
+        now = yarp::os::Time::now();
+        if (now>start_time+(tick+1)*period)
+        {
+            long int skipped = (long int)((now-start_time)/period)-tick;
+            missedDeadlines+=skipped;
+            tick+=skipped;
+        }
+        if (elapsed>duration) break;
+    }
+    reader.stop();
+    encUpdates=reader.updates();
+}
+
+void PositionDirect::runBenchmark()
+{
+    static const char* mode_names[] = {"single_joint", "all_joints", "some_joints"};
+
+    std::string filename = "positionDirect_benchmark_"+partName+".txt";
+    FILE* file = fopen(filename.c_str(),"w");
+    if (file) fprintf(file,"#mode period[s] cmd_rate[Hz] enc_rate[Hz] latency[ms] missed failed\n");
+
+    for (size_t m=0; m<benchModes.size(); m++)
+    {
+        cmd_mode = (cmd_mode_t) benchModes[m];
+        if (cmd_mode==all_joints && n_part_joints!=n_cmd_joints)
+        {
+            ROBOTTESTINGFRAMEWORK_TEST_REPORT("Skipping all_joints mode: the joints parameter does not include all the joints of the part");
+            continue;
+        }
+
+        ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Benchmarking %s method", mode_names[cmd_mode]));
+        for (size_t p=0; p<benchPeriods.size(); p++)
+        {
+            setMode(VOCAB_CM_POSITION);
+            goHome();
+            setMode(VOCAB_CM_POSITION_DIRECT);
+
+            stream(benchPeriods[p],benchDuration);
+
+            double duration = cmdTimes.back()-cmdTimes.front();
+            double cmd_rate = (duration>0) ? (cmdTimes.size()-1)/duration : 0;
+            double enc_rate = (duration>0) ? encUpdates/duration : 0;
+            double latency=0;
+            for (int i=0; i<n_cmd_joints; i++)
+            {
+                double lag, ratio, rms;
+                trackingMetrics(i,lag,ratio,rms);
+                latency+=lag/(360.0*frequency);
+            }
+            latency/=n_cmd_joints;
+            int dropped = missedDeadlines+failedCmds;
+
+            ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("  period %5.1f ms: commands %7.1f Hz (nominal %7.1f Hz), encoders %7.1f Hz, command-to-state latency %6.1f ms, dropped %d (missed %d, failed %d)",
+                                                               benchPeriods[p]*1000.0, cmd_rate, 1.0/benchPeriods[p], enc_rate,
+                                                               latency*1000.0, dropped, missedDeadlines, failedCmds));
+            if (file) fprintf(file,"%s %f %f %f %f %d %d\n", mode_names[cmd_mode], benchPeriods[p], cmd_rate, enc_rate,
+                              latency*1000.0, missedDeadlines, failedCmds);
+        }
+    }
+
+    if (file) fclose(file);
+    setMode(VOCAB_CM_POSITION);
+    goHome();
+}
+
+void PositionDirect::run()
+{
+    setMode(VOCAB_CM_POSITION);
+    goHome();
+
+    if (benchmark)
+    {
+        runBenchmark();
+        return;
     }
 
+    setMode(VOCAB_CM_POSITION_DIRECT);
+    stream(sampleTime,(excitation==sine) ? cycles/frequency : excitationDuration);
+
     setMode(VOCAB_CM_POSITION);
     goHome();
+
+    if (excitation==sine) checkTracking();
+    else identifyBandwidth();
 }
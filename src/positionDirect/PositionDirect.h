@@ -21,16 +21,61 @@
 #ifndef _POSITIONDIRECT_H_
 #define _POSITIONDIRECT_H_
 
+#include <complex>
 #include <string>
+#include <vector>
+#include <yarp/os/PeriodicThread.h>
 #include <yarp/robottestingframework/TestCase.h>
 #include <yarp/dev/ControlBoardInterfaces.h>
 #include <yarp/dev/PolyDriver.h>
 
+/**
+* Reads the timed encoders on its own thread, faster than the command period, and counts the distinct timestamps of a joint,
+* so that the rate of the encoder updates is measured independently of the rate of the commands.
+*/
+class EncoderStampReader : public yarp::os::PeriodicThread
+{
+public:
+    EncoderStampReader(yarp::dev::IEncodersTimed* ienc, int n_part_joints, int joint, double period);
+
+    int updates() const { return m_updates; }
+
+    bool threadInit() override;
+    void run() override;
+
+private:
+    yarp::dev::IEncodersTimed*  m_ienc;
+    std::vector<double>         m_encoders;
+    std::vector<double>         m_stamps;
+    int    m_joint;
+    double m_last_stamp;
+    int    m_updates;
+};
+
 /**
 * \ingroup icub-tests
 * This tests checks the positionDirect control, sending a sinusoidal reference signal, with parametric frequency and amplitude.
 * The sample time, typical in the range of 10 ms, can be also be adjusted by the user.
-* This test currently does not return any error report. It simply moves a joint, and the user visually evaluates the smoothness of the performed trajectory. In the future automatic checks/plots may be added to the test.
+* The reference is streamed by a fixed-rate scheduler which records the timestamp of each command. At the end of the test a sinusoid at the
+* reference frequency is fitted to the command and to the encoder streams, and the following quantities are computed for each joint:
+* \li the phase lag of the encoders with respect to the command (deg, also reported as a delay in ms);
+* \li the amplitude attenuation (ratio between the encoder and the command amplitude);
+* \li the RMS tracking error between the last command sent and the encoder reading (the first period is skipped);
+* \li the number of missed command deadlines, i.e. commands sent later than deadlineTolerance*sampleTime or skipped because of an overrun.
+*
+* Each quantity is checked against its threshold, if the threshold is given in the configuration file.
+*
+* With benchmark=1 the test measures the maximum sustainable command rate instead: for each method in benchmarkModes and for each
+* period in benchmarkPeriods the sine is streamed for benchmarkDuration seconds, and the achieved command rate, the rate at which the
+* encoder timestamps change (read by a separate thread every millisecond, see EncoderStampReader), the command-to-state latency (the phase lag converted to time) and the dropped commands (missed deadlines
+* and failed calls) are reported. The resulting rate/latency curve is also saved in positionDirect_benchmark_<part>.txt.
+* In this mode cmdMode is ignored, single_joint is tested also with several joints, and all_joints is skipped if joints does not list all the joints of the part.
+*
+* With excitation=chirp (logarithmic chirp) or excitation=multisine (log spaced sines with Schroeder phases) the reference spans the band
+* [minFrequency, maxFrequency] for excitationDuration seconds. The closed loop frequency response of each joint is estimated with an FFT of
+* the command and of the encoders resampled at the command deadlines, averaged on bodePoints log spaced bands. The resulting Bode table
+* and the -3 dB bandwidth are reported and saved in positionDirect_bode_<part>.txt. If the magnitude stays above -3 dB up to the highest
+* band, the bandwidth is only known to be above that band; if no band is excited, the bandwidth is not measured and the minBandwidth check fails.
 * Be aware theat may exists set of parameters (e.g. high values of sample time / ampiltude /frequency) that may lead to PID instability and damage the joint.
 * The test is able to check all the three types of yarp methods (single joint, multi joint, all joints), depending on the value of cmdMode Parameter.
 
@@ -53,7 +98,22 @@
 * | amplitude          | double | deg   | -     | Yes | The ampiltude of the sine reference signal | |
 * | tolerance          | double | deg   | -     | Yes | The tolerance used when moving from min to max reference position and viceversa | |
 * | sampleTime         | double | s     | -     | Yes | The sample time of the control thread | |
-* | cmdMode            | int    | deg   | -     | Yes | = 0 to test single joint method, = 1 to test all joints, = 2 to test multi joint method | |
+* | cmdMode            | int    | -     | 2     | No  | = 0 to test single joint method, = 1 to test all joints, = 2 to test multi joint method | ignored with benchmark=true |
+* | deadlineTolerance  | double | -     | 0.5   | No  | A command is late if it is sent more than deadlineTolerance*sampleTime after its deadline | |
+* | maxPhaseLag        | double | deg   | -     | No  | The maximum phase lag between encoders and command | if not given the check is not performed |
+* | minAmplitudeRatio  | double | -     | -     | No  | The minimum ratio between encoder and command amplitude | if not given the check is not performed |
+* | maxTrackingError   | double | deg   | -     | No  | The maximum RMS tracking error | if not given the check is not performed |
+* | maxMissedDeadlines | int    | -     | -     | No  | The maximum number of missed command deadlines | if not given the check is not performed |
+* | benchmark          | bool   | -     | false | No  | Run the command rate benchmark instead of the tracking test | |
+* | benchmarkPeriods   | vector of doubles | s | (0.020 0.010 0.005 0.002 0.001) | No | The command periods to be tested | |
+* | benchmarkModes     | vector of ints | - | (0 2 1) | No | The methods to be tested, same values of cmdMode | |
+* | benchmarkDuration  | double | s     | 5.0   | No  | The streaming duration for each period | |
+* | excitation         | string | -     | sine  | No  | The reference signal: sine, chirp or multisine | |
+* | minFrequency       | double | Hz    | 0.1   | No  | The lowest frequency of the chirp/multisine | |
+* | maxFrequency       | double | Hz    | 5.0   | No  | The highest frequency of the chirp/multisine | must be below 0.5/sampleTime |
+* | excitationDuration | double | s     | 20.0  | No  | The duration of the chirp/multisine | |
+* | bodePoints         | int    | -     | 20    | No  | The number of frequency bands of the Bode table | |
+* | minBandwidth       | double | Hz    | -     | No  | The minimum -3 dB bandwidth | if not given the check is not performed, it fails if the bandwidth is not measured |
 *
 */
 
@@ -69,8 +129,19 @@ public:
     virtual void run();
 
     void goHome();
-    void executeCmd();
+    bool executeCmd();
     void setMode(int desired_mode);
+    void stream(double period, double duration);
+    void trackingMetrics(int i, double& lag, double& ratio, double& rms);
+    void checkTracking();
+    void runBenchmark();
+    double reference(double t);
+    void prepareMultisine();
+    void identifyBandwidth();
+
+    static void fitSine(const std::vector<double>& t, const std::vector<double>& x, double omega,
+                        double& amplitude, double& phase, double& offset);
+    static void fft(std::vector<std::complex<double> >& x);
 
 private:
     std::string robotName;
@@ -96,6 +167,7 @@ private:
     yarp::dev::IControlMode     *icmd;
     yarp::dev::IInteractionMode  *iimd;
     yarp::dev::IEncoders         *ienc;
+    yarp::dev::IEncodersTimed    *ienct;
     yarp::dev::IPositionDirect   *idir;
 
     double  cmd_single;
@@ -103,8 +175,45 @@ private:
     double* cmd_some;
 
     double* pos_tot;
+    double* stamp_tot;
 
     double prev_cmd;
+
+    double deadlineTolerance;
+    double maxPhaseLag;
+    double minAmplitudeRatio;
+    double maxTrackingError;
+    int    maxMissedDeadlines;
+    int    missedDeadlines;
+    double maxLateness;
+    int    failedCmds;
+    int    encUpdates;
+
+    bool   benchmark;
+    double benchDuration;
+    std::vector<double> benchPeriods;
+    std::vector<int>    benchModes;
+
+    enum excitation_t
+    {
+      sine = 0,
+      chirp = 1,
+      multisine = 2
+    } excitation;
+    double minFrequency;
+    double maxFrequency;
+    double excitationDuration;
+    int    bodePoints;
+    double minBandwidth;
+    double multisineScale;
+    std::vector<double> multisineFreqs;
+    std::vector<double> multisinePhases;
+
+    // streams recorded by the scheduler, preallocated in run()
+    std::vector<double> cmdTimes;
+    std::vector<double> cmdValues;
+    std::vector<double> encTimes;
+    std::vector<std::vector<double> > encValues;
 };
 
 #endif //_PositionDirect_H
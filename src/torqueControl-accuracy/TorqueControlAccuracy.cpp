@@ -25,7 +25,7 @@
 #include <yarp/os/Property.h>
 #include <fstream>
 #include <algorithm>
-#include <cstdlib>
+#include <cmath>
 
 #include "TorqueControlAccuracy.h"
 
@@ -47,6 +47,11 @@ TorqueControlAccuracy::TorqueControlAccuracy() : yarp::robottestingframework::Te
     iimd=0;
     ienc=0;
     itrq=0;
+    m_step_duration=4;
+    m_max_rise_time=-1;
+    m_max_overshoot=-1;
+    m_max_rms_error=-1;
+    m_min_bandwidth=-1;
 }
 
 TorqueControlAccuracy::~TorqueControlAccuracy() { }
@@ -77,6 +82,19 @@ bool TorqueControlAccuracy::setup(yarp::os::Property& property) {
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF(m_n_cmd_joints>0, "invalid number of joints, it must be >0");
 
     m_step = property.find("step").asFloat64();
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF(m_step!=0, "invalid step");
+
+    if(property.check("step_duration"))
+      {m_step_duration = property.find("step_duration").asFloat64();}
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF(m_step_duration>1.0, "invalid step_duration, it must be >1s");
+    if(property.check("max_rise_time"))
+      {m_max_rise_time = property.find("max_rise_time").asFloat64();}
+    if(property.check("max_overshoot"))
+      {m_max_overshoot = property.find("max_overshoot").asFloat64();}
+    if(property.check("max_rms_error"))
+      {m_max_rms_error = property.find("max_rms_error").asFloat64();}
+    if(property.check("min_bandwidth"))
+      {m_min_bandwidth = property.find("min_bandwidth").asFloat64();}
 
     m_cycles = property.find("cycles").asInt32();
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF(m_cycles>0, "invalid cycles");
@@ -84,6 +102,11 @@ bool TorqueControlAccuracy::setup(yarp::os::Property& property) {
     m_sampleTime = property.find("sampleTime").asFloat64();
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF(m_sampleTime>0, "invalid sampleTime");
 
+    size_t n_samples = (size_t)(m_step_duration/m_sampleTime)+10;
+    m_time.reserve(n_samples);
+    m_trq.reserve(n_samples);
+    m_cmd.reserve(n_samples);
+
     Property options;
     options.put("device", "remote_controlboard");
     options.put("remote", "/" + m_robotName + "/" + m_partName);
@@ -184,10 +207,94 @@ bool TorqueControlAccuracy::goHome()
     return true;
 }
 
+TorqueControlAccuracy::stepResponse TorqueControlAccuracy::computeStepResponse(double time_zero)
+{
+    stepResponse r;
+    r.rise_time = std::nan("");
+    r.overshoot = 0;
+    r.rms_error = 0;
+    r.bandwidth = std::nan("");
+
+    double t10 = std::nan("");
+    double t90 = std::nan("");
+    double y_max = 0;
+    double err_sum = 0;
+    int    err_n = 0;
+
+    for (size_t k = 0; k < m_time.size(); k++)
+    {
+        if (m_time[k] < time_zero) continue;
+
+        // torque normalized with respect to the step, so that also negative steps are handled
+        double y = m_trq[k] / m_step;
+        if (std::isnan(t10) && y >= 0.1) t10 = m_time[k];
+        if (std::isnan(t90) && y >= 0.9) t90 = m_time[k];
+        if (y > y_max) y_max = y;
+
+        double err = m_cmd[k] - m_trq[k];
+        err_sum += err * err;
+        err_n++;
+    }
+
+    if (!std::isnan(t10) && !std::isnan(t90)) r.rise_time = t90 - t10;
+    // the rise time cannot be measured below one sample
+    if (!std::isnan(r.rise_time)) r.bandwidth = 0.35 / std::max(r.rise_time, m_sampleTime);
+    r.overshoot = std::max(0.0, (y_max - 1.0) * 100.0);
+    if (err_n > 0) r.rms_error = sqrt(err_sum / err_n);
+    return r;
+}
+
+void TorqueControlAccuracy::checkStepResponses(int joint, const std::vector<stepResponse>& responses)
+{
+    // mean and standard deviation of each quantity, the cycles where a quantity is not defined are skipped
+    double mean[4] = {0, 0, 0, 0};
+    double std_dev[4] = {0, 0, 0, 0};
+    int    n[4] = {0, 0, 0, 0};
+    for (size_t c = 0; c < responses.size(); c++)
+    {
+        double v[4] = {responses[c].rise_time, responses[c].overshoot, responses[c].rms_error, responses[c].bandwidth};
+        for (int q = 0; q < 4; q++)
+        {
+            if (std::isnan(v[q])) continue;
+            mean[q] += v[q];
+            std_dev[q] += v[q] * v[q];
+            n[q]++;
+        }
+    }
+    for (int q = 0; q < 4; q++)
+    {
+        if (n[q] == 0) { mean[q] = std::nan(""); std_dev[q] = std::nan(""); continue; }
+        mean[q] /= n[q];
+        std_dev[q] = sqrt(std::max(0.0, std_dev[q] / n[q] - mean[q] * mean[q]));
+    }
+
+    ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Joint %d: rise time %.3f+-%.3f s, overshoot %.2f+-%.2f %%, rms error %.4f+-%.4f Nm, bandwidth %.2f+-%.2f Hz",
+                                                       joint, mean[0], std_dev[0], mean[1], std_dev[1], mean[2], std_dev[2], mean[3], std_dev[3]));
+    ROBOTTESTINGFRAMEWORK_TEST_CHECK(n[0] == (int)responses.size(), Asserter::format("Joint %d reached 90%% of the step in %d/%d cycles", joint, n[0], (int)responses.size()));
+
+    if (m_max_rise_time >= 0)
+        ROBOTTESTINGFRAMEWORK_TEST_CHECK(mean[0] <= m_max_rise_time, Asserter::format("Joint %d rise time %.3f s (max %.3f s)", joint, mean[0], m_max_rise_time));
+    if (m_max_overshoot >= 0)
+        ROBOTTESTINGFRAMEWORK_TEST_CHECK(mean[1] <= m_max_overshoot, Asserter::format("Joint %d overshoot %.2f %% (max %.2f %%)", joint, mean[1], m_max_overshoot));
+    if (m_max_rms_error >= 0)
+        ROBOTTESTINGFRAMEWORK_TEST_CHECK(mean[2] <= m_max_rms_error, Asserter::format("Joint %d rms error %.4f Nm (max %.4f Nm)", joint, mean[2], m_max_rms_error));
+    if (m_min_bandwidth >= 0)
+        ROBOTTESTINGFRAMEWORK_TEST_CHECK(mean[3] >= m_min_bandwidth, Asserter::format("Joint %d bandwidth %.2f Hz (min %.2f Hz)", joint, mean[3], m_min_bandwidth));
+}
+
 void TorqueControlAccuracy::run()
 {
     for (int i = 0; i < m_n_cmd_joints; i++)
     {
+        std::string filename = "torqueControlAccuracy_plot_";
+        filename += m_partName;
+        filename += std::to_string(i);
+        filename += ".txt";
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(m_store.open(filename, m_jointsList[i]), "Unable to open " + filename);
+
+        std::vector<stepResponse> responses;
+        responses.reserve(m_cycles);
+
         for (int cycle = 0; cycle < m_cycles; cycle++)
         {
             setMode(VOCAB_CM_POSITION);
@@ -202,8 +309,9 @@ void TorqueControlAccuracy::run()
             ROBOTTESTINGFRAMEWORK_TEST_REPORT(buff);
 
             double time_zero = 0;
-            yarp::os::Bottle      dataToPlotRaw;
-            yarp::os::Bottle      dataToPlotSync;
+            m_time.clear();
+            m_trq.clear();
+            m_cmd.clear();
 
             while (1)
             {
@@ -214,9 +322,9 @@ void TorqueControlAccuracy::run()
                 {
                     m_cmd_single = 0.0;
                 }
-                else if (elapsed > 1.0 && elapsed <= 4.0)
+                else if (elapsed > 1.0 && elapsed <= m_step_duration)
                 {
-                    m_cmd_single = m_zeros[i] + m_step;
+                    m_cmd_single = m_step;
                     if (time_zero == 0) time_zero = elapsed;
                 }
                 else
@@ -228,69 +336,27 @@ void TorqueControlAccuracy::run()
                 itrq->getTorques(m_torques);
                 itrq->setRefTorque(m_jointsList[i], m_cmd_single);
 
-                Bottle& b1 = dataToPlotRaw.addList();
-                b1.addInt32(cycle);
-                b1.addFloat64(elapsed);
-                b1.addFloat64(m_torques[m_jointsList[i]]);
-                b1.addFloat64(m_cmd_single);
+                m_time.push_back(elapsed);
+                m_trq.push_back(m_torques[m_jointsList[i]]);
+                m_cmd.push_back(m_cmd_single);
                 yarp::os::Time::delay(m_sampleTime);
             }
 
-            //reorder data
-            for (int t = 0; t < dataToPlotRaw.size(); t++)
-            {
-                int    cycle = dataToPlotRaw.get(t).asList()->get(0).asInt32();
-                double time = dataToPlotRaw.get(t).asList()->get(1).asFloat64();
-                double val = dataToPlotRaw.get(t).asList()->get(2).asFloat64();
-                double cmd = dataToPlotRaw.get(t).asList()->get(3).asFloat64();
-                Bottle& b1 = dataToPlotSync.addList();
-                b1.addInt32(cycle);
-                b1.addFloat64(time - time_zero);
-                b1.addFloat64(val);
-                b1.addFloat64(cmd);
-            }
+            stepResponse r = computeStepResponse(time_zero);
+            responses.push_back(r);
+            ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("rise time %.3f s, overshoot %.2f %%, rms error %.4f Nm, bandwidth %.2f Hz",
+                                                               r.rise_time, r.overshoot, r.rms_error, r.bandwidth));
 
-            m_dataToSave.append(dataToPlotSync);
+            //time is saved with respect to the instant of the step
+            ROBOTTESTINGFRAMEWORK_TEST_CHECK(m_store.writeSegment(cycle, time_zero, m_time, m_trq, m_cmd), "Unable to save the data of the cycle");
         } //cycle loop
 
-        //save data
-        std::string filename = "torqueControlAccuracy_plot_";
-        filename += m_partName;
-        filename += std::to_string(i);
-        filename += ".txt";
-        saveToFile(filename, m_dataToSave);
+        m_store.close();
+        checkStepResponses(m_jointsList[i], responses);
     } //joint loop
 
     //data acquisition ends here
     setMode(VOCAB_CM_POSITION);
     goHome();
     ROBOTTESTINGFRAMEWORK_TEST_REPORT("Data acquisition complete");
-
-    //plot data
-    /*for (int i = 0; i < m_n_cmd_joints; i++)
-    {
-        std::string filename = "torqueControlAccuracy_plot_";
-        filename += m_partName;
-        filename += std::to_string(i);
-        filename += ".txt";
-        char plotstring[1000];
-        sprintf(plotstring, "gnuplot -e \" unset key; plot for [col=1:%d] '%s' using col with lines \" -persist", m_n_cmd_joints, filename.c_str());
-        system(plotstring);
-    }*/
-}
-
-void TorqueControlAccuracy::saveToFile(std::string filename, yarp::os::Bottle &b)
-{
-    std::fstream fs;
-    fs.open(filename.c_str(), std::fstream::out);
-
-    for (int i = 0; i<b.size(); i++)
-    {
-        std::string s = b.get(i).toString();
-        std::replace(s.begin(), s.end(), '(', ' ');
-        std::replace(s.begin(), s.end(), ')', ' ');
-        fs << s << std::endl;
-    }
-
-    fs.close();
 }
@@ -21,16 +21,26 @@
 #ifndef _TORQUEACCURACY_H_
 #define _TORQUEACCURACY_H_
 
+#include <fstream>
 #include <string>
+#include <vector>
 #include <yarp/robottestingframework/TestCase.h>
 #include <yarp/dev/ControlBoardInterfaces.h>
 #include <yarp/dev/PolyDriver.h>
+#include "CycleDataStore.h"
 
 /**
 * \ingroup icub-tests
 * This tests checks the a torque PID response, sending a step reference signal with a setRefTorque command.
-* This test currently does not return any error report. It simply moves a joint, and saves data to a different file for each joint.
-* The data acquired can be analized with a matalab script to evaluate the torque PID properties.
+* For each cycle the test computes the following quantities of the measured torque after the step:
+* \li rise time: the time to go from 10% to 90% of the step;
+* \li overshoot: the maximum excursion beyond the step, as a percentage of the step;
+* \li rms error: the root mean square of the difference between the reference and the measured torque;
+* \li bandwidth: an estimate of the closed loop bandwidth obtained from the rise time as 0.35/rise_time, i.e. assuming a first order response.
+*
+* At the end of each joint the mean and standard deviation across the cycles are reported, and compared with the optional thresholds.
+* The data acquired are saved to a different file for each joint, and can be analized with a matalab script to evaluate the torque PID properties.
+* Each cycle is written as soon as it is completed, see CycleDataStore for the file format.
 * Be aware that a step greater than 1 Nm may be dangerous for both the robot and the human operator!
 
 * example: testRunner -v -t TorqueControlAccuracy.dll -p "--robot icubSim --part head --joints ""(0 1 2)"" --zeros ""(0 0 0)""  --step 5  --cycles 10 --sampleTime 0.010"
@@ -46,6 +56,11 @@
 * | cycles             | int    | -     | -     | Yes | Each joint will be tested multiple times |   |
 * | step               | double | Nm    | -     | Yes | The amplitude of the step reference signal | Recommended max: 1 Nm! |
 * | sampleTime         | double | s     | -     | Yes | The sample time of the control thread | |
+* | step_duration      | double | s     | 4     | No  | The duration of each cycle, the step is commanded after 1 s | |
+* | max_rise_time      | double | s     | -     | No  | The maximum mean rise time | |
+* | max_overshoot      | double | %     | -     | No  | The maximum mean overshoot | |
+* | max_rms_error      | double | Nm    | -     | No  | The maximum mean rms tracking error after the step | |
+* | min_bandwidth      | double | Hz    | -     | No  | The minimum mean bandwidth estimate | |
 *
 */
 
@@ -63,9 +78,19 @@ public:
     bool goHome();
     void executeCmd();
     void setMode(int desired_mode);
-    void saveToFile(std::string filename, yarp::os::Bottle &b);
 
 private:
+    struct stepResponse
+    {
+        double rise_time;
+        double overshoot;
+        double rms_error;
+        double bandwidth;
+    };
+
+    stepResponse computeStepResponse(double time_zero);
+    void checkStepResponses(int joint, const std::vector<stepResponse>& responses);
+
     std::string m_robotName;
     std::string m_partName;
     int*        m_jointsList;
@@ -73,9 +98,14 @@ private:
     double      m_sampleTime;
     double*     m_zeros;
     double      m_step;
+    double      m_step_duration;
+    double      m_max_rise_time;
+    double      m_max_overshoot;
+    double      m_max_rms_error;
+    double      m_min_bandwidth;
     int         m_n_part_joints;
     int         m_n_cmd_joints;
-    yarp::os::Bottle      m_dataToSave;
+    CycleDataStore        m_store;
 
     yarp::dev::PolyDriver        *dd;
     yarp::dev::IPositionControl *ipos;
@@ -87,6 +117,11 @@ private:
     double  m_cmd_single;
     double* m_encoders;
     double* m_torques;
+
+    // samples of the current cycle, preallocated in setup()
+    std::vector<double> m_time;
+    std::vector<double> m_trq;
+    std::vector<double> m_cmd;
 };
 
 #endif
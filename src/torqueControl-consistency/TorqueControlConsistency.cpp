@@ -37,7 +37,7 @@ using namespace yarp::dev;
 // prepare the plugin
 ROBOTTESTINGFRAMEWORK_PREPARE_PLUGIN(TorqueControlConsistency)
 
-TorqueControlConsistency::TorqueControlConsistency() : yarp::robottestingframework::TestCase("TorqueControlConsistency") {
+TorqueControlConsistency::TorqueControlConsistency() : ConsistencyTestCase("TorqueControlConsistency") {
     jointsList=0;
     pos_tot=0;
     dd=0;
@@ -77,6 +77,9 @@ bool TorqueControlConsistency::setup(yarp::os::Property& property) {
     n_cmd_joints = jointsBottle->size();
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(n_cmd_joints>0,"invalid number of joints, it must be >0");
 
+    if(property.check("latency_samples"))
+        latency_samples = property.find("latency_samples").asInt32();
+
     Property options;
     options.put("device", "remote_controlboard");
     options.put("remote", "/"+robotName+"/"+partName);
@@ -114,6 +117,8 @@ bool TorqueControlConsistency::setup(yarp::os::Property& property) {
     prevcurr_tot=new double[n_part_joints];
     prevcurr_some=new double[n_cmd_joints];
     for (int i=0; i <n_cmd_joints; i++) jointsList[i]=jointsBottle->get(i).asInt32();
+    cmode_some.resize(n_cmd_joints);
+    imode_some.resize(n_cmd_joints);
 
     return true;
 }
@@ -128,32 +133,43 @@ void TorqueControlConsistency::setMode(int desired_control_mode, yarp::dev::Inte
 {
     for (int i=0; i<n_cmd_joints; i++)
     {
-        icmd->setControlMode(jointsList[i],desired_control_mode);
-        iimd->setInteractionMode(jointsList[i],desired_interaction_mode);
-        yarp::os::Time::delay(0.010);
+        cmode_some[i]=desired_control_mode;
+        imode_some[i]=desired_interaction_mode;
     }
+    icmd->setControlModes(n_cmd_joints,jointsList,cmode_some.data());
+    iimd->setInteractionModes(n_cmd_joints,jointsList,imode_some.data());
+    yarp::os::Time::delay(0.010);
 }
 
 void TorqueControlConsistency::verifyMode(int desired_control_mode, yarp::dev::InteractionModeEnum desired_interaction_mode, std::string title)
 {
-    int cmode;
-    yarp::dev::InteractionModeEnum imode;
+    std::vector<int> cmode(n_cmd_joints);
+    std::vector<yarp::dev::InteractionModeEnum> imode(n_cmd_joints);
     int timeout = 0;
 
     while (1)
     {
+        //the modes of all the tested joints are read with one call for each interface
+        double start_time=yarp::os::Time::now();
+        icmd->getControlModes(n_cmd_joints,jointsList,cmode.data());
+        addLatency(api_multi,start_time);
+        start_time=yarp::os::Time::now();
+        iimd->getInteractionModes(n_cmd_joints,jointsList,imode.data());
+        addLatency(api_multi,start_time);
+
         int ok=0;
+        int i_wrong=0;
         for (int i=0; i<n_cmd_joints; i++)
         {
-            icmd->getControlMode (jointsList[i],&cmode);
-            iimd->getInteractionMode(jointsList[i],&imode);
-            if (cmode==desired_control_mode && imode==desired_interaction_mode) ok++;
+            if (cmode[i]==desired_control_mode && imode[i]==desired_interaction_mode) ok++;
+            else i_wrong=i;
         }
         if (ok==n_cmd_joints) break;
         if (timeout>100)
         {
+            int i=i_wrong;
             char sbuf[500];
-            sprintf(sbuf,"Test (%s) failed: current mode is (%d,%d), it should be (%d,%d)",title.c_str(), desired_control_mode,desired_interaction_mode,cmode,imode);
+            sprintf(sbuf,"Test (%s) failed: current mode is (%d,%d), it should be (%d,%d)",title.c_str(), desired_control_mode,desired_interaction_mode,cmode[i],imode[i]);
             ROBOTTESTINGFRAMEWORK_ASSERT_ERROR(sbuf);
         }
         yarp::os::Time::delay(0.2);
@@ -194,11 +210,14 @@ void TorqueControlConsistency::goHome()
 void TorqueControlConsistency::setRefTorque(double value)
 {
     cmd_single=value;
+    double start_time;
     if (cmd_mode==single_joint)
     {
         for (int i=0; i<n_cmd_joints; i++)
         {
+            start_time=yarp::os::Time::now();
             itrq->setRefTorque(jointsList[i],cmd_single);
+            addLatency(api_single,start_time);
         }
     }
     else if (cmd_mode==some_joints)
@@ -206,7 +225,9 @@ void TorqueControlConsistency::setRefTorque(double value)
         //same of single_joint, since multiple joint is not currently supported
         for (int i=0; i<n_cmd_joints; i++)
         {
+            start_time=yarp::os::Time::now();
             itrq->setRefTorque(jointsList[i],cmd_single);
+            addLatency(api_single,start_time);
         }
     }
     else if (cmd_mode==all_joints)
@@ -215,7 +236,9 @@ void TorqueControlConsistency::setRefTorque(double value)
         {
             cmd_tot[i]=cmd_single;
         }
+        start_time=yarp::os::Time::now();
         itrq->setRefTorques(cmd_tot);
+        addLatency(api_all,start_time);
     }
     else
     {
@@ -224,69 +247,23 @@ void TorqueControlConsistency::setRefTorque(double value)
     yarp::os::Time::delay(0.010);
 }
 
+bool TorqueControlConsistency::getRefSingle(int j, double* ref)
+{
+    return itrq->getRefTorque(j,ref);
+}
+
+bool TorqueControlConsistency::getRefAll(double* refs)
+{
+    return itrq->getRefTorques(refs);
+}
+
 void TorqueControlConsistency::verifyRefTorque(double verify_val, std::string title)
 {
-    double value;
-    char sbuf[500];
-    if (cmd_mode==single_joint)
-    {
-        for (int i=0; i<n_cmd_joints; i++)
-        {
-            itrq->getRefTorque(jointsList[i],&value);
-            if (value==verify_val)
-            {
-                sprintf(sbuf,"Test (%s) passed, j%d current reference is (%f)",title.c_str(),i, verify_val);
-                ROBOTTESTINGFRAMEWORK_TEST_REPORT(sbuf);
-            }
-            else
-            {
-                sprintf(sbuf,"Test (%s) failed: current reference is (%f), it should be (%f)",title.c_str(), value, verify_val);
-                ROBOTTESTINGFRAMEWORK_ASSERT_ERROR(sbuf);
-            }
-        }
-    }
-    else if (cmd_mode==some_joints)
-    {
-        //same of single_joint, since multiple joint is not currently supported
-        for (int i=0; i<n_cmd_joints; i++)
-        {
-            itrq->getRefTorque(jointsList[i],&value);
-            if (value==verify_val)
-            {
-                sprintf(sbuf,"Test (%s) passed j%d current reference is (%f)",title.c_str(),i, verify_val);
-                ROBOTTESTINGFRAMEWORK_TEST_REPORT(sbuf);
-            }
-            else
-            {
-                sprintf(sbuf,"Test (%s) failed: current reference is (%f), it should be (%f)",title.c_str(), value, verify_val);
-                ROBOTTESTINGFRAMEWORK_ASSERT_ERROR(sbuf);
-            }
-        }
-    }
-    else if (cmd_mode==all_joints)
-    {
-        int ok=0;
-        itrq->getRefTorques(cmd_tot);
-        for (int i=0; i<n_part_joints; i++)
-        {
-            if (verify_val==cmd_tot[i]) ok++;
-        }
-        if (ok==n_part_joints)
-        {
-            sprintf(sbuf,"Test (%s) passed, current reference is (%f)",title.c_str(), verify_val);
-            ROBOTTESTINGFRAMEWORK_TEST_REPORT(sbuf);
-        }
-        else
-        {
-            sprintf(sbuf,"Test (%s) failed: only %d joints (of %d) are ok",title.c_str(),ok,n_part_joints);
-            ROBOTTESTINGFRAMEWORK_ASSERT_ERROR(sbuf);
-        }
-    }
-    else
-    {
-        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR("Invalid cmd_mode");
-    }
-    yarp::os::Time::delay(0.010);
+    //a single all-joints call is used whatever the command mode, the command mode only affects the setter
+    double start_time=yarp::os::Time::now();
+    itrq->getRefTorques(cmd_tot);
+    addLatency(api_all,start_time);
+    verifyValues(cmd_tot,(cmd_mode==all_joints) ? n_part_joints : n_cmd_joints,(cmd_mode==all_joints) ? 0 : jointsList,verify_val,true,title,"reference");
 }
 
 void TorqueControlConsistency::run()
@@ -315,4 +292,6 @@ void TorqueControlConsistency::run()
     verifyMode(VOCAB_CM_POSITION,VOCAB_IM_STIFF,"test5");
     goHome();
 
+    measureLatencies(icmd,n_part_joints,n_cmd_joints,jointsList,"getRefTorque x joints","getRefTorques(all)");
+    reportLatencies();
 }
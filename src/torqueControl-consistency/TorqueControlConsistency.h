@@ -22,11 +22,13 @@
 #define _TORQUECONTORLCONSISTENCY_H_
 
 #include <string>
-#include <yarp/robottestingframework/TestCase.h>
+#include <vector>
 #include <yarp/dev/ControlBoardInterfaces.h>
 #include <yarp/dev/PolyDriver.h>
 
-class TorqueControlConsistency : public yarp::robottestingframework::TestCase {
+#include "ConsistencyTestCase.h"
+
+class TorqueControlConsistency : public ConsistencyTestCase {
 public:
     TorqueControlConsistency();
     virtual ~TorqueControlConsistency();
@@ -49,6 +51,9 @@ public:
     void resetOriginalCurrentLimits();
 
 private:
+    virtual bool getRefSingle(int j, double* ref);
+    virtual bool getRefAll(double* refs);
+
     std::string robotName;
     std::string partName;
     int* jointsList;
@@ -80,6 +85,9 @@ private:
     double* prevcurr_some;
 
     double* pos_tot;
+
+    std::vector<int> cmode_some;
+    std::vector<yarp::dev::InteractionModeEnum> imode_some;
 };
 
 #endif //_TORQUECONTORLCONSISTENCY_H
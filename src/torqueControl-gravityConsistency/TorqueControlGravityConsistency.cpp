@@ -24,7 +24,10 @@
 #include <robottestingframework/dll/Plugin.h>
 #include <yarp/os/Time.h>
 #include <yarp/os/Property.h>
+#include <yarp/os/Bottle.h>
 #include <yarp/sig/Vector.h>
+#include <yarp/sig/Matrix.h>
+#include <algorithm>
 
 #include "TorqueControlGravityConsistency.h"
 
@@ -37,7 +40,14 @@ using namespace yarp::sig;
 ROBOTTESTINGFRAMEWORK_PREPARE_PLUGIN(TorqueControlGravityConsistency)
 
 TorqueControlGravityConsistency::TorqueControlGravityConsistency() : yarp::robottestingframework::TestCase("TorqueControlGravityConsistency"),
-                                                                     yarpRobot(0)
+                                                                     yarpRobot(0),
+                                                                     dwell(3.0),
+                                                                     window(2.0),
+                                                                     sampleTime(0.01),
+                                                                     postureTolerance(2.0),
+                                                                     postureTimeout(20.0),
+                                                                     maxMeanResidual(-1),
+                                                                     maxResidual(-1)
 {
 
 }
@@ -74,7 +84,7 @@ bool TorqueControlGravityConsistency::setup(yarp::os::Property& property)
         localName = property.find("local").asString();
     }
 
-    wbi::wholeBodyInterface *yarpRobot = new yarpWbi::yarpWholeBodyInterface (localName.c_str(), yarpWbiConfiguration);
+    yarpRobot = new yarpWbi::yarpWholeBodyInterface (localName.c_str(), yarpWbiConfiguration);
 
     wbi::IDList RobotMainJoints;
     std::string RobotMainJointsListName = "ROBOT_TORQUE_CONTROL_JOINTS";
@@ -96,53 +106,178 @@ bool TorqueControlGravityConsistency::setup(yarp::os::Property& property)
 
     Time::delay(0.5);
 
+    if(property.check("dwell"))             dwell = property.find("dwell").asFloat64();
+    if(property.check("window"))            window = property.find("window").asFloat64();
+    if(property.check("sampleTime"))        sampleTime = property.find("sampleTime").asFloat64();
+    if(property.check("posture_tolerance")) postureTolerance = property.find("posture_tolerance").asFloat64();
+    if(property.check("posture_timeout"))   postureTimeout = property.find("posture_timeout").asFloat64();
+    if(property.check("max_mean_residual")) maxMeanResidual = property.find("max_mean_residual").asFloat64();
+    if(property.check("max_residual"))      maxResidual = property.find("max_residual").asFloat64();
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(sampleTime>0 && window>=sampleTime, "invalid sampleTime or window");
+
+    int dof = yarpRobot->getDoFs();
+    postures.clear();
+    if(property.check("postures"))
+    {
+        Bottle* posturesBottle = property.find("postures").asList();
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(posturesBottle!=0, "unable to parse postures parameter");
+        for(size_t p=0; p < posturesBottle->size(); p++)
+        {
+            Bottle* postureBottle = posturesBottle->get(p).asList();
+            ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(postureBottle!=0 && (int)postureBottle->size()==dof,
+                                                        Asserter::format("posture %d must have %d values", (int)p, dof));
+            Vector posture(dof);
+            for(int i=0; i < dof; i++) posture[i] = postureBottle->get(i).asFloat64()*M_PI/180.0;
+            postures.push_back(posture);
+        }
+    }
+
+    q.resize(dof, 0.0);
+    dq.resize(dof, 0.0);
+    trqMeasured.resize(dof, 0.0);
+    qAvg.resize(dof, 0.0);
+    trqAvg.resize(dof, 0.0);
+    trqGravity.resize(dof, 0.0);
+    generalizedBiasForces.resize(dof+6, 0.0);
+    residuals.resize(std::max((int)postures.size(), 1), dof);
+
     return true;
 }
 
 void TorqueControlGravityConsistency::tearDown()
 {
-    yarpRobot->close();
-    delete yarpRobot;
-    yarpRobot = 0;
+    if(yarpRobot)
+    {
+        yarpRobot->close();
+        delete yarpRobot;
+        yarpRobot = 0;
+    }
 }
 
-void TorqueControlGravityConsistency::run()
+bool TorqueControlGravityConsistency::moveTo(const Vector& posture_rad)
 {
-    //Get the number of controlled degrees of freedom of the robot
-    int dof = yarpRobot->getDoFs();
-    printf("Number of (internal) controlled DoFs: %d\n", dof);
+    yarpRobot->setControlMode(wbi::CTRL_MODE_POS, const_cast<double*>(posture_rad.data()));
 
-    //Allocate yarp vector of the right dimensions
-    Vector q(dof), trqMeasured(dof), trqGravity(dof), generalizedBiasForces(dof+6), dq(dof);
+    double start_time = Time::now();
+    while(Time::now()-start_time < postureTimeout)
+    {
+        yarpRobot->getEstimates(wbi::ESTIMATE_JOINT_POS, q.data());
+        double max_error = 0;
+        for(size_t i=0; i < q.size(); i++) max_error = std::max(max_error, fabs(q[i]-posture_rad[i]));
+        if(max_error*180.0/M_PI < postureTolerance) return true;
+        Time::delay(0.1);
+    }
+    return false;
+}
 
-    //Read position and torque estimates
-    yarpRobot->getEstimates(wbi::ESTIMATE_JOINT_POS, q.data());
-    yarpRobot->getEstimates(wbi::ESTIMATE_JOINT_VEL, dq.data());
-    yarpRobot->getEstimates(wbi::ESTIMATE_JOINT_TORQUE, trqMeasured.data());
+void TorqueControlGravityConsistency::measure(Vector& q_avg, Vector& trq_avg)
+{
+    q_avg.zero();
+    trq_avg.zero();
+    int n = 0;
+    double start_time = Time::now();
+    double next_time = start_time;
+    while(Time::now()-start_time < window)
+    {
+        yarpRobot->getEstimates(wbi::ESTIMATE_JOINT_POS, q.data());
+        yarpRobot->getEstimates(wbi::ESTIMATE_JOINT_TORQUE, trqMeasured.data());
+        for(size_t i=0; i < q.size(); i++)
+        {
+            q_avg[i] += q[i];
+            trq_avg[i] += trqMeasured[i];
+        }
+        n++;
+
+        next_time += sampleTime;
+        double wait = next_time-Time::now();
+        if(wait > 0) Time::delay(wait);
+    }
+    if(n > 0)
+    {
+        for(size_t i=0; i < q_avg.size(); i++)
+        {
+            q_avg[i] /= n;
+            trq_avg[i] /= n;
+        }
+    }
+}
 
-    // Compute gravity compensation torques
+void TorqueControlGravityConsistency::computeGravity(const Vector& q_rad)
+{
+    // the posture is static: the bias forces are the gravity torques
     wbi::Frame world2base;
     world2base.identity();
     Vector baseTwist(6);
     baseTwist.zero();
+    dq.zero();
 
     double m_gravity[3];
     m_gravity[0] = 0;
     m_gravity[1] = 0;
     m_gravity[2] = -9.81;
 
-    yarpRobot->computeGeneralizedBiasForces(q.data(),world2base,dq.data(),baseTwist.data(),m_gravity,generalizedBiasForces.data());
+    yarpRobot->computeGeneralizedBiasForces(q_rad.data(),world2base,dq.data(),baseTwist.data(),m_gravity,generalizedBiasForces.data());
 
     // We extract the joint torques from the generalized bias forces
-    trqGravity = generalizedBiasForces.subVector(6,6+dof-1);
+    for(size_t i=0; i < trqGravity.size(); i++) trqGravity[i] = generalizedBiasForces[6+i];
+}
+
+void TorqueControlGravityConsistency::run()
+{
+    //Get the number of controlled degrees of freedom of the robot
+    int dof = yarpRobot->getDoFs();
+    ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Number of (internal) controlled DoFs: %d", dof));
+
+    Vector q_initial(dof);
+    yarpRobot->getEstimates(wbi::ESTIMATE_JOINT_POS, q_initial.data());
 
-    for(size_t i=0; i < dof; i++)
+    int n_postures = postures.empty() ? 1 : (int)postures.size();
+    for(int p=0; p < n_postures; p++)
+    {
+        if(!postures.empty())
+        {
+            ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Moving to posture %d", p));
+            if(!moveTo(postures[p]))
+            {
+                moveTo(q_initial);
+                ROBOTTESTINGFRAMEWORK_ASSERT_FAIL(Asserter::format("Timeout while reaching posture %d", p));
+            }
+            Time::delay(dwell);
+        }
+
+        measure(qAvg, trqAvg);
+        computeGravity(qAvg);
+        for(int i=0; i < dof; i++) residuals(p,i) = trqAvg[i]-trqGravity[i];
+    }
+
+    if(!postures.empty())
+    {
+        ROBOTTESTINGFRAMEWORK_TEST_CHECK(moveTo(q_initial), "Moving back to the initial configuration");
+    }
+
+    for(int i=0; i < dof; i++)
     {
         wbi::ID wbiID;
         yarpRobot->getJointList().indexToID(i,wbiID);
-        std::cerr << "Joint " << wbiID.toString() << " : " << std::endl;
-        std::cerr << "\t Measured torque: " << trqMeasured[i] << "Nm" << std::endl;
-        std::cerr << "\t Gravity  torque: " << trqGravity[i] << "Nm" << std::endl;
-        std::cerr << "\t Difference     : " << trqMeasured[i]-trqGravity[i] << "Nm" << std::endl;
+
+        double sum = 0, sq = 0, max_abs = 0;
+        for(int p=0; p < n_postures; p++)
+        {
+            sum += residuals(p,i);
+            sq += residuals(p,i)*residuals(p,i);
+            max_abs = std::max(max_abs, fabs(residuals(p,i)));
+        }
+        double mean = sum/n_postures;
+        double rms = sqrt(sq/n_postures);
+        double std_dev = sqrt(std::max(0.0, sq/n_postures-mean*mean));
+
+        ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("Joint %s: residual mean %.3f Nm, std %.3f Nm, rms %.3f Nm, max %.3f Nm over %d postures",
+                                                           wbiID.toString().c_str(), mean, std_dev, rms, max_abs, n_postures));
+        if(maxMeanResidual >= 0)
+            ROBOTTESTINGFRAMEWORK_TEST_CHECK(fabs(mean) <= maxMeanResidual,
+                                             Asserter::format("Joint %s mean residual %.3f Nm (max %.3f Nm)", wbiID.toString().c_str(), mean, maxMeanResidual));
+        if(maxResidual >= 0)
+            ROBOTTESTINGFRAMEWORK_TEST_CHECK(max_abs <= maxResidual,
+                                             Asserter::format("Joint %s max residual %.3f Nm (max %.3f Nm)", wbiID.toString().c_str(), max_abs, maxResidual));
     }
 }
@@ -22,6 +22,7 @@
 #define TORQUECONTROLGRAVITYCONSISTENCY_H_
 
 #include <string>
+#include <vector>
 #include <yarp/robottestingframework/TestCase.h>
 #include <yarp/dev/ControlBoardInterfaces.h>
 #include <yarp/dev/PolyDriver.h>
@@ -39,8 +40,28 @@
  * coming from the model and assuming that the gravity is fixed in the based
  * with the joint torques measured by iCub (that actually come from the wholeBodyDynamics(Tree) ).
  *
+ * The robot visits a set of static postures. At each posture it waits for the dwell time, then averages the measured joint
+ * positions and torques over the averaging window, and computes the gravity torques for the averaged posture with
+ * computeGeneralizedBiasForces (zero joint velocities). For each joint the residual (measured - gravity) is reported
+ * across the postures (mean, standard deviation, rms, maximum absolute value) and compared with the optional thresholds.
+ * If no posture is given only the current configuration is checked. At the end the robot is moved back to the initial configuration.
+ *
  * Example: testRunner -v -t TorqueControlGravityConsistency.dll -p ""
  *
+ *  Accepts the following parameters:
+ * | Parameter name     | Type   | Units | Default Value | Required | Description | Notes |
+ * |:------------------:|:------:|:-----:|:-------------:|:--------:|:-----------:|:-----:|
+ * | wbi_conf_file      | string | -     | yarpWholeBodyInterface.ini | No | The configuration file of the wholeBodyInterface | |
+ * | local              | string | -     | wbiTest | No  | The local name of the wholeBodyInterface | |
+ * | postures           | list of vectors of doubles | deg | - | No | The postures to visit, each with one value for each controlled DoF | |
+ * | dwell              | double | s     | 3.0   | No  | The time waited at each posture before averaging | |
+ * | window             | double | s     | 2.0   | No  | The averaging window | |
+ * | sampleTime         | double | s     | 0.01  | No  | The sample time used while averaging | |
+ * | posture_tolerance  | double | deg   | 2.0   | No  | The tolerance to consider a posture reached | |
+ * | posture_timeout    | double | s     | 20.0  | No  | The maximum time to reach a posture | |
+ * | max_mean_residual  | double | Nm    | -     | No  | The maximum absolute mean residual of each joint | |
+ * | max_residual       | double | Nm    | -     | No  | The maximum absolute residual of each joint at any posture | |
+ *
  */
 class TorqueControlGravityConsistency : public yarp::robottestingframework::TestCase
 {
@@ -56,7 +77,30 @@ public:
     virtual void run();
 
 private:
+    bool moveTo(const yarp::sig::Vector& posture_rad);
+    void measure(yarp::sig::Vector& q_avg, yarp::sig::Vector& trq_avg);
+    void computeGravity(const yarp::sig::Vector& q);
+
     yarpWbi::yarpWholeBodyInterface * yarpRobot;
+
+    std::vector<yarp::sig::Vector> postures;    // rad
+    double dwell;
+    double window;
+    double sampleTime;
+    double postureTolerance;
+    double postureTimeout;
+    double maxMeanResidual;
+    double maxResidual;
+
+    // buffers allocated once and reused at each posture
+    yarp::sig::Vector q;
+    yarp::sig::Vector dq;
+    yarp::sig::Vector trqMeasured;
+    yarp::sig::Vector qAvg;
+    yarp::sig::Vector trqAvg;
+    yarp::sig::Vector trqGravity;
+    yarp::sig::Vector generalizedBiasForces;
+    yarp::sig::Matrix residuals;                // postures x dofs
 };
 
 #endif
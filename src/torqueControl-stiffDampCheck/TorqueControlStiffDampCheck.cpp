@@ -62,6 +62,12 @@ TorqueControlStiffDampCheck::TorqueControlStiffDampCheck() : yarp::robottestingf
     n_part_joints=0;
     n_cmd_joints=0;
     plot_enabled = false;
+    automatic = false;
+    excitation_amplitude = 2.0;
+    excitation_frequency = 0.5;
+    tolerance = 0.25;
+    iimp=0;
+    iposd=0;
 }
 
 TorqueControlStiffDampCheck::~TorqueControlStiffDampCheck() { }
@@ -110,7 +116,22 @@ bool TorqueControlStiffDampCheck::setup(yarp::os::Property& property) {
     {
         plot_enabled = property.find("plot_enabled").asBool();
     }
-    if(plot_enabled)
+    if(property.check("automatic"))
+    {
+        automatic = property.find("automatic").asBool();
+    }
+    if(property.check("excitation_amplitude"))
+        excitation_amplitude = property.find("excitation_amplitude").asFloat64();
+    if(property.check("excitation_frequency"))
+        excitation_frequency = property.find("excitation_frequency").asFloat64();
+    if(property.check("tolerance"))
+        tolerance = property.find("tolerance").asFloat64();
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(excitation_frequency>0, "excitation_frequency should be bigger than 0");
+    ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(testLen_sec*excitation_frequency>=1, "duration should contain at least one period of the excitation");
+
+    if(automatic)
+        yInfo() << "Automatic mode: the joints are excited by the test and stiffness and damping are estimated without the user";
+    else if(plot_enabled)
         yInfo() << "Plot is enabled: the test will run octave and plot test result ";
     else
         yInfo() << "Plot is not enabled. The test collects only data. The user need to plot data to theck if test has successed.";
@@ -129,6 +150,8 @@ bool TorqueControlStiffDampCheck::setup(yarp::os::Property& property) {
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(icmd),"Unable to open control mode interface");
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(iimd),"Unable to open interaction mode interface");
     ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(iimp),"Unable to open impedence control interface");
+    if(automatic)
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(dd->view(iposd),"Unable to open position direct interface");
 
 
     if (!ienc->getAxes(&n_part_joints))
@@ -280,7 +303,157 @@ std::string TorqueControlStiffDampCheck::getPath(const std::string& str)
 }
 
 
+bool TorqueControlStiffDampCheck::fitImpedance(const std::vector<double>& err, const std::vector<double>& vel, const std::vector<double>& trq,
+                                               double& stiff, double& damp, double& offset)
+{
+    //normal equations of trq = offset + stiff*err - damp*vel, solved with the Cramer's rule
+    double A[3][3] = {{0,0,0},{0,0,0},{0,0,0}};
+    double b[3] = {0,0,0};
+    for (size_t k=0; k<trq.size(); k++)
+    {
+        double x[3] = {1.0, err[k], -vel[k]};
+        for (int r=0; r<3; r++)
+        {
+            for (int c=0; c<3; c++) A[r][c] += x[r]*x[c];
+            b[r] += x[r]*trq[k];
+        }
+    }
+
+    auto det3 = [](double m[3][3]) {
+        return m[0][0]*(m[1][1]*m[2][2]-m[1][2]*m[2][1])
+              -m[0][1]*(m[1][0]*m[2][2]-m[1][2]*m[2][0])
+              +m[0][2]*(m[1][0]*m[2][1]-m[1][1]*m[2][0]);
+    };
+
+    double det = det3(A);
+    //the excitation must move both the position error and the velocity
+    if (fabs(det) < 1e-12 || trq.size() < 3) return false;
+
+    double sol[3];
+    for (int c=0; c<3; c++)
+    {
+        double M[3][3];
+        for (int r=0; r<3; r++)
+            for (int k=0; k<3; k++) M[r][k] = (k==c) ? b[r] : A[r][k];
+        sol[c] = det3(M)/det;
+    }
+    offset = sol[0];
+    stiff = sol[1];
+    damp = sol[2];
+    return true;
+}
+
+void TorqueControlStiffDampCheck::runAutomatic()
+{
+    setMode(VOCAB_CM_POSITION,VOCAB_IM_STIFF);
+    verifyMode(VOCAB_CM_POSITION,VOCAB_IM_STIFF,"test0");
+    goHome();
+
+    //samples are taken every 10ms, as in the interactive mode
+    const double sample_time = 0.01;
+    size_t n_samples = (size_t)(testLen_sec/sample_time)+10;
+    std::vector<double> time, ref, pos, vel, trq, reftrq, err;
+    std::vector<double>* buffers[] = {&time, &ref, &pos, &vel, &trq, &reftrq, &err};
+    for (auto b : buffers) b->reserve(n_samples);
+
+    for (int i=0; i<n_cmd_joints; i++)
+    {
+        ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("***** Automatic impedance identification on joint %d: stiffness %f damping %f......",
+                                                           jointsList[i], stiffness[i], damping[i]));
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(setAndCheckImpedance(jointsList[i], stiffness[i], damping[i]), Asserter::format("Error setting impedance on j %d", jointsList[i]));
+
+        icmd->setControlMode(jointsList[i],VOCAB_CM_POSITION_DIRECT);
+        iimd->setInteractionMode(jointsList[i],VOCAB_IM_COMPLIANT);
+        yarp::os::Time::delay(0.1);
+        int cmode;
+        yarp::dev::InteractionModeEnum imode;
+        icmd->getControlMode(jointsList[i],&cmode);
+        iimd->getInteractionMode(jointsList[i],&imode);
+        ROBOTTESTINGFRAMEWORK_ASSERT_ERROR_IF_FALSE(cmode==VOCAB_CM_POSITION_DIRECT && imode==VOCAB_IM_COMPLIANT,
+                                                    Asserter::format("Unable to set position direct compliant mode on j %d", jointsList[i]));
+
+        for (auto b : buffers) b->clear();
+
+        double start_time = yarp::os::Time::now();
+        double next_time = start_time;
+        while(1)
+        {
+            double t = yarp::os::Time::now()-start_time;
+            if (t >= testLen_sec) break;
+
+            //the reference starts at home, so that the joint is not kicked
+            double q_ref = home[i] + excitation_amplitude*sin(2*M_PI*excitation_frequency*t);
+            iposd->setPosition(jointsList[i], q_ref);
+
+            double curr_pos, curr_vel, torque, torque_ref;
+            ienc->getEncoder(jointsList[i], &curr_pos);
+            ienc->getEncoderSpeed(jointsList[i], &curr_vel);
+            itrq->getTorque(jointsList[i], &torque);
+            itrq->getRefTorque(jointsList[i], &torque_ref);
+
+            time.push_back(t);
+            ref.push_back(q_ref);
+            pos.push_back(curr_pos);
+            vel.push_back(curr_vel);
+            trq.push_back(torque);
+            reftrq.push_back(torque_ref);
+            err.push_back(q_ref-curr_pos);
+
+            next_time += sample_time;
+            double wait = next_time-yarp::os::Time::now();
+            if (wait > 0) yarp::os::Time::delay(wait);
+        }
+
+        iposd->setPosition(jointsList[i], home[i]);
+        yarp::os::Time::delay(0.5);
+        icmd->setControlMode(jointsList[i],VOCAB_CM_POSITION);
+        iimd->setInteractionMode(jointsList[i],VOCAB_IM_STIFF);
+
+        string filename = "stiffDampAuto_" + partName + "_j" + std::to_string(jointsList[i]) + ".txt";
+        std::fstream fs;
+        fs.open(filename.c_str(), std::fstream::out);
+        for (size_t k=0; k<time.size(); k++)
+        {
+            fs << time[k] << " " << ref[k] << " " << pos[k] << " " << vel[k] << " " << trq[k] << " " << reftrq[k] << endl;
+        }
+        fs.close();
+
+        double k_meas, d_meas, t0_meas, k_ref, d_ref, t0_ref;
+        bool ok_meas = fitImpedance(err, vel, trq, k_meas, d_meas, t0_meas);
+        bool ok_ref = fitImpedance(err, vel, reftrq, k_ref, d_ref, t0_ref);
+        ROBOTTESTINGFRAMEWORK_TEST_CHECK(ok_meas, Asserter::format("J %d: the excitation is sufficient to estimate the impedance", jointsList[i]));
+        if (!ok_meas) continue;
+
+        if (ok_ref)
+        {
+            ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("J %d: impedance from the reference torque: stiffness %f damping %f offset %f",
+                                                               jointsList[i], k_ref, d_ref, t0_ref));
+        }
+        ROBOTTESTINGFRAMEWORK_TEST_REPORT(Asserter::format("J %d: impedance from the measured torque: stiffness %f damping %f offset %f",
+                                                           jointsList[i], k_meas, d_meas, t0_meas));
+
+        //the tolerance is relative, with a floor for the values commanded to zero
+        double th_k = std::max(fabs(stiffness[i])*tolerance, 1e-3);
+        double th_d = std::max(fabs(damping[i])*tolerance, 1e-4);
+        ROBOTTESTINGFRAMEWORK_TEST_CHECK(fabs(k_meas-stiffness[i]) <= th_k,
+                                         Asserter::format("J %d: estimated stiffness %f, commanded %f (tolerance %f)", jointsList[i], k_meas, stiffness[i], th_k));
+        ROBOTTESTINGFRAMEWORK_TEST_CHECK(fabs(d_meas-damping[i]) <= th_d,
+                                         Asserter::format("J %d: estimated damping %f, commanded %f (tolerance %f)", jointsList[i], d_meas, damping[i], th_d));
+    }//end for
+
+    ROBOTTESTINGFRAMEWORK_TEST_REPORT("Test ended. Puts joints in pos stiff and moves them to home pos");
+    setMode(VOCAB_CM_POSITION,VOCAB_IM_STIFF);
+    verifyMode(VOCAB_CM_POSITION,VOCAB_IM_STIFF,"test2");
+    goHome();
+}
+
 void TorqueControlStiffDampCheck::run()
+{
+    if (automatic) runAutomatic();
+    else           runInteractive();
+}
+
+void TorqueControlStiffDampCheck::runInteractive()
 {
     setMode(VOCAB_CM_POSITION,VOCAB_IM_STIFF);
     verifyMode(VOCAB_CM_POSITION,VOCAB_IM_STIFF,"test0");
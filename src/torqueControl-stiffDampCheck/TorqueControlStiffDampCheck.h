@@ -22,6 +22,7 @@
 #define _TORQUECONTORLSTIFFDAMPCHECK_H_
 
 #include <string>
+#include <vector>
 #include <yarp/robottestingframework/TestCase.h>
 #include <yarp/dev/ControlBoardInterfaces.h>
 #include <yarp/dev/PolyDriver.h>
@@ -29,6 +30,15 @@
 
 using namespace yarp::os;
 
+/**
+* Checks the impedance (stiffness and damping) of the joints in compliant position control.
+* In the default interactive mode the user moves the joints and the data are saved for the octave script torqueStiffDamp_plotAll.m.
+* With automatic=true the test does not need an operator: each joint is commanded in position direct with a sine
+* (excitation_amplitude, excitation_frequency) around its home, while the commanded stiffness and damping are active,
+* and the stiffness K, the damping D and the offset t0 are estimated by least squares over the model
+* torque = t0 + K*(reference - position) - D*velocity, both for the measured and for the reference torque.
+* The estimates from the measured torque are compared with the commanded values within the relative tolerance.
+*/
 class TorqueControlStiffDampCheck : public yarp::robottestingframework::TestCase {
 public:
     TorqueControlStiffDampCheck();
@@ -47,6 +57,11 @@ public:
     void saveToFile(std::string filename, yarp::os::Bottle &b);
     std::string getPath(const std::string& str);
 
+    void runInteractive();
+    void runAutomatic();
+    static bool fitImpedance(const std::vector<double>& err, const std::vector<double>& vel, const std::vector<double>& trq,
+                             double& stiff, double& damp, double& offset);
+
 private:
     std::string robotName;
     std::string partName;
@@ -61,6 +76,10 @@ private:
     Bottle b_pos_trq;
     Bottle b_vel_trq;
     bool plot_enabled;
+    bool automatic;
+    double excitation_amplitude;
+    double excitation_frequency;
+    double tolerance;
 
 
     yarp::dev::PolyDriver        *dd;
@@ -71,6 +90,7 @@ private:
     yarp::dev::IEncoders         *ienc;
     yarp::dev::ITorqueControl    *itrq;
     yarp::dev::IImpedanceControl *iimp;
+    yarp::dev::IPositionDirect   *iposd;
 
 };
 